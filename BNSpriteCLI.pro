@@ -0,0 +1,25 @@
+# Headless command line tool, only depends on the BNSprite core
+TEMPLATE = app
+TARGET = bnspritecli
+
+CONFIG += console c++17 thread
+CONFIG -= qt app_bundle
+
+SOURCES += \
+    allocationcounter.cpp \
+    bnsprite.cpp \
+    bnspritecli.cpp \
+    bnspritegenerator.cpp
+
+HEADERS += \
+    allocationcounter.h \
+    bnsprite.h \
+    bnspritegenerator.h
+
+# qmake CONFIG+=count_allocations makes bench report heap allocations per operation
+count_allocations: DEFINES += BNSPRITE_COUNT_ALLOCATIONS
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
@@ -1,4 +1,4 @@
-QT       += core gui
+QT       += core gui concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -17,27 +17,34 @@ DEFINES += QT_DEPRECATED_WARNINGS
 
 SOURCES += \
     bnsprite.cpp \
+    bnspritehistory.cpp \
     buildoptiondialog.cpp \
     customspritemanager.cpp \
+    frameimagecache.cpp \
     main.cpp \
     bnspriteeditor.cpp \
     palettecontextmenu.cpp \
     palettegraphicsview.cpp \
     paletteinfowidget.cpp \
     paletteinfowindow.cpp \
+    tileatlascache.cpp \
     zoomgraphicsview.cpp
 
 HEADERS += \
     bnsprite.h \
     bnspriteeditor.h \
+    bnspritehistory.h \
     buildoptiondialog.h \
     customspritemanager.h \
+    frameimagecache.h \
     listwidgetdropsignal.h \
     listwidgetignoreself.h \
     palettecontextmenu.h \
     palettegraphicsview.h \
     paletteinfowidget.h \
     paletteinfowindow.h \
+    thumbnaillistitem.h \
+    tileatlascache.h \
     zoomgraphicsview.h
 
 FORMS += \
@@ -0,0 +1,75 @@
+#include "allocationcounter.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    // Per thread so concurrent work doesn't show up in another thread's numbers
+    thread_local uint64_t t_allocationCount = 0;
+    thread_local uint64_t t_allocationBytes = 0;
+}
+
+#ifdef BNSPRITE_COUNT_ALLOCATIONS
+static void* CountedAllocate
+(
+    size_t _size,
+    bool _throw
+)
+{
+    t_allocationCount++;
+    t_allocationBytes += _size;
+
+    void* ptr = malloc(_size ? _size : 1);
+    if (!ptr && _throw)
+    {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void* operator new(size_t _size) { return CountedAllocate(_size, true); }
+void* operator new[](size_t _size) { return CountedAllocate(_size, true); }
+void* operator new(size_t _size, std::nothrow_t const&) noexcept { return CountedAllocate(_size, false); }
+void* operator new[](size_t _size, std::nothrow_t const&) noexcept { return CountedAllocate(_size, false); }
+void operator delete(void* _ptr) noexcept { free(_ptr); }
+void operator delete[](void* _ptr) noexcept { free(_ptr); }
+void operator delete(void* _ptr, size_t) noexcept { free(_ptr); }
+void operator delete[](void* _ptr, size_t) noexcept { free(_ptr); }
+void operator delete(void* _ptr, std::nothrow_t const&) noexcept { free(_ptr); }
+void operator delete[](void* _ptr, std::nothrow_t const&) noexcept { free(_ptr); }
+#endif
+
+//-----------------------------------------------------
+// Whether allocations are being counted in this build
+//-----------------------------------------------------
+bool AllocationCounter::IsEnabled()
+{
+#ifdef BNSPRITE_COUNT_ALLOCATIONS
+    return true;
+#else
+    return false;
+#endif
+}
+
+//-----------------------------------------------------
+// Count from zero again
+//-----------------------------------------------------
+void AllocationCounter::Restart()
+{
+    m_startCount = t_allocationCount;
+    m_startBytes = t_allocationBytes;
+}
+
+//-----------------------------------------------------
+// Allocations since the last restart
+//-----------------------------------------------------
+uint64_t AllocationCounter::GetCount() const
+{
+    return t_allocationCount - m_startCount;
+}
+
+uint64_t AllocationCounter::GetBytes() const
+{
+    return t_allocationBytes - m_startBytes;
+}
@@ -0,0 +1,25 @@
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+#include <cstdint>
+
+// Counts heap allocations made by the calling thread since construction or Restart().
+// Only counts when built with BNSPRITE_COUNT_ALLOCATIONS, which replaces the global
+// operator new/delete, otherwise every count stays at 0
+class AllocationCounter
+{
+public:
+    AllocationCounter() { Restart(); }
+
+    static bool IsEnabled();
+
+    void Restart();
+    uint64_t GetCount() const;
+    uint64_t GetBytes() const;
+
+private:
+    uint64_t m_startCount;
+    uint64_t m_startBytes;
+};
+
+#endif // ALLOCATIONCOUNTER_H
@@ -8,13 +8,111 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
 
 #include <algorithm>
+#include <atomic>
 #include <cstring>
 #include <sstream>
 #include <fstream>
 #include <iostream>
 #include <iomanip>
+#include <thread>
+
+// File times are kept in their native unit, 100ns ticks on Windows and nanoseconds elsewhere
+#ifdef _WIN32
+static int64_t const c_fileTimeTicksPerSecond = 10000000;
+#else
+static int64_t const c_fileTimeTicksPerSecond = 1000000000;
+#endif
+
+//-----------------------------------------------------
+// Open addressing map from file pointer to ID
+//-----------------------------------------------------
+class PointerIndex
+{
+public:
+    PointerIndex()
+        : m_count(0)
+    {
+        m_slots.resize(64);
+    }
+
+    bool Find(uint32_t _ptr, uint32_t& _id) const
+    {
+        uint32_t const mask = m_slots.size() - 1;
+        for (uint32_t i = Hash(_ptr) & mask; m_slots[i].m_used; i = (i + 1) & mask)
+        {
+            if (m_slots[i].m_ptr == _ptr)
+            {
+                _id = m_slots[i].m_id;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void Insert(uint32_t _ptr, uint32_t _id)
+    {
+        // Keep load factor at most 1/2
+        if ((m_count + 1) * 2 > m_slots.size())
+        {
+            vector<Slot> oldSlots;
+            oldSlots.swap(m_slots);
+            m_slots.resize(oldSlots.size() * 2);
+            m_count = 0;
+            for (Slot const& slot : oldSlots)
+            {
+                if (slot.m_used)
+                {
+                    Place(slot.m_ptr, slot.m_id);
+                }
+            }
+        }
+        Place(_ptr, _id);
+    }
+
+private:
+    struct Slot
+    {
+        uint32_t m_ptr;
+        uint32_t m_id;
+        bool m_used;
+
+        Slot()
+            : m_ptr(0)
+            , m_id(0)
+            , m_used(false)
+        {}
+    };
+
+    static uint32_t Hash(uint32_t _ptr)
+    {
+        // Fibonacci hashing, pointers are 4-byte aligned most of the time
+        return (_ptr * 2654435761u) >> 7;
+    }
+
+    void Place(uint32_t _ptr, uint32_t _id)
+    {
+        uint32_t const mask = m_slots.size() - 1;
+        uint32_t i = Hash(_ptr) & mask;
+        while (m_slots[i].m_used)
+        {
+            i = (i + 1) & mask;
+        }
+        m_slots[i].m_ptr = _ptr;
+        m_slots[i].m_id = _id;
+        m_slots[i].m_used = true;
+        m_count++;
+    }
+
+    vector<Slot> m_slots;
+    uint32_t m_count;
+};
 
 //-----------------------------------------------------
 // Constructor
@@ -31,6 +129,42 @@ BNSprite::~BNSprite()
 {
 }
 
+constexpr int32_t BNSprite::SubObject::c_sizeX[16];
+constexpr int32_t BNSprite::SubObject::c_sizeY[16];
+constexpr uint8_t BNSprite::SubObject::c_shapeSize[4][4];
+
+//-----------------------------------------------------
+// Set OAM dimension in pixels, return false if GBA can't display it
+//-----------------------------------------------------
+bool BNSprite::SubObject::SetSize
+(
+    int32_t _sizeX,
+    int32_t _sizeY
+)
+{
+    int const x = GetDimensionIndex(_sizeX);
+    int const y = GetDimensionIndex(_sizeY);
+    if (x < 0 || y < 0 || c_shapeSize[x][y] == 0xFF) return false;
+
+    m_attributes = (m_attributes & 0xF0) | c_shapeSize[x][y];
+    return true;
+}
+
+//-----------------------------------------------------
+// Set OAM shape and size as stored in the file
+//-----------------------------------------------------
+bool BNSprite::SubObject::SetOAMShapeSize
+(
+    uint8_t _shape,
+    uint8_t _size
+)
+{
+    if (_shape > 2 || _size > 3) return false;
+
+    m_attributes = (m_attributes & 0xF0) | (_size << 2) | _shape;
+    return true;
+}
+
 //-----------------------------------------------------
 // Clear all data
 //-----------------------------------------------------
@@ -39,8 +173,11 @@ void BNSprite::Clear()
     m_loaded = false;
     m_256ColorMode = false;
     m_animations.clear();
+    m_store.Clear();
     m_tilesets.clear();
     m_paletteGroups.clear();
+    m_paletteSnapshot.reset();
+    m_savedFile = SavedFile();
 }
 
 //-----------------------------------------------------
@@ -54,21 +191,49 @@ bool BNSprite::LoadBN
 {
     Clear();
 
-    FILE* f;
-    _wfopen_s(&f, _fileName.c_str(), L"rb");
-    if (!f)
+    // Read the whole file at once and parse from memory
+    vector<uint8_t> buffer;
+    if (!LoadFileToBuffer(_fileName, buffer))
     {
         _errorMsg = "Unable to open file!";
-        fclose(f);
         return false;
     }
 
-    // File size
-    fseek(f, 0, SEEK_END);
-    uint32_t fileSize = ftell(f);
+    return LoadBN(buffer.data(), buffer.size(), _errorMsg);
+}
+
+//-----------------------------------------------------
+// Load a sprite from memory, return false if fail
+//-----------------------------------------------------
+bool BNSprite::LoadBN
+(
+    uint8_t const* _data,
+    uint32_t _size,
+    string& _errorMsg
+)
+{
+    return ParseBN(_data, _size, nullptr, _errorMsg);
+}
+
+//-----------------------------------------------------
+// Parse a BN sprite, only collect statistics if _scan is given
+//-----------------------------------------------------
+bool BNSprite::ParseBN
+(
+    uint8_t const* _data,
+    uint32_t _size,
+    ScanInfo* _scan,
+    string& _errorMsg
+)
+{
+    Clear();
+
+    bool const build = (_scan == nullptr);
+    ByteStream f(_data, _size);
+    uint32_t const fileSize = _size;
 
     // Read metadata
-    fseek(f, 0x01, SEEK_SET);
+    f.Seek(0x01);
     uint32_t metadataOffset = 0x00;
     {
         uint8_t meta0 = ReadByte(f);
@@ -87,9 +252,9 @@ bool BNSprite::LoadBN
     uint8_t animCount = 0;
     if (metadataOffset == 0x00)
     {
-        fseek(f, 0x00, SEEK_SET);
+        f.Seek(0x00);
         animCount = ReadInt(f) / 0x04;
-        fseek(f, 0x00, SEEK_SET);
+        f.Seek(0x00);
     }
     else
     {
@@ -100,11 +265,11 @@ bool BNSprite::LoadBN
     if (animCount > 0xFF)
     {
         _errorMsg = "Sprite exceeded 255 animations!";
-        fclose(f);
         return false;
     }
 
-    set<uint32_t> allPtrs;
+    // Every pointer seen, sorted once all frames are read
+    vector<uint32_t> allPtrs;
 
     // Read animation pointers
     std::cout << "Reading animation pointers..." << endl;
@@ -115,146 +280,135 @@ bool BNSprite::LoadBN
         uint32_t ptr = ReadInt(f) + metadataOffset;
         if (ptr < (metadataOffset + animCount * 0x04) || ptr >= fileSize)
         {
-            _errorMsg = "Invalid animation pointer at address " + GetAddressString(ftell(f) - 4);
-            fclose(f);
+            _errorMsg = "Invalid animation pointer at address " + GetAddressString(f.Tell() - 4);
             return false;
         }
 
-        allPtrs.insert(ptr);
+        allPtrs.push_back(ptr);
         animPtrs.push_back(ptr);
     }
 
     // Read frame data
     std::cout << "Reading frame data..." << endl;
-    uint32_t tilesetID = 0;
     vector<uint32_t> tilesetPtrs;
-    uint32_t paletteGroupID = 0;
+    PointerIndex tilesetIDs;
     vector<uint32_t> paletteGroupPtrs;
+    PointerIndex paletteGroupIDs;
 
-    m_animations.reserve(0xFF);
+    // Reused by every frame
+    vector<uint32_t> subAnimPtrs;
+    vector<uint32_t> objectPtrs;
+
+    if (build)
+    {
+        m_animations.reserve(0xFF);
+    }
     for (auto animPtr : animPtrs)
     {
-        fseek(f, animPtr, SEEK_SET);
+        f.Seek(animPtr);
 
-        Animation animation;
+        AnimationEntry animation;
+        animation.m_frames.m_start = m_store.m_frames.size();
         bool endOfFrame = false;
         while (!endOfFrame)
         {
-            if ((uint32_t)ftell(f) >= fileSize)
+            if (f.Tell() >= fileSize)
             {
                 _errorMsg = "Reached the end of file while reading frame data!";
-                fclose(f);
                 return false;
             }
 
-            Frame frame;
+            FrameEntry frame;
 
             // Read tileset
             {
                 uint32_t ptr = ReadInt(f) + metadataOffset;
-                if (ptr <= (uint32_t)ftell(f) - 0x04 || ptr >= fileSize)
+                if (ptr <= f.Tell() - 0x04 || ptr >= fileSize)
                 {
-                    _errorMsg = "Invalid tileset pointer at address " + GetAddressString(ftell(f) - 4);
-                    fclose(f);
+                    _errorMsg = "Invalid tileset pointer at address " + GetAddressString(f.Tell() - 4);
                     return false;
                 }
 
                 // This can have duplicated pointers
-                auto it = find(tilesetPtrs.begin(), tilesetPtrs.end(), ptr);
-                if (it != tilesetPtrs.end())
-                {
-                    // Use existing ID
-                    frame.m_tilesetID = it - tilesetPtrs.begin();
-                }
-                else
+                if (!tilesetIDs.Find(ptr, frame.m_tilesetID))
                 {
                     // Create new ID
-                    allPtrs.insert(ptr);
+                    frame.m_tilesetID = tilesetPtrs.size();
+                    tilesetIDs.Insert(ptr, frame.m_tilesetID);
+                    allPtrs.push_back(ptr);
                     tilesetPtrs.push_back(ptr);
-                    frame.m_tilesetID = tilesetID;
-                    tilesetID++;
                 }
             }
 
             // Read palette
             {
                 uint32_t ptr = ReadInt(f) + metadataOffset;
-                if (ptr <= (uint32_t)ftell(f) - 0x04 || ptr >= fileSize)
+                if (ptr <= f.Tell() - 0x04 || ptr >= fileSize)
                 {
-                    _errorMsg = "Invalid palette group pointer at address " + GetAddressString(ftell(f) - 4);
-                    fclose(f);
+                    _errorMsg = "Invalid palette group pointer at address " + GetAddressString(f.Tell() - 4);
                     return false;
                 }
 
                 // This can have duplicated pointers
-                auto it = find(paletteGroupPtrs.begin(), paletteGroupPtrs.end(), ptr);
-                if (it != paletteGroupPtrs.end())
-                {
-                    // Use existing ID
-                    frame.m_paletteGroupID = it - paletteGroupPtrs.begin();
-                }
-                else
+                if (!paletteGroupIDs.Find(ptr, frame.m_paletteGroupID))
                 {
                     // Create new ID
-                    allPtrs.insert(ptr);
+                    frame.m_paletteGroupID = paletteGroupPtrs.size();
+                    paletteGroupIDs.Insert(ptr, frame.m_paletteGroupID);
+                    allPtrs.push_back(ptr);
                     paletteGroupPtrs.push_back(ptr);
-                    frame.m_paletteGroupID = paletteGroupID;
-                    paletteGroupID++;
                 }
             }
 
             // Read sub animation
             {
                 uint32_t subAnimPtr = ReadInt(f) + metadataOffset;
-                allPtrs.insert(subAnimPtr);
-                uint32_t rewindOffset = ftell(f);
-                if (subAnimPtr <= (uint32_t)ftell(f) - 0x04 || subAnimPtr >= fileSize)
+                allPtrs.push_back(subAnimPtr);
+                uint32_t rewindOffset = f.Tell();
+                if (subAnimPtr <= f.Tell() - 0x04 || subAnimPtr >= fileSize)
                 {
-                    _errorMsg = "Invalid sub animation pointer at address " + GetAddressString(ftell(f) - 4);
-                    fclose(f);
+                    _errorMsg = "Invalid sub animation pointer at address " + GetAddressString(f.Tell() - 4);
                     return false;
                 }
 
-                fseek(f, subAnimPtr, SEEK_SET);
+                f.Seek(subAnimPtr);
                 uint8_t subAnimCount = ReadInt(f) / 0x04;
                 if (subAnimCount > 0xFF)
                 {
                     _errorMsg = "Sub animation group has more than 255 animations at address " + GetAddressString(subAnimPtr);
-                    fclose(f);
                     return false;
                 }
 
                 // Get sub animation pointers
-                fseek(f, subAnimPtr, SEEK_SET);
-                vector<uint32_t> subAnimPtrs;
+                f.Seek(subAnimPtr);
+                subAnimPtrs.clear();
                 for (uint8_t i = 0; i < subAnimCount; i++)
                 {
                     uint32_t ptr = ReadInt(f) + subAnimPtr;
                     if (ptr < (subAnimPtr + subAnimCount * 0x04) || ptr + 6 > fileSize) // Size is at least 3 * 2
                     {
-                        _errorMsg = "Invalid sub animation pointer at address " + GetAddressString(ftell(f) - 4);
-                        fclose(f);
+                        _errorMsg = "Invalid sub animation pointer at address " + GetAddressString(f.Tell() - 4);
                         return false;
                     }
                     subAnimPtrs.push_back(ptr);
-                    allPtrs.insert(ptr);
+                    allPtrs.push_back(ptr);
                 }
 
                 // Read sub animations and frames
-                frame.m_subAnimations.reserve(subAnimCount);
+                frame.m_subAnimations.m_start = m_store.m_subAnimations.size();
                 for (auto subAnimPtr : subAnimPtrs)
                 {
-                    fseek(f, subAnimPtr, SEEK_SET);
-                    SubAnimation subAnim;
+                    f.Seek(subAnimPtr);
+                    SubAnimationEntry subAnim;
+                    subAnim.m_subFrames.m_start = m_store.m_subFrames.size();
 
                     uint8_t buffer[3] = { 0x00, 0x00, 0x00 };
                     bool endOfFrame = false;
                     while (!endOfFrame)
                     {
-                        if ((uint32_t)ftell(f) >= fileSize)
+                        if (f.Tell() >= fileSize)
                         {
                             _errorMsg = "Reached the end of file while reading sub animation data!";
-                            fclose(f);
                             return false;
                         }
 
@@ -265,8 +419,7 @@ bool BNSprite::LoadBN
                         buffer[1] = ReadByte(f);
                         if (buffer[1] == 0x00)
                         {
-                            _errorMsg = "Invalid sub animation delay at address " + GetAddressString(ftell(f) - 1);
-                            fclose(f);
+                            _errorMsg = "Invalid sub animation delay at address " + GetAddressString(f.Tell() - 1);
                             return false;
                         }
 
@@ -276,21 +429,29 @@ bool BNSprite::LoadBN
                         endOfFrame = (buffer[2] & 0xC0) > 0;
                         if (buffer[2] != 0x00 && (buffer[2] & ~(0xC0)) > 0)
                         {
-                            _errorMsg = "Invalid end of sub animation flag at address " + GetAddressString(ftell(f) - 1);
-                            fclose(f);
+                            _errorMsg = "Invalid end of sub animation flag at address " + GetAddressString(f.Tell() - 1);
                             return false;
                         }
 
-                        SubFrame frame;
-                        frame.m_objectIndex = buffer[0];
-                        frame.m_delay = buffer[1];
-                        subAnim.m_subFrames.push_back(frame);
+                        if (build)
+                        {
+                            SubFrame frame;
+                            frame.m_objectIndex = buffer[0];
+                            frame.m_delay = buffer[1];
+                            m_store.m_subFrames.push_back(frame);
+                            subAnim.m_subFrames.m_count++;
+                        }
+                    }
+
+                    if (build)
+                    {
+                        m_store.m_subAnimations.push_back(subAnim);
+                        frame.m_subAnimations.m_count++;
                     }
-                    frame.m_subAnimations.push_back(subAnim);
                 }
 
                 // Jump back to frame data
-                fseek(f, rewindOffset, SEEK_SET);
+                f.Seek(rewindOffset);
 
                 // Debug info
                 /*
@@ -319,55 +480,52 @@ bool BNSprite::LoadBN
             // Read object
             {
                 uint32_t objectListPtr = ReadInt(f) + metadataOffset;
-                allPtrs.insert(objectListPtr);
-                uint32_t rewindOffset = ftell(f);
-                if (objectListPtr  <= (uint32_t)ftell(f) - 0x04 || objectListPtr >= fileSize)
+                allPtrs.push_back(objectListPtr);
+                uint32_t rewindOffset = f.Tell();
+                if (objectListPtr  <= f.Tell() - 0x04 || objectListPtr >= fileSize)
                 {
-                    _errorMsg = "Invalid object group pointer at address " + GetAddressString(ftell(f) - 4);
-                    fclose(f);
+                    _errorMsg = "Invalid object group pointer at address " + GetAddressString(f.Tell() - 4);
                     return false;
                 }
 
-                fseek(f, objectListPtr, SEEK_SET);
+                f.Seek(objectListPtr);
                 uint8_t objectCount = ReadInt(f) / 0x04;
                 if (objectCount > 0xFF)
                 {
                     _errorMsg = "Object group has more than 255 objects at address " + GetAddressString(objectListPtr);
-                    fclose(f);
                     return false;
                 }
 
                 // Get object pointers
-                fseek(f, objectListPtr, SEEK_SET);
-                vector<uint32_t> objectPtrs;
+                f.Seek(objectListPtr);
+                objectPtrs.clear();
                 for (uint8_t i = 0; i < objectCount; i++)
                 {
                     uint32_t ptr = ReadInt(f) + objectListPtr;
                     if (ptr < (objectListPtr + objectCount * 0x04) || ptr + 10 > fileSize) // Size is at least 5 * 2
                     {
-                        _errorMsg = "Invalid object pointer at address " + GetAddressString(ftell(f) - 4);
-                        fclose(f);
+                        _errorMsg = "Invalid object pointer at address " + GetAddressString(f.Tell() - 4);
                         return false;
                     }
                     objectPtrs.push_back(ptr);
-                    allPtrs.insert(ptr);
+                    allPtrs.push_back(ptr);
                 }
 
                 // Read sub animations and frames
-                frame.m_objects.reserve(objectCount);
+                frame.m_objects.m_start = m_store.m_objects.size();
                 for (auto objectPtr : objectPtrs)
                 {
-                    fseek(f, objectPtr, SEEK_SET);
-                    Object object;
+                    f.Seek(objectPtr);
+                    ObjectEntry object;
+                    object.m_subObjects.m_start = m_store.m_subObjects.size();
 
                     uint8_t buffer[5] = { 0x00, 0x00, 0x00, 0x00, 0x00 };
                     bool endOfFrame = false;
                     while (!endOfFrame)
                     {
-                        if ((uint32_t)ftell(f) >= fileSize)
+                        if (f.Tell() >= fileSize)
                         {
                             _errorMsg = "Reached the end of file while reading sub animation data!";
-                            fclose(f);
                             return false;
                         }
 
@@ -377,7 +535,7 @@ bool BNSprite::LoadBN
                         buffer[3] = ReadByte(f);
                         buffer[4] = ReadByte(f);
 
-                        if ((buffer[0] == 0xFF && buffer[1] == 0xFF && buffer[2] == 0xFF && buffer[3] == 0xFF && buffer[4] == 0xFF) || (uint32_t)ftell(f) >= fileSize)
+                        if ((buffer[0] == 0xFF && buffer[1] == 0xFF && buffer[2] == 0xFF && buffer[3] == 0xFF && buffer[4] == 0xFF) || f.Tell() >= fileSize)
                         {
                             endOfFrame = true;
                         }
@@ -387,53 +545,48 @@ bool BNSprite::LoadBN
                             subObj.m_startTile = buffer[0];
                             subObj.m_posX = static_cast<int8_t>(buffer[1]);
                             subObj.m_posY = static_cast<int8_t>(buffer[2]);
-                            subObj.m_hFlip = buffer[3] & 0x40;
-                            subObj.m_vFlip = buffer[3] & 0x80;
                             object.m_paletteIndex = buffer[4] >> 4;
 
-                            uint8_t sizeShape = ((buffer[3] & 0x03) << 0x04) | (buffer[4] & 0x03);
-                            switch (sizeShape)
+                            if (!subObj.SetOAMShapeSize(buffer[4] & 0x03, buffer[3] & 0x03))
                             {
-                            case 0x00: subObj.m_sizeX = 8;  subObj.m_sizeY = 8;  break;
-                            case 0x01: subObj.m_sizeX = 16; subObj.m_sizeY = 8;  break;
-                            case 0x02: subObj.m_sizeX = 8;  subObj.m_sizeY = 16; break;
-                            case 0x10: subObj.m_sizeX = 16; subObj.m_sizeY = 16; break;
-                            case 0x11: subObj.m_sizeX = 32; subObj.m_sizeY = 8;  break;
-                            case 0x12: subObj.m_sizeX = 8;  subObj.m_sizeY = 32; break;
-                            case 0x20: subObj.m_sizeX = 32; subObj.m_sizeY = 32; break;
-                            case 0x21: subObj.m_sizeX = 32; subObj.m_sizeY = 16; break;
-                            case 0x22: subObj.m_sizeX = 16; subObj.m_sizeY = 32; break;
-                            case 0x30: subObj.m_sizeX = 64; subObj.m_sizeY = 64; break;
-                            case 0x31: subObj.m_sizeX = 64; subObj.m_sizeY = 32; break;
-                            case 0x32: subObj.m_sizeX = 32; subObj.m_sizeY = 64; break;
-                            default:
-                                _errorMsg = "Unexpected OAM dimension at address " + GetAddressString(ftell(f) - 5);
-                                fclose(f);
+                                _errorMsg = "Unexpected OAM dimension at address " + GetAddressString(f.Tell() - 5);
                                 return false;
                             }
+                            subObj.m_attributes |= (buffer[3] >> 2) & 0x30;
 
                             // Check for unused data
                             if ((buffer[3] & 0x3C) > 0)
                             {
-                                _errorMsg = "Unused bit 2-5 has been used for flag at address " + GetAddressString(ftell(f) - 2);
-                                fclose(f);
+                                _errorMsg = "Unused bit 2-5 has been used for flag at address " + GetAddressString(f.Tell() - 2);
                                 return false;
                             }
                             if ((buffer[4] & 0x0C) > 0)
                             {
-                                _errorMsg = "Unused bit 2-3 has been used for flag at address " + GetAddressString(ftell(f) - 1);
-                                fclose(f);
+                                _errorMsg = "Unused bit 2-3 has been used for flag at address " + GetAddressString(f.Tell() - 1);
                                 return false;
                             }
 
-                            object.m_subObjects.push_back(subObj);
+                            if (build)
+                            {
+                                m_store.m_subObjects.push_back(subObj);
+                                object.m_subObjects.m_count++;
+                            }
+                            else
+                            {
+                                _scan->m_oamCount++;
+                            }
                         }
                     }
-                    frame.m_objects.push_back(object);
+
+                    if (build)
+                    {
+                        m_store.m_objects.push_back(object);
+                        frame.m_objects.m_count++;
+                    }
                 }
 
                 // Jump back to frame data
-                fseek(f, rewindOffset, SEEK_SET);
+                f.Seek(rewindOffset);
 
                 // Debug info
                 /*
@@ -456,11 +609,11 @@ bool BNSprite::LoadBN
                         std::cout << left
                             << setw(8) << " "
                             << setw(9) << to_string(j)
-                            << setw(7) << to_string(subObject.m_sizeX) + "x" + to_string(subObject.m_sizeY)
+                            << setw(7) << to_string(subObject.GetSizeX()) + "x" + to_string(subObject.GetSizeY())
                             << setw(8) << to_string(subObject.m_posX)
                             << setw(8) << to_string(subObject.m_posY)
-                            << setw(9) << (subObject.m_hFlip ? "Yes" : "No")
-                            << setw(9) << (subObject.m_vFlip ? "Yes" : "No")
+                            << setw(9) << (subObject.GetHFlip() ? "Yes" : "No")
+                            << setw(9) << (subObject.GetVFlip() ? "Yes" : "No")
                             << setw(16) << to_string(object.m_paletteIndex) << endl;
                     }
                 }
@@ -471,12 +624,11 @@ bool BNSprite::LoadBN
             frame.m_delay = ReadByte(f);
             if (frame.m_delay == 0x00)
             {
-                _errorMsg = "Invalid frame delay at address " + GetAddressString(ftell(f) - 1);
-                fclose(f);
+                _errorMsg = "Invalid frame delay at address " + GetAddressString(f.Tell() - 1);
                 return false;
             }
 
-            fseek(f, 0x01, SEEK_CUR);
+            f.Skip(0x01);
 
             // Read end of frame flag
             uint8_t flag = ReadByte(f);
@@ -486,17 +638,32 @@ bool BNSprite::LoadBN
             endOfFrame = (flag & 0xC0) > 0;
             if (flag != 0x00 && (flag & ~(0xC3)) > 0)
             {
-                _errorMsg = "Invalid end of frame flag at address " + GetAddressString(ftell(f) - 1);
-                fclose(f);
+                _errorMsg = "Invalid end of frame flag at address " + GetAddressString(f.Tell() - 1);
                 return false;
             }
 
-            fseek(f, 0x01, SEEK_CUR);
+            f.Skip(0x01);
 
             // Insert frame to animation
-            animation.m_frames.push_back(frame);
+            if (build)
+            {
+                m_store.m_frames.push_back(frame);
+                animation.m_frames.m_count++;
+            }
+            else
+            {
+                _scan->m_frameCount++;
+            }
+        }
+
+        if (build)
+        {
+            m_animations.push_back(animation);
+        }
+        else
+        {
+            _scan->m_animationCount++;
         }
-        m_animations.push_back(animation);
 
         // Debug info
         /*
@@ -525,27 +692,31 @@ bool BNSprite::LoadBN
 
     // Read tileset data
     std::cout << "Reading tileset data..." << endl;
-    m_tilesets.reserve(tilesetPtrs.size());
+    if (build)
+    {
+        m_tilesets.reserve(tilesetPtrs.size());
+    }
     for (auto tilesetPtr : tilesetPtrs)
     {
-        fseek(f, tilesetPtr, SEEK_SET);
+        f.Seek(tilesetPtr);
 
         uint32_t size = ReadInt(f);
-        Tileset tileset;
-        tileset.m_data.reserve(size);
-
-        if ((uint32_t)ftell(f) + size > fileSize)
+        if (f.Remaining() < size)
         {
-            _errorMsg = "Error reading tileset at address " + GetAddressString(ftell(f) - 4);
-            fclose(f);
+            _errorMsg = "Error reading tileset at address " + GetAddressString(f.Tell() - 4);
             return false;
         }
 
-        for (uint32_t i = 0; i < size; i++)
+        if (!build)
         {
-            tileset.m_data.push_back(ReadByte(f));
+            _scan->m_tilesetCount++;
+            continue;
         }
-        m_tilesets.push_back(tileset);
+
+        // Copy the whole tileset in one go
+        Tileset tileset;
+        tileset.m_data.assign(f.Current(), f.Current() + size);
+        m_tilesets.push_back(move(tileset));
     }
 
     // Debug info
@@ -557,40 +728,59 @@ bool BNSprite::LoadBN
     {
         std::cout << left
             << setw(10) << to_string(i)
-            << setw(7) << to_string(m_tilesets[i].m_data.size()) << endl;
+            << setw(7) << to_string(m_tilesets[i].GetSize()) << endl;
     }
     std::cout << endl;
     */
 
     // Read palette data
     std::cout << "Reading palette data..." << endl;
-    m_paletteGroups.reserve(paletteGroupPtrs.size());
+    sort(allPtrs.begin(), allPtrs.end());
+    allPtrs.erase(unique(allPtrs.begin(), allPtrs.end()), allPtrs.end());
+    if (build)
+    {
+        m_paletteGroups.reserve(paletteGroupPtrs.size());
+    }
     for (uint32_t i = 0; i < paletteGroupPtrs.size(); i++)
     {
         uint32_t const& palettePtr = paletteGroupPtrs[i];
 
+        // Palette group ends at the next pointer used by anything
         uint32_t nextUsedPtr = fileSize;
-        for (uint32_t const& ptr : allPtrs)
+        auto it = upper_bound(allPtrs.begin(), allPtrs.end(), palettePtr);
+        if (it != allPtrs.end() && *it < nextUsedPtr)
+        {
+            nextUsedPtr = *it;
+        }
+
+        // Skip 20 00 00 00
+        f.Seek(palettePtr + 0x04);
+
+        if (!build)
         {
-            if (ptr > palettePtr && ptr < nextUsedPtr)
+            // Same bounds as below without reading the colors
+            uint32_t paletteCount = 0;
+            while (paletteCount < 0xFF && f.Tell() < nextUsedPtr)
             {
-                nextUsedPtr = ptr;
+                f.Skip(0x20);
+                paletteCount++;
             }
+            _scan->m_paletteGroupCount++;
+            _scan->m_paletteCount += paletteCount;
+            continue;
         }
 
-        // Skip 20 00 00 00
-        fseek(f, palettePtr + 0x04, SEEK_SET);
         PaletteGroup group;
 
         // Search for palette until invalid color is found
-        while (group.m_palettes.size() < 0xFF && (uint32_t)ftell(f) < nextUsedPtr)
+        while (group.m_palettes.size() < 0xFF && f.Tell() < nextUsedPtr)
         {
             Palette palette;
             palette.m_colors.reserve(0x10);
 
             for (uint8_t j = 0; j < 0x10; j++)
             {
-                if ((uint32_t)ftell(f) < fileSize)
+                if (f.Tell() < fileSize)
                 {
                     uint16_t color = ReadShort(f);
                     palette.m_colors.push_back(color & 0x7FFF);
@@ -601,14 +791,13 @@ bool BNSprite::LoadBN
                 }
             }
 
-            group.m_palettes.push_back(palette);
+            group.m_palettes.push_back(move(palette));
         }
 
-        m_paletteGroups.push_back(group);
+        m_paletteGroups.push_back(move(group));
     }
 
-    fclose(f);
-    m_loaded = true;
+    m_loaded = build;
     return true;
 }
 
@@ -618,34 +807,208 @@ bool BNSprite::LoadSF
     string& _errorMsg
 )
 {
-    typedef struct
+    Clear();
+
+    // Tilesets keep referencing this buffer until they are edited
+    shared_ptr<vector<uint8_t>> buffer = make_shared<vector<uint8_t>>();
+    if (!LoadFileToBuffer(_fileName, *buffer))
     {
-        uint16_t tileNum;
-        uint16_t tileCount;
-        uint32_t fromSprite;
-    } TilesetInfo;
+        _errorMsg = "Unable to open file!";
+        return false;
+    }
+
+    shared_ptr<uint8_t const> data(buffer, buffer->data());
+    return ParseSF(data, buffer->size(), nullptr, _errorMsg);
+}
 
+bool BNSprite::LoadSF
+(
+    uint8_t const* _data,
+    uint32_t _size,
+    string& _errorMsg
+)
+{
     Clear();
 
-    FILE* f;
-    _wfopen_s(&f, _fileName.c_str(), L"rb");
-    if (!f)
+    // Caller's memory may not outlive the sprite, take a copy for the tilesets
+    shared_ptr<vector<uint8_t>> buffer = make_shared<vector<uint8_t>>(_data, _data + _size);
+    shared_ptr<uint8_t const> data(buffer, buffer->data());
+    return ParseSF(data, _size, nullptr, _errorMsg);
+}
+
+//-----------------------------------------------------
+// Validate a BN sprite and collect statistics without loading it
+//-----------------------------------------------------
+bool BNSprite::ScanBN
+(
+    wstring const& _fileName,
+    ScanInfo& _info,
+    string& _errorMsg
+)
+{
+    vector<uint8_t> buffer;
+    if (!LoadFileToBuffer(_fileName, buffer))
     {
         _errorMsg = "Unable to open file!";
-        fclose(f);
         return false;
     }
 
-    // File size
-    fseek(f, 0, SEEK_END);
-    uint32_t fileSize = ftell(f);
+    return ScanBN(buffer.data(), buffer.size(), _info, _errorMsg);
+}
+
+bool BNSprite::ScanBN
+(
+    uint8_t const* _data,
+    uint32_t _size,
+    ScanInfo& _info,
+    string& _errorMsg
+)
+{
+    _info = ScanInfo();
+
+    BNSprite scanner;
+    return scanner.ParseBN(_data, _size, &_info, _errorMsg);
+}
+
+//-----------------------------------------------------
+// Validate a SF sprite and collect statistics without loading it
+//-----------------------------------------------------
+bool BNSprite::ScanSF
+(
+    wstring const& _fileName,
+    ScanInfo& _info,
+    string& _errorMsg
+)
+{
+    vector<uint8_t> buffer;
+    if (!LoadFileToBuffer(_fileName, buffer))
+    {
+        _errorMsg = "Unable to open file!";
+        return false;
+    }
+
+    return ScanSF(buffer.data(), buffer.size(), _info, _errorMsg);
+}
+
+bool BNSprite::ScanSF
+(
+    uint8_t const* _data,
+    uint32_t _size,
+    ScanInfo& _info,
+    string& _errorMsg
+)
+{
+    _info = ScanInfo();
+
+    // Nothing keeps a reference to the data while scanning
+    shared_ptr<uint8_t const> data(_data, [](uint8_t const*) {});
+    BNSprite scanner;
+    return scanner.ParseSF(data, _size, &_info, _errorMsg);
+}
+
+//-----------------------------------------------------
+// Load several sprite files on a pool of worker threads
+//-----------------------------------------------------
+void BNSprite::LoadMultiple
+(
+    vector<LoadRequest> const& _requests,
+    vector<BNSprite>& _sprites,
+    vector<LoadResult>& _results,
+    unsigned _threadCount // = 0
+)
+{
+    _sprites.clear();
+    _sprites.resize(_requests.size());
+    _results.clear();
+    _results.resize(_requests.size());
+
+    // Sprites share no state, so each file can load on any thread
+    RunParallel(_requests.size(), _threadCount, [&](size_t _index)
+    {
+        LoadRequest const& request = _requests[_index];
+        LoadResult& result = _results[_index];
+        if (request.m_sfFormat)
+        {
+            result.m_success = _sprites[_index].LoadSF(request.m_fileName, result.m_errorMsg);
+        }
+        else
+        {
+            result.m_success = _sprites[_index].LoadBN(request.m_fileName, result.m_errorMsg);
+        }
+    });
+}
+
+//-----------------------------------------------------
+// Run tasks on a pool of worker threads, each worker takes the next index until all are done
+//-----------------------------------------------------
+void BNSprite::RunParallel
+(
+    size_t _count,
+    unsigned _threadCount,
+    function<void(size_t)> const& _task
+)
+{
+    atomic<size_t> next(0);
+    auto worker = [&]()
+    {
+        for (size_t i = next++; i < _count; i = next++)
+        {
+            _task(i);
+        }
+    };
+
+    if (_threadCount == 0)
+    {
+        _threadCount = max(1u, thread::hardware_concurrency());
+    }
+    size_t const threadCount = min<size_t>(_threadCount, _count);
+    if (threadCount <= 1)
+    {
+        worker();
+        return;
+    }
+
+    vector<thread> pool;
+    pool.reserve(threadCount);
+    for (size_t i = 0; i < threadCount; i++)
+    {
+        pool.emplace_back(worker);
+    }
+    for (thread& t : pool)
+    {
+        t.join();
+    }
+}
+
+//-----------------------------------------------------
+// Parse a SF sprite, only collect statistics if _scan is given
+//-----------------------------------------------------
+bool BNSprite::ParseSF
+(
+    shared_ptr<uint8_t const> const& _data,
+    uint32_t _size,
+    ScanInfo* _scan,
+    string& _errorMsg
+)
+{
+    typedef struct
+    {
+        uint16_t tileNum;
+        uint16_t tileCount;
+        uint32_t fromSprite;
+    } TilesetInfo;
+
+    Clear();
+
+    bool const build = (_scan == nullptr);
+    ByteStream f(_data.get(), _size);
+    uint32_t const fileSize = _size;
 
     // Read file header
-    fseek(f, 0, SEEK_SET);
-    if (fileSize - ftell(f) < 0x14)
+    f.Seek(0);
+    if (fileSize - f.Tell() < 0x14)
     {
         _errorMsg = "Incomplete file header";
-        fclose(f);
         return false;
     }
     uint32_t tsetHdrOffs = ReadInt(f);
@@ -656,39 +1019,35 @@ bool BNSprite::LoadSF
     if (tsetHdrOffs > fileSize)
     {
         _errorMsg = "Invalid offset for tilesets segment";
-        fclose(f);
         return false;
     }
     if (palsHdrOffs > fileSize)
     {
         _errorMsg = "Invalid offset for palettes segment";
-        fclose(f);
         return false;
     }
     if (animHdrOffs > fileSize)
     {
         _errorMsg = "Invalid offset for animations segment";
-        fclose(f);
         return false;
     }
     if (sprsHdrOffs > fileSize)
     {
         _errorMsg = "Invalid offset for sprites segment";
-        fclose(f);
         return false;
     }
 
     // Read palettes header
     std::cout << "Reading palettes header..." << endl;
-    fseek(f, palsHdrOffs, SEEK_SET);
-    if (fileSize - ftell(f) < 0x4)
+    f.Seek(palsHdrOffs);
+    if (fileSize - f.Tell() < 0x4)
     {
         _errorMsg = "Incomplete palettes header";
-        fclose(f);
         return false;
     }
     PaletteGroup palGrp;
     m_paletteGroups.push_back(palGrp);
+    uint32_t paletteCount = 0;
     uint16_t colDepth = ReadShort(f);
     uint16_t palCountMax = ReadShort(f);
     uint16_t palSize = 0;
@@ -715,31 +1074,37 @@ bool BNSprite::LoadSF
     }
 
     // Figure out the end of the palettes block (probably animations...)
-    long blockEnd = fileSize;
-    if (tsetHdrOffs > palsHdrOffs && (long)tsetHdrOffs < blockEnd)
+    uint32_t blockEnd = fileSize;
+    if (tsetHdrOffs > palsHdrOffs && tsetHdrOffs < blockEnd)
     {
         blockEnd = tsetHdrOffs;
     }
-    if (animHdrOffs > palsHdrOffs && (long)animHdrOffs < blockEnd)
+    if (animHdrOffs > palsHdrOffs && animHdrOffs < blockEnd)
     {
         blockEnd = animHdrOffs;
     }
-    if (sprsHdrOffs > palsHdrOffs && (long)sprsHdrOffs < blockEnd)
+    if (sprsHdrOffs > palsHdrOffs && sprsHdrOffs < blockEnd)
     {
         blockEnd = sprsHdrOffs;
     }
 
     // Read palettes
     std::cout << "Reading palettes..." << endl;
-    for (size_t i = 0; ftell(f) < blockEnd; i++)
+    for (size_t i = 0; f.Tell() < blockEnd; i++)
     {
-        if (fileSize - ftell(f) < palSize * 0x2)
+        if (fileSize - f.Tell() < palSize * 0x2)
         {
             _errorMsg = "Palette " + to_string(i) + " ended prematurely";
-            fclose(f);
             return false;
         }
 
+        paletteCount++;
+        if (!build)
+        {
+            f.Skip(palSize * 0x2);
+            continue;
+        }
+
         Palette pal;
         for (size_t j = 0; j < palSize; j++)
         {
@@ -750,30 +1115,31 @@ bool BNSprite::LoadSF
 
     // Read sprites header
     std::cout << "Reading sprites header..." << endl;
-    fseek(f, sprsHdrOffs, SEEK_SET);
-    if (fileSize - ftell(f) < 4)
+    f.Seek(sprsHdrOffs);
+    if (fileSize - f.Tell() < 4)
     {
         _errorMsg = "Incomplete sprites header";
-        fclose(f);
         return false;
     }
     uint16_t spriteCount = ReadShort(f);
-    fseek(f, 2, SEEK_CUR); // skip padding (?)
+    f.Skip(2); // skip padding (?)
 
     // Read sprite pointers
     std::cout << "Reading sprite pointers..." << endl;
     vector<uint32_t> spritePtrs;
-    vector<Frame> sprites;
+    vector<FrameEntry> sprites;
+    FrameStore spriteStore;
+    vector<uint32_t> spriteOAMCounts;
     vector<bool> spriteUsed;
     spritePtrs.reserve(spriteCount);
-    sprites.reserve(spriteCount);
+    sprites.reserve(build ? spriteCount : 0);
+    spriteOAMCounts.reserve(spriteCount);
     spriteUsed.reserve(spriteCount);
     for (size_t i = 0; i < spriteCount; i++)
     {
-        if (fileSize - ftell(f) < 0x4)
+        if (fileSize - f.Tell() < 0x4)
         {
             _errorMsg = "Missing sprite pointer for sprite " + to_string(i);
-            fclose(f);
             return false;
         }
 
@@ -781,7 +1147,6 @@ bool BNSprite::LoadSF
         if (ptr > fileSize)
         {
             _errorMsg = "Invalid sprite pointer for sprite " + to_string(i);
-            fclose(f);
             return false;
         }
 
@@ -792,18 +1157,19 @@ bool BNSprite::LoadSF
     std::cout << "Reading sprites..." << endl;
     for (size_t i = 0; i < spriteCount; i++)
     {
-        fseek(f, spritePtrs[i], SEEK_SET);
-        Frame sprite;
+        f.Seek(spritePtrs[i]);
+        FrameEntry sprite;
 
         // Read objects
-        Object obj;
+        ObjectEntry obj;
+        obj.m_subObjects.m_start = spriteStore.m_subObjects.size();
+        uint32_t oamCount = 0;
         bool last = false;
         do
         {
-            if (fileSize - ftell(f) < 0x8)
+            if (fileSize - f.Tell() < 0x8)
             {
                 _errorMsg = "Object list for sprite " + to_string(i) + " ended prematurely";
-                fclose(f);
                 return false;
             }
 
@@ -814,66 +1180,67 @@ bool BNSprite::LoadSF
 
             uint8_t size = ReadByte(f);
             uint8_t shape = ReadByte(f);
-            uint8_t sizeShape = ((size & 0x3) << 0x4) | (shape & 0x3);
-            switch (sizeShape)
-            {
-            case 0x00: subObj.m_sizeX =  8; subObj.m_sizeY =  8; break;
-            case 0x01: subObj.m_sizeX = 16; subObj.m_sizeY =  8; break;
-            case 0x02: subObj.m_sizeX =  8; subObj.m_sizeY = 16; break;
-            case 0x10: subObj.m_sizeX = 16; subObj.m_sizeY = 16; break;
-            case 0x11: subObj.m_sizeX = 32; subObj.m_sizeY =  8; break;
-            case 0x12: subObj.m_sizeX =  8; subObj.m_sizeY = 32; break;
-            case 0x20: subObj.m_sizeX = 32; subObj.m_sizeY = 32; break;
-            case 0x21: subObj.m_sizeX = 32; subObj.m_sizeY = 16; break;
-            case 0x22: subObj.m_sizeX = 16; subObj.m_sizeY = 32; break;
-            case 0x30: subObj.m_sizeX = 64; subObj.m_sizeY = 64; break;
-            case 0x31: subObj.m_sizeX = 64; subObj.m_sizeY = 32; break;
-            case 0x32: subObj.m_sizeX = 32; subObj.m_sizeY = 64; break;
-            default:
-                _errorMsg = "Invalid size/shape combination in sprite " + to_string(i) + " object " + to_string(obj.m_subObjects.size());
-                fclose(f);
+            if (!subObj.SetOAMShapeSize(shape & 0x3, size & 0x3))
+            {
+                _errorMsg = "Invalid size/shape combination in sprite " + to_string(i) + " object " + to_string(oamCount);
                 return false;
             }
 
             uint8_t flip = ReadByte(f);
-            subObj.m_hFlip = flip & 0x1;
-            subObj.m_vFlip = flip & 0x2;
+            subObj.m_attributes |= (flip & 0x3) << 4;
 
             last = ReadByte(f);
 
             subObj.m_startTile += (ReadByte(f) << (8 + tnumShift));
 
-            obj.m_subObjects.push_back(subObj);
+            if (build)
+            {
+                spriteStore.m_subObjects.push_back(subObj);
+                obj.m_subObjects.m_count++;
+            }
+            oamCount++;
         }
         while (!last);
-        sprite.m_objects.push_back(obj);
 
-        // Create dummy subanimation
-        SubFrame subFrame;
-        SubAnimation subAnim;
-        subFrame.m_objectIndex = 0;
-        subFrame.m_delay = 1;
+        spriteOAMCounts.push_back(oamCount);
+        spriteUsed.push_back(false);
+        if (!build)
+        {
+            continue;
+        }
+
+        sprite.m_objects.m_start = spriteStore.m_objects.size();
+        sprite.m_objects.m_count = 1;
+        spriteStore.m_objects.push_back(obj);
+
+        // Create dummy subanimation
+        SubFrame subFrame;
+        SubAnimationEntry subAnim;
+        subFrame.m_objectIndex = 0;
+        subFrame.m_delay = 1;
         subAnim.m_loop = true;
-        subAnim.m_subFrames.push_back(subFrame);
-        sprite.m_subAnimations.push_back(subAnim);
+        subAnim.m_subFrames.m_start = spriteStore.m_subFrames.size();
+        subAnim.m_subFrames.m_count = 1;
+        spriteStore.m_subFrames.push_back(subFrame);
+        sprite.m_subAnimations.m_start = spriteStore.m_subAnimations.size();
+        sprite.m_subAnimations.m_count = 1;
+        spriteStore.m_subAnimations.push_back(subAnim);
 
         sprites.push_back(sprite);
-        spriteUsed.push_back(false);
     }
 
     // Read tilesets header
     std::cout << "Reading tilesets header..." << endl;
-    fseek(f, tsetHdrOffs, SEEK_SET);
-    if (fileSize - ftell(f) < 0x8)
+    f.Seek(tsetHdrOffs);
+    if (fileSize - f.Tell() < 0x8)
     {
         _errorMsg = "Incomplete tilesets header";
-        fclose(f);
         return false;
     }
     uint16_t maxTileCount = ReadShort(f);
     uint16_t totalTileCount = ReadShort(f);
     uint16_t tsetHdrSize = ReadShort(f);
-    fseek(f, 2, SEEK_CUR); // skip padding (?)
+    f.Skip(2); // skip padding (?)
 
     // Read tilesets entries
     std::cout << "Reading tilesets entries..." << endl;
@@ -881,10 +1248,9 @@ bool BNSprite::LoadSF
     tsetEntries.reserve(spriteCount);
     for (size_t i = 0; i < spriteCount; i++)
     {
-        if (fileSize - ftell(f) < 0x4)
+        if (fileSize - f.Tell() < 0x4)
         {
             _errorMsg = "Incomplete tileset entry for sprite " + to_string(i);
-            fclose(f);
             return false;
         }
 
@@ -898,17 +1264,17 @@ bool BNSprite::LoadSF
         {
             return x.tileNum == entry.tileNum && x.tileCount == entry.tileCount;
         });
-        if (it != tsetEntries.end())
-        {
-            // Use existing ID
-            sprites[i].m_tilesetID = it - tsetEntries.begin();
-        }
-        else
+        uint32_t const tilesetID = it - tsetEntries.begin();
+        if (it == tsetEntries.end())
         {
             // Create new ID
-            sprites[i].m_tilesetID = tsetEntries.size();
             tsetEntries.push_back(entry);
         }
+
+        if (build)
+        {
+            sprites[i].m_tilesetID = tilesetID;
+        }
     }
 
     // Read tilesets
@@ -920,40 +1286,41 @@ bool BNSprite::LoadSF
         if (tsetPtr > fileSize)
         {
             _errorMsg = "Invalid tile offset for sprite " + to_string(tsetEntry.fromSprite);
-            fclose(f);
             return false;
         }
-        fseek(f, tsetPtr, SEEK_SET);
+        f.Seek(tsetPtr);
 
-        Tileset tset;
         uint32_t tsetSize = tsetEntry.tileCount * tileSize;
-        tset.m_data.reserve(tsetSize);
-
-        if (fileSize - ftell(f) < tsetSize)
+        if (fileSize - f.Tell() < tsetSize)
         {
             _errorMsg = "Incomplete tileset for sprite " + to_string(tsetEntry.fromSprite);
-            fclose(f);
             return false;
         }
 
-        for (uint32_t j = 0; j < tsetSize; j++)
+        if (!build)
         {
-            tset.m_data.push_back(ReadByte(f));
+            _scan->m_tilesetCount++;
+            continue;
         }
+
+        // Only reference the file, data is copied when the tileset is edited
+        Tileset tset;
+        tset.m_source = _data;
+        tset.m_sourceOffset = tsetPtr;
+        tset.m_sourceSize = tsetSize;
         m_tilesets.push_back(tset);
     }
 
     // Read animations
     std::cout << "Reading animations header..." << endl;
-    fseek(f, animHdrOffs, SEEK_SET);
-    if (fileSize - ftell(f) < 0x4)
+    f.Seek(animHdrOffs);
+    if (fileSize - f.Tell() < 0x4)
     {
         _errorMsg = "Incomplete animations header";
-        fclose(f);
         return false;
     }
     uint16_t animCount = ReadShort(f);
-    fseek(f, 2, SEEK_CUR); // skip padding (?)
+    f.Skip(2); // skip padding (?)
 
     // Read animation pointers
     std::cout << "Reading animation pointers..." << endl;
@@ -961,10 +1328,9 @@ bool BNSprite::LoadSF
     animPtrs.reserve(animCount);
     for (size_t i = 0; i < animCount; i++)
     {
-        if (fileSize - ftell(f) < 0x4)
+        if (fileSize - f.Tell() < 0x4)
         {
             _errorMsg = "Missing animation pointer for animation " + to_string(i);
-            fclose(f);
             return false;
         }
 
@@ -972,7 +1338,6 @@ bool BNSprite::LoadSF
         if (ptr > fileSize)
         {
             _errorMsg = "Invalid animation pointer for animation " + to_string(i);
-            fclose(f);
             return false;
         }
 
@@ -981,19 +1346,23 @@ bool BNSprite::LoadSF
 
     // Read animations
     std::cout << "Reading animations..." << endl;
-    m_animations.reserve(animCount);
+    if (build)
+    {
+        m_animations.reserve(animCount);
+    }
     for (size_t i = 0; i < animCount; i++)
     {
-        fseek(f, animPtrs[i], SEEK_SET);
+        f.Seek(animPtrs[i]);
 
-        Animation anim;
+        AnimationEntry anim;
+        anim.m_frames.m_start = m_store.m_frames.size();
+        uint32_t frameCount = 0;
         uint8_t loop;
         do
         {
-            if (fileSize - ftell(f) < 0x4)
+            if (fileSize - f.Tell() < 0x4)
             {
                 _errorMsg = "Animation " + to_string(i) + " ended prematurely";
-                fclose(f);
                 return false;
             }
 
@@ -1002,44 +1371,89 @@ bool BNSprite::LoadSF
             loop = ReadByte(f);
             uint8_t palIdx = ReadByte(f);
 
-            Frame frame = sprites[sprIdx];
-            frame.m_delay = delay;
-            frame.m_objects[0].m_paletteIndex = palIdx;
+            if (sprIdx >= spriteCount)
+            {
+                _errorMsg = "Invalid sprite index for animation " + to_string(i) + " frame " + to_string(frameCount);
+                return false;
+            }
+
             spriteUsed[sprIdx] = true;
 
-            if (palIdx >= m_paletteGroups[0].m_palettes.size())
+            if (palIdx >= paletteCount)
             {
-                _errorMsg = "Invalid palette index for animation " + to_string(i) + " frame " + to_string(anim.m_frames.size());
-                fclose(f);
+                _errorMsg = "Invalid palette index for animation " + to_string(i) + " frame " + to_string(frameCount);
                 return false;
             }
 
-            anim.m_frames.push_back(frame);
+            frameCount++;
+            if (build)
+            {
+                FrameEntry frame = m_store.Append(spriteStore, sprites[sprIdx]);
+                frame.m_delay = delay;
+                m_store.m_objects[frame.m_objects.m_start].m_paletteIndex = palIdx;
+                m_store.m_frames.push_back(frame);
+                anim.m_frames.m_count++;
+            }
+            else
+            {
+                _scan->m_frameCount++;
+                _scan->m_oamCount += spriteOAMCounts[sprIdx];
+            }
         }
         while (!(loop & 0xC0));
         anim.m_loop = loop & 0x40;
 
-        m_animations.push_back(anim);
+        if (build)
+        {
+            m_animations.push_back(anim);
+        }
+        else
+        {
+            _scan->m_animationCount++;
+        }
     }
 
     // Make extra animation for all unused sprites
     auto it = find(spriteUsed.begin(), spriteUsed.end(), false);
     if (it != spriteUsed.end())
     {
-        Animation anim;
+        AnimationEntry anim;
+        anim.m_frames.m_start = m_store.m_frames.size();
 
         for (size_t i = 0; i < spriteCount; i++)
         {
             if (spriteUsed[i]) continue;
 
-            anim.m_frames.push_back(sprites[i]);
+            if (build)
+            {
+                m_store.m_frames.push_back(m_store.Append(spriteStore, sprites[i]));
+                anim.m_frames.m_count++;
+            }
+            else
+            {
+                _scan->m_frameCount++;
+                _scan->m_oamCount += spriteOAMCounts[i];
+            }
         }
 
-        m_animations.push_back(anim);
+        if (build)
+        {
+            m_animations.push_back(anim);
+        }
+        else
+        {
+            _scan->m_animationCount++;
+        }
     }
 
-    fclose(f);
-    m_loaded = true;
+    if (!build)
+    {
+        _scan->m_256ColorMode = m_256ColorMode;
+        _scan->m_paletteGroupCount = 1;
+        _scan->m_paletteCount = paletteCount;
+    }
+
+    m_loaded = build;
     return true;
 }
 
@@ -1052,6 +1466,32 @@ bool BNSprite::SaveBN
     string& _errorMsg
 )
 {
+    vector<uint8_t> buffer;
+    if (!SaveBN(buffer, _errorMsg))
+    {
+        return false;
+    }
+
+    if (!SaveBufferToFile(_fileName, buffer.data(), buffer.size()))
+    {
+        _errorMsg = "Unable to open file!";
+        return false;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------
+// Serialize a sprite to memory, return false if fail
+//-----------------------------------------------------
+bool BNSprite::SaveBN
+(
+    vector<uint8_t>& _data,
+    string& _errorMsg
+)
+{
+    _data.clear();
+
     if (m_256ColorMode)
     {
         _errorMsg = "BN sprite does not support 256 palette colors!";
@@ -1061,13 +1501,13 @@ bool BNSprite::SaveBN
     // Check if sprite is valid for BN sprite
     for (uint32_t a = 0; a < m_animations.size(); a++)
     {
-        Animation const& anim = m_animations[a];
-        for (uint32_t b = 0; b < anim.m_frames.size(); b++)
+        AnimationEntry const& anim = m_animations[a];
+        for (uint32_t b = 0; b < anim.m_frames.m_count; b++)
         {
-            Frame const& frame = anim.m_frames[b];
-            for (uint32_t c = 0; c < frame.m_objects.size(); c++)
+            FrameEntry const& frame = GetFrameEntry(anim, b);
+            for (uint32_t c = 0; c < frame.m_objects.m_count; c++)
             {
-                Object const& object = frame.m_objects[c];
+                ObjectEntry const& object = m_store.m_objects[frame.m_objects.m_start + c];
                 if (object.m_paletteIndex > 0x0F)
                 {
                     _errorMsg = "Animation " + to_string(a) + " frame " + to_string(b) + " object " + to_string(c) + ": "
@@ -1075,9 +1515,9 @@ bool BNSprite::SaveBN
                     return false;
                 }
 
-                for (uint32_t d = 0; d < object.m_subObjects.size(); d++)
+                for (uint32_t d = 0; d < object.m_subObjects.m_count; d++)
                 {
-                    SubObject const& subObj = object.m_subObjects[d];
+                    SubObject const& subObj = m_store.m_subObjects[object.m_subObjects.m_start + d];
                     if (subObj.m_startTile > 255)
                     {
                         _errorMsg = "Animation " + to_string(a) + " frame " + to_string(b) + " object " + to_string(c) + " OAM " + to_string(d) + ": "
@@ -1089,17 +1529,18 @@ bool BNSprite::SaveBN
         }
     }
 
-    FILE* f;
-    _wfopen_s(&f, _fileName.c_str(), L"wb");
-    if (!f)
+    // Build the whole file in memory, pointers are patched in place
+    // Tilesets make up most of the file, reserve for them up front
+    uint32_t tilesetBytes = 0;
+    for (Tileset const& tileset : m_tilesets)
     {
-        _errorMsg = "Unable to open file!";
-        fclose(f);
-        return false;
+        tilesetBytes += tileset.GetSize() + 0x04;
     }
+    _data.reserve(tilesetBytes + 0x1000);
+    ByteBuffer f(_data);
 
     // SKIPPED: Largest tileset
-    fseek(f, 0x01, SEEK_SET);
+    f.Seek(0x01);
 
     // Write metadata
     WriteByte(f, 0x00);
@@ -1107,23 +1548,24 @@ bool BNSprite::SaveBN
     WriteByte(f, static_cast<uint8_t>(m_animations.size()));
 
     // SKIPPED: Animation pointers
-    fseek(f, 0x04 * m_animations.size(), SEEK_CUR);
+    f.Skip(0x04 * m_animations.size());
 
     // SKIPPED: All frame data
     // Also check what tileset, palette is used
     set<uint32_t> tilesetUsed;
     set<uint32_t> paletteUsed;
     uint32_t totalFrameCount = 0;
-    for (Animation const& anim : m_animations)
+    for (AnimationEntry const& anim : m_animations)
     {
-        totalFrameCount += anim.m_frames.size();
-        for (Frame const& frame : anim.m_frames)
+        totalFrameCount += anim.m_frames.m_count;
+        for (uint32_t i = 0; i < anim.m_frames.m_count; i++)
         {
+            FrameEntry const& frame = GetFrameEntry(anim, i);
             tilesetUsed.insert(frame.m_tilesetID);
             paletteUsed.insert(frame.m_paletteGroupID);
         }
     }
-    fseek(f, 0x14 * totalFrameCount, SEEK_CUR);
+    f.Skip(0x14 * totalFrameCount);
 
     // Write tileset data
     uint8_t largestTileCount = 0;
@@ -1139,19 +1581,16 @@ bool BNSprite::SaveBN
         }
 
         Tileset const& tileset = m_tilesets[i];
-        tilesetPtrs.push_back(ftell(f) - 0x04);
-        WriteInt(f, tileset.m_data.size());
-        for (uint8_t const& byte : tileset.m_data)
-        {
-            WriteByte(f, byte);
-        }
+        tilesetPtrs.push_back(f.Tell() - 0x04);
+        WriteInt(f, tileset.GetSize());
+        WriteBytes(f, tileset.GetData(), tileset.GetSize());
 
         // Find the largest tile set size
-        uint32_t tileCount = tileset.m_data.size() / 0x20;
+        uint32_t tileCount = tileset.GetSize() / 0x20;
         tileCount = tileCount > 0xFF ? 0xFF : tileCount;
         largestTileCount = tileCount > largestTileCount ? static_cast<uint8_t>(tileCount) : largestTileCount;
     }
-    assert(ftell(f) % 0x04 == 0x00);
+    assert(f.Tell() % 0x04 == 0x00);
 
     // Write palette data
     vector<uint32_t> palettePtrs;
@@ -1166,7 +1605,7 @@ bool BNSprite::SaveBN
         }
 
         PaletteGroup const& paletteGroup = m_paletteGroups[i];
-        palettePtrs.push_back(ftell(f) - 0x04);
+        palettePtrs.push_back(f.Tell() - 0x04);
         WriteInt(f, 0x00000020);
         for (Palette const& palette : paletteGroup.m_palettes)
         {
@@ -1176,33 +1615,35 @@ bool BNSprite::SaveBN
             }
         }
     }
-    assert(ftell(f) % 0x04 == 0x00);
+    assert(f.Tell() % 0x04 == 0x00);
 
     // Write sub animations
     vector<uint32_t> subAnimGroupPtrs;
     subAnimGroupPtrs.reserve(totalFrameCount);
-    for (Animation const& anim : m_animations)
+    vector<uint32_t> subAnimPtrs; // reused by every frame
+    for (AnimationEntry const& anim : m_animations)
     {
-        for (Frame const& frame : anim.m_frames)
+        for (uint32_t j = 0; j < anim.m_frames.m_count; j++)
         {
-            uint32_t subAnimGroupPtr = ftell(f);
+            FrameEntry const& frame = GetFrameEntry(anim, j);
+            uint32_t subAnimGroupPtr = f.Tell();
             subAnimGroupPtrs.push_back(subAnimGroupPtr - 0x04);
 
             // SKIPPED: sub animation pointers
-            fseek(f, 0x04 * frame.m_subAnimations.size(), SEEK_CUR);
+            f.Skip(0x04 * frame.m_subAnimations.m_count);
 
             // Write sub frames
-            vector<uint32_t> subAnimPtrs;
-            subAnimPtrs.reserve(frame.m_subAnimations.size());
-            for (SubAnimation const& subAnim : frame.m_subAnimations)
+            subAnimPtrs.clear();
+            for (uint32_t k = frame.m_subAnimations.m_start; k < frame.m_subAnimations.End(); k++)
             {
-                subAnimPtrs.push_back(ftell(f) - subAnimGroupPtr);
-                for (uint32_t i = 0; i < subAnim.m_subFrames.size(); i++)
+                SubAnimationEntry const& subAnim = m_store.m_subAnimations[k];
+                subAnimPtrs.push_back(f.Tell() - subAnimGroupPtr);
+                for (uint32_t i = 0; i < subAnim.m_subFrames.m_count; i++)
                 {
-                    SubFrame const& subFrame = subAnim.m_subFrames[i];
+                    SubFrame const& subFrame = m_store.m_subFrames[subAnim.m_subFrames.m_start + i];
                     WriteByte(f, subFrame.m_objectIndex);
                     WriteByte(f, subFrame.m_delay);
-                    WriteByte(f, i < subAnim.m_subFrames.size() - 1 ? 0x00 : (subAnim.m_loop ? 0xC0 : 0x80));
+                    WriteByte(f, i < subAnim.m_subFrames.m_count - 1 ? 0x00 : (subAnim.m_loop ? 0xC0 : 0x80));
                 }
 
                 // Ends with FF FF FF
@@ -1212,120 +1653,49 @@ bool BNSprite::SaveBN
             }
 
             // Go back and write sub animation pointers
-            uint32_t endAddress = ftell(f);
-            fseek(f, subAnimGroupPtr, SEEK_SET);
+            uint32_t endAddress = f.Tell();
+            f.Seek(subAnimGroupPtr);
             for (uint32_t const& subAnimPtr : subAnimPtrs)
             {
                 WriteInt(f, subAnimPtr);
             }
-            fseek(f, endAddress, SEEK_SET);
+            f.Seek(endAddress);
             AlignFourBytes(f);
         }
     }
 
     // Write objects
+    bool paletteClamped = false;
     vector<uint32_t> objectGroupPtrs;
     objectGroupPtrs.reserve(totalFrameCount);
+    vector<uint32_t> objectPtrs; // reused by every frame
     for (uint32_t i = 0; i < m_animations.size(); i++)
     {
-        Animation& anim = m_animations[i];
-        for (Frame& frame : anim.m_frames)
+        AnimationEntry const& anim = m_animations[i];
+        for (uint32_t k = 0; k < anim.m_frames.m_count; k++)
         {
-            uint32_t objectGroupPtr = ftell(f);
+            FrameEntry const& frame = GetFrameEntry(anim, k);
+            uint32_t objectGroupPtr = f.Tell();
             objectGroupPtrs.push_back(objectGroupPtr - 0x04);
 
             // SKIPPED: object pointers
-            fseek(f, 0x04 * frame.m_objects.size(), SEEK_CUR);
+            f.Skip(0x04 * frame.m_objects.m_count);
 
             // Write sub objects
-            vector<uint32_t> objectPtrs;
-            objectPtrs.reserve(frame.m_objects.size());
-            for (Object& object : frame.m_objects)
+            objectPtrs.clear();
+            for (uint32_t l = frame.m_objects.m_start; l < frame.m_objects.End(); l++)
             {
-                objectPtrs.push_back(ftell(f) - objectGroupPtr);
-                for (uint32_t j = 0; j < object.m_subObjects.size(); j++)
+                ObjectEntry& object = m_store.m_objects[l];
+                objectPtrs.push_back(f.Tell() - objectGroupPtr);
+                for (uint32_t j = 0; j < object.m_subObjects.m_count; j++)
                 {
-                    SubObject const& subObject = object.m_subObjects[j];
+                    SubObject const& subObject = m_store.m_subObjects[object.m_subObjects.m_start + j];
                     WriteByte(f, subObject.m_startTile);
                     WriteByte(f, static_cast<uint8_t>(subObject.m_posX));
                     WriteByte(f, static_cast<uint8_t>(subObject.m_posY));
 
-                    uint8_t size = 0x00;
-                    uint8_t shape = 0x00;
-                    if (subObject.m_sizeX == 8 && subObject.m_sizeY == 8)
-                    {
-                        size = 0x00;
-                        shape = 0x00;
-                    }
-                    else if (subObject.m_sizeX == 16 && subObject.m_sizeY == 8)
-                    {
-                        size = 0x00;
-                        shape = 0x01;
-                    }
-                    else if (subObject.m_sizeX == 8 && subObject.m_sizeY == 16)
-                    {
-                        size = 0x00;
-                        shape = 0x02;
-                    }
-                    else if (subObject.m_sizeX == 16 && subObject.m_sizeY == 16)
-                    {
-                        size = 0x01;
-                        shape = 0x00;
-                    }
-                    else if (subObject.m_sizeX == 32 && subObject.m_sizeY == 8)
-                    {
-                        size = 0x01;
-                        shape = 0x01;
-                    }
-                    else if (subObject.m_sizeX == 8 && subObject.m_sizeY == 32)
-                    {
-                        size = 0x01;
-                        shape = 0x02;
-                    }
-                    else if (subObject.m_sizeX == 32 && subObject.m_sizeY == 32)
-                    {
-                        size = 0x02;
-                        shape = 0x00;
-                    }
-                    else if (subObject.m_sizeX == 32 && subObject.m_sizeY == 16)
-                    {
-                        size = 0x02;
-                        shape = 0x01;
-                    }
-                    else if (subObject.m_sizeX == 16 && subObject.m_sizeY == 32)
-                    {
-                        size = 0x02;
-                        shape = 0x02;
-                    }
-                    else if (subObject.m_sizeX == 64 && subObject.m_sizeY == 64)
-                    {
-                        size = 0x03;
-                        shape = 0x00;
-                    }
-                    else if (subObject.m_sizeX == 64 && subObject.m_sizeY == 32)
-                    {
-                        size = 0x03;
-                        shape = 0x01;
-                    }
-                    else if (subObject.m_sizeX == 32 && subObject.m_sizeY == 64)
-                    {
-                        size = 0x03;
-                        shape = 0x02;
-                    }
-                    else
-                    {
-                        assert(false);
-                    }
-
-                    uint8_t flag1 = size;
-                    if (subObject.m_vFlip)
-                    {
-                        flag1 |= 0x80;
-                    }
-                    if (subObject.m_hFlip)
-                    {
-                        flag1 |= 0x40;
-                    }
+                    uint8_t const shape = subObject.GetOAMShape();
+                    uint8_t const flag1 = subObject.GetOAMSize() | ((subObject.m_attributes & 0x30) << 2);
                     WriteByte(f, flag1);
 
                     // clamp the palette index within no. of palettes in the group
@@ -1333,6 +1703,7 @@ bool BNSprite::SaveBN
                     if (object.m_paletteIndex >= paletteGroupSize)
                     {
                         object.m_paletteIndex = paletteGroupSize - 1;
+                        paletteClamped = true;
                     }
 
                     uint8_t flag2 = shape;
@@ -1350,13 +1721,13 @@ bool BNSprite::SaveBN
             }
 
             // Go back and write object pointers
-            uint32_t endAddress = ftell(f);
-            fseek(f, objectGroupPtr, SEEK_SET);
+            uint32_t endAddress = f.Tell();
+            f.Seek(objectGroupPtr);
             for (uint32_t const& objectPtr : objectPtrs)
             {
                 WriteInt(f, objectPtr);
             }
-            fseek(f, endAddress, SEEK_SET);
+            f.Seek(endAddress);
             AlignFourBytes(f, i < m_animations.size() - 1);
         }
     }
@@ -1364,14 +1735,14 @@ bool BNSprite::SaveBN
     // Go back and write frame data
     vector<uint32_t> animationPtrs;
     animationPtrs.reserve(m_animations.size());
-    fseek(f, 0x04 + 0x04 * m_animations.size(), SEEK_SET);
+    f.Seek(0x04 + 0x04 * m_animations.size());
     uint32_t currentFrameID = 0;
-    for (Animation const& animation : m_animations)
+    for (AnimationEntry const& animation : m_animations)
     {
-        animationPtrs.push_back(ftell(f) - 0x04);
-        for (uint32_t i = 0; i < animation.m_frames.size(); i++)
+        animationPtrs.push_back(f.Tell() - 0x04);
+        for (uint32_t i = 0; i < animation.m_frames.m_count; i++)
         {
-            Frame const& frame = animation.m_frames[i];
+            FrameEntry const& frame = GetFrameEntry(animation, i);
             WriteInt(f, tilesetPtrs[frame.m_tilesetID]);
             WriteInt(f, palettePtrs[frame.m_paletteGroupID]);
             WriteInt(f, subAnimGroupPtrs[currentFrameID]);
@@ -1387,7 +1758,7 @@ bool BNSprite::SaveBN
             {
                 flag |= 0x02;
             }
-            if (i == animation.m_frames.size() - 1)
+            if (i == animation.m_frames.m_count - 1)
             {
                 flag |= (animation.m_loop ? 0xC0 : 0x80);
             }
@@ -1397,17 +1768,21 @@ bool BNSprite::SaveBN
     }
 
     // Go back and write animation pointers
-    fseek(f, 0x04, SEEK_SET);
+    f.Seek(0x04);
     for (uint8_t i = 0; i < m_animations.size(); i++)
     {
         WriteInt(f, animationPtrs[i]);
     }
 
     // Go back and write the largest tileset count
-    fseek(f, 0x00, SEEK_SET);
+    f.Seek(0x00);
     WriteByte(f, largestTileCount);
 
-    fclose(f);
+    if (paletteClamped)
+    {
+        DropSnapshotNodes();
+    }
+
     return true;
 }
 
@@ -1417,6 +1792,29 @@ bool BNSprite::SaveSF
     string& _errorMsg
 )
 {
+    vector<uint8_t> buffer;
+    if (!SaveSF(buffer, _errorMsg))
+    {
+        return false;
+    }
+
+    if (!SaveBufferToFile(_fileName, buffer.data(), buffer.size()))
+    {
+        _errorMsg = "Unable to open file!";
+        return false;
+    }
+
+    return true;
+}
+
+bool BNSprite::SaveSF
+(
+    vector<uint8_t>& _data,
+    string& _errorMsg
+)
+{
+    _data.clear();
+
     typedef struct
     {
         uint16_t tileNum;
@@ -1432,7 +1830,7 @@ bool BNSprite::SaveSF
 
     // Get all unique sprites
     // Also check what tilesets are used
-    vector<Frame> sprites;
+    vector<FrameEntry> sprites;
     vector<vector<size_t>> spriteIdxes;
     vector<Tileset> tsets;
     vector<TilesetInfo> tsetEntries;
@@ -1445,34 +1843,36 @@ bool BNSprite::SaveSF
     size_t tileSize = m_256ColorMode ? 0x40 : 0x20;
     for (size_t i = 0; i < m_animations.size(); i++)
     {
-        Animation const& anim = m_animations[i];
+        AnimationEntry const& anim = m_animations[i];
         vector<size_t> animSpriteIdxes;
-        animSpriteIdxes.reserve(anim.m_frames.size());
+        animSpriteIdxes.reserve(anim.m_frames.m_count);
 
-        for (size_t j = 0; j < anim.m_frames.size(); j++)
+        for (size_t j = 0; j < anim.m_frames.m_count; j++)
         {
-            Frame const& frame = anim.m_frames[j];
+            FrameEntry const& frame = GetFrameEntry(anim, j);
 
             // Check if sprite is valid for SF
-            if (frame.m_subAnimations.size() > 1 ||
-                frame.m_subAnimations[0].m_subFrames.size() > 1)
+            if (frame.m_subAnimations.m_count > 1 ||
+                m_store.m_subAnimations[frame.m_subAnimations.m_start].m_subFrames.m_count > 1)
             {
                 _errorMsg = "Animation " + to_string(i) + " frame " + to_string(j) + ": "
                           + "SF sprite does not support sub animations";
                 return false;
             }
-            if (frame.m_objects.size() > 1)
+            if (frame.m_objects.m_count > 1)
             {
                 _errorMsg = "Animation " + to_string(i) + " frame " + to_string(j) + ": "
                           + "SF sprite does not support multiple object lists";
                 return false;
             }
+            Range const& subObjects = m_store.m_objects[frame.m_objects.m_start].m_subObjects;
+
             // Check for odd tiles
             if (!m_256ColorMode)
             {
-                for (SubObject subObj : frame.m_objects[0].m_subObjects)
+                for (uint32_t k = subObjects.m_start; k < subObjects.End(); k++)
                 {
-                    if (subObj.m_startTile & 1)
+                    if (m_store.m_subObjects[k].m_startTile & 1)
                     {
                         _errorMsg = "Animation " + to_string(i) + " frame " + to_string(j) + ": "
                                   + "SF sprite does not support odd tile number in 16-color mode";
@@ -1485,7 +1885,7 @@ bool BNSprite::SaveSF
             if (tsetIdxes[frame.m_tilesetID] == -1)
             {
                 Tileset tset = m_tilesets[frame.m_tilesetID];
-                size_t tsetSize = tset.m_data.size() / tileSize;
+                size_t tsetSize = tset.GetSize() / tileSize;
 
                 // Add tileset
                 tsetIdxes[frame.m_tilesetID] = (int)tsets.size();
@@ -1506,7 +1906,7 @@ bool BNSprite::SaveSF
             }
 
             // Find duplicate sprites
-            auto it = find_if(sprites.begin(), sprites.end(), [&frame] (const Frame& x)
+            auto it = find_if(sprites.begin(), sprites.end(), [&] (FrameEntry const& x)
             {
                 // Tileset needs to match
                 if (frame.m_tilesetID != x.m_tilesetID)
@@ -1514,35 +1914,21 @@ bool BNSprite::SaveSF
                     return false;
                 }
 
-                // Objects need to match
-                if (frame.m_objects.size() != x.m_objects.size())
+                // Objects need to match, there is only one object in SF
+                Range const& otherSubObjects = m_store.m_objects[x.m_objects.m_start].m_subObjects;
+                if (subObjects.m_count != otherSubObjects.m_count)
                 {
                     return false;
                 }
 
-                // Check each object
-                for (size_t i = 0; i < frame.m_objects.size(); i++)
+                for (size_t k = 0; k < subObjects.m_count; k++)
                 {
-                    if (frame.m_objects[i].m_subObjects.size() != x.m_objects[i].m_subObjects.size())
-                    {
-                        return false;
-                    }
+                    SubObject const& a = m_store.m_subObjects[subObjects.m_start + k];
+                    SubObject const& b = m_store.m_subObjects[otherSubObjects.m_start + k];
 
-                    for (size_t j = 0; j < frame.m_objects[i].m_subObjects.size(); j++)
+                    if (a != b)
                     {
-                        SubObject const& a = frame.m_objects[i].m_subObjects[j];
-                        SubObject const& b = x.m_objects[i].m_subObjects[j];
-
-                        if (a.m_startTile != b.m_startTile ||
-                            a.m_posX != b.m_posX ||
-                            a.m_posY != b.m_posY ||
-                            a.m_sizeX != b.m_sizeX ||
-                            a.m_sizeY != b.m_sizeY ||
-                            a.m_hFlip != b.m_hFlip ||
-                            a.m_vFlip != b.m_vFlip)
-                        {
-                            return false;
-                        }
+                        return false;
                     }
                 }
 
@@ -1572,23 +1958,17 @@ bool BNSprite::SaveSF
         return false;
     }
 
-    FILE* f;
-    _wfopen_s(&f, _fileName.c_str(), L"wb");
-    if (!f)
-    {
-        _errorMsg = "Unable to open file!";
-        fclose(f);
-        return false;
-    }
+    // Build the whole file in memory, header is patched at the end
+    ByteBuffer f(_data);
 
     // Write tilesets header
-    fseek(f, 0x14, SEEK_SET);
-    uint32_t tsetHdrOffs = ftell(f);
+    f.Seek(0x14);
+    uint32_t tsetHdrOffs = f.Tell();
     WriteShort(f, tsetSizeMax);
     WriteShort(f, tsetSizeTotal);
     WriteShort(f, 0x8 + sprites.size() * 0x4); // header size
     AlignFourBytes(f);
-    for (Frame const& sprite : sprites)
+    for (FrameEntry const& sprite : sprites)
     {
         TilesetInfo entry = tsetEntries[tsetIdxes[sprite.m_tilesetID]];
         WriteShort(f, entry.tileCount);
@@ -1598,15 +1978,12 @@ bool BNSprite::SaveSF
     // Write tilesets
     for (Tileset const& tset : tsets)
     {
-        for (uint8_t const& b : tset.m_data)
-        {
-            WriteByte(f, b);
-        }
+        WriteBytes(f, tset.GetData(), tset.GetSize());
     }
     AlignFourBytes(f);
 
     // Write palettes header
-    uint32_t palsHdrOffs = ftell(f);
+    uint32_t palsHdrOffs = f.Tell();
     WriteShort(f, m_256ColorMode ? 0x6 : 0x5); // color mode
     WriteShort(f, m_paletteGroups[0].m_palettes.size()); // palette count
 
@@ -1621,28 +1998,29 @@ bool BNSprite::SaveSF
     AlignFourBytes(f);
 
     // Write animations header
-    uint32_t animHdrOffs = ftell(f);
+    uint32_t animHdrOffs = f.Tell();
     WriteShort(f, m_animations.size());
     AlignFourBytes(f);
     uint32_t animPtr = 0x4 + m_animations.size() * 0x4;
-    for (Animation const& anim : m_animations)
+    for (AnimationEntry const& anim : m_animations)
     {
         WriteInt(f, animPtr);
-        animPtr += anim.m_frames.size() * 0x4;
+        animPtr += anim.m_frames.m_count * 0x4;
     }
 
     // Write animations
+    bool paletteClamped = false;
     for (size_t i = 0; i < m_animations.size(); i++)
     {
-        Animation& anim = m_animations[i];
-        for (size_t j = 0; j < anim.m_frames.size(); j++)
+        AnimationEntry const& anim = m_animations[i];
+        for (size_t j = 0; j < anim.m_frames.m_count; j++)
         {
-            Frame& frame = anim.m_frames[j];
+            FrameEntry const& frame = GetFrameEntry(anim, j);
             size_t sprIdx = spriteIdxes[i][j];
 
             WriteByte(f, sprIdx);
             WriteByte(f, frame.m_delay);
-            if (j == anim.m_frames.size() - 1)
+            if (j == anim.m_frames.m_count - 1)
             {
                 WriteByte(f, anim.m_loop ? 0x40 : 0x80);
             }
@@ -1653,10 +2031,11 @@ bool BNSprite::SaveSF
 
             // clamp the palette index within no. of palettes in the group
             uint32_t paletteGroupSize = m_paletteGroups[0].m_palettes.size();
-            uint8_t& paletteIndex = frame.m_objects[0].m_paletteIndex;
+            uint8_t& paletteIndex = m_store.m_objects[frame.m_objects.m_start].m_paletteIndex;
             if (paletteIndex >= paletteGroupSize)
             {
                 paletteIndex = paletteGroupSize - 1;
+                paletteClamped = true;
             }
             WriteByte(f, paletteIndex);
         }
@@ -1664,45 +2043,30 @@ bool BNSprite::SaveSF
     AlignFourBytes(f);
 
     // Write sprites header
-    uint32_t sprsHdrOffs = ftell(f);
+    uint32_t sprsHdrOffs = f.Tell();
     WriteShort(f, sprites.size());
     AlignFourBytes(f);
     uint32_t spritePtr = 0x4 + sprites.size() * 0x4;
-    for (Frame const& sprite : sprites)
+    for (FrameEntry const& sprite : sprites)
     {
         WriteInt(f, spritePtr);
-        spritePtr += sprite.m_objects[0].m_subObjects.size() * 0x8;
+        spritePtr += m_store.m_objects[sprite.m_objects.m_start].m_subObjects.m_count * 0x8;
     }
 
     // Write sprites
     uint8_t tnumShift = m_256ColorMode ? 0 : 1;
-    for (Frame const& sprite : sprites)
-    {
-        vector<SubObject> const& subObjs = sprite.m_objects[0].m_subObjects;
-        for (size_t i = 0; i < subObjs.size(); i++)
-        {
-            SubObject const& subObj = subObjs[i];
-
-            uint8_t size = 0;
-            uint8_t shape = 0;
-            if (subObj.m_sizeX ==  8 && subObj.m_sizeY ==  8) { size = 0; shape = 0; }
-            if (subObj.m_sizeX == 16 && subObj.m_sizeY ==  8) { size = 0; shape = 1; }
-            if (subObj.m_sizeX ==  8 && subObj.m_sizeY == 16) { size = 0; shape = 2; }
-            if (subObj.m_sizeX == 16 && subObj.m_sizeY == 16) { size = 1; shape = 0; }
-            if (subObj.m_sizeX == 32 && subObj.m_sizeY ==  8) { size = 1; shape = 1; }
-            if (subObj.m_sizeX ==  8 && subObj.m_sizeY == 32) { size = 1; shape = 2; }
-            if (subObj.m_sizeX == 32 && subObj.m_sizeY == 32) { size = 2; shape = 0; }
-            if (subObj.m_sizeX == 32 && subObj.m_sizeY == 16) { size = 2; shape = 1; }
-            if (subObj.m_sizeX == 16 && subObj.m_sizeY == 32) { size = 2; shape = 2; }
-            if (subObj.m_sizeX == 64 && subObj.m_sizeY == 64) { size = 3; shape = 0; }
-            if (subObj.m_sizeX == 64 && subObj.m_sizeY == 32) { size = 3; shape = 1; }
-            if (subObj.m_sizeX == 32 && subObj.m_sizeY == 64) { size = 3; shape = 2; }
-
-            uint8_t flip = 0;
-            flip |= subObj.m_hFlip ? 0x1 : 0x0;
-            flip |= subObj.m_vFlip ? 0x2 : 0x0;
-
-            bool last = i == subObjs.size() - 1;
+    for (FrameEntry const& sprite : sprites)
+    {
+        Range const& subObjs = m_store.m_objects[sprite.m_objects.m_start].m_subObjects;
+        for (size_t i = 0; i < subObjs.m_count; i++)
+        {
+            SubObject const& subObj = m_store.m_subObjects[subObjs.m_start + i];
+
+            uint8_t const size = subObj.GetOAMSize();
+            uint8_t const shape = subObj.GetOAMShape();
+            uint8_t const flip = (subObj.m_attributes >> 4) & 0x3;
+
+            bool last = i == subObjs.m_count - 1;
 
             WriteByte(f, subObj.m_startTile >> tnumShift);
             WriteByte(f, subObj.m_posX);
@@ -1717,14 +2081,18 @@ bool BNSprite::SaveSF
     AlignFourBytes(f);
 
     // Write file header
-    fseek(f, 0, SEEK_SET);
+    f.Seek(0);
     WriteInt(f, tsetHdrOffs);
     WriteInt(f, palsHdrOffs);
     WriteInt(f, animHdrOffs);
     WriteInt(f, sprsHdrOffs);
     WriteInt(f, 1); // starting tile number shift, used by game
 
-    fclose(f);
+    if (paletteClamped)
+    {
+        DropSnapshotNodes();
+    }
+
     return true;
 }
 
@@ -1737,193 +2105,431 @@ bool BNSprite::Merge
     string& _errorMsg
 )
 {
-    if (m_256ColorMode != _other.m_256ColorMode)
-    {
-        _errorMsg = "Cannot merge 16 color mode sprite with 256 color mode sprite!";
-        return false;
-    }
+    MergeIndex index;
+    BuildMergeIndex(index);
+    return MergeSprite(_other, index, _errorMsg);
+}
 
-    if (_other.m_animations.size() + m_animations.size() > 255)
+//-----------------------------------------------------
+// Merge with multiple sprites in order
+//-----------------------------------------------------
+bool BNSprite::Merge
+(
+    vector<BNSprite const*> const& _others,
+    uint32_t& _mergedCount,
+    string& _errorMsg
+)
+{
+    _mergedCount = 0;
+
+    // Reserve once for everything so the storage doesn't regrow for each sprite
+    size_t animationCount = m_animations.size();
+    size_t frameCount = m_store.m_frames.size();
+    size_t subAnimationCount = m_store.m_subAnimations.size();
+    size_t subFrameCount = m_store.m_subFrames.size();
+    size_t objectCount = m_store.m_objects.size();
+    size_t subObjectCount = m_store.m_subObjects.size();
+    for (BNSprite const* other : _others)
     {
-        _errorMsg = "Total no. of animations exceed 255!";
-        return false;
+        animationCount += other->m_animations.size();
+        frameCount += other->m_store.m_frames.size();
+        subAnimationCount += other->m_store.m_subAnimations.size();
+        subFrameCount += other->m_store.m_subFrames.size();
+        objectCount += other->m_store.m_objects.size();
+        subObjectCount += other->m_store.m_subObjects.size();
     }
-
-    if (m_256ColorMode)
+    m_animations.reserve(animationCount);
+    m_store.m_frames.reserve(frameCount);
+    m_store.m_subAnimations.reserve(subAnimationCount);
+    m_store.m_subFrames.reserve(subFrameCount);
+    m_store.m_objects.reserve(objectCount);
+    m_store.m_subObjects.reserve(subObjectCount);
+
+    // Hash existing content once, merged content is added to it as we go
+    MergeIndex index;
+    BuildMergeIndex(index);
+    for (BNSprite const* other : _others)
     {
-        if (m_paletteGroups[0].m_palettes.size() + _other.m_paletteGroups[0].m_palettes.size() > 256)
+        if (!MergeSprite(*other, index, _errorMsg))
         {
-            _errorMsg = "Total no. of palette exceed 256!";
             return false;
         }
+        _mergedCount++;
     }
 
-    // Merge tileset
-    int const tilesetIDStart = m_tilesets.size();
-    for (Tileset const& tileset : _other.m_tilesets)
+    return true;
+}
+
+//-----------------------------------------------------
+// FNV-1a hash
+//-----------------------------------------------------
+uint64_t BNSprite::HashBytes
+(
+    void const* _data,
+    size_t _size,
+    uint64_t _hash
+)
+{
+    uint8_t const* bytes = reinterpret_cast<uint8_t const*>(_data);
+    for (size_t i = 0; i < _size; i++)
+    {
+        _hash ^= bytes[i];
+        _hash *= 0x100000001B3ull;
+    }
+    return _hash;
+}
+
+//-----------------------------------------------------
+// Hash every palette of a group, with their sizes as separators
+//-----------------------------------------------------
+uint64_t BNSprite::HashPaletteGroup
+(
+    PaletteGroup const& _group
+)
+{
+    uint64_t hash = HashBytes(nullptr, 0);
+    for (Palette const& palette : _group.m_palettes)
+    {
+        uint32_t const count = palette.m_colors.size();
+        hash = HashBytes(&count, sizeof(count), hash);
+        hash = HashBytes(palette.m_colors.data(), count * sizeof(uint16_t), hash);
+    }
+    return hash;
+}
+
+//-----------------------------------------------------
+// Hash the current tilesets and palettes
+//-----------------------------------------------------
+void BNSprite::BuildMergeIndex
+(
+    MergeIndex& _index
+) const
+{
+    _index.m_tilesets.clear();
+    _index.m_palettes.clear();
+
+    for (uint32_t i = 0; i < m_tilesets.size(); i++)
     {
-        m_tilesets.push_back(tileset);
+        _index.m_tilesets.insert(make_pair(HashBytes(m_tilesets[i].GetData(), m_tilesets[i].GetSize()), i));
     }
 
-    int const paletteGroupIDStart = m_paletteGroups.size();
-    int const paletteIDStart = m_paletteGroups[0].m_palettes.size();
     if (m_256ColorMode)
     {
-        // 256 color merge to single group
-        for (Palette const& pal : _other.m_paletteGroups[0].m_palettes)
+        if (m_paletteGroups.empty()) return;
+
+        vector<Palette> const& palettes = m_paletteGroups[0].m_palettes;
+        for (uint32_t i = 0; i < palettes.size(); i++)
         {
-            m_paletteGroups[0].m_palettes.push_back(pal);
+            _index.m_palettes.insert(make_pair(HashBytes(palettes[i].m_colors.data(), palettes[i].m_colors.size() * sizeof(uint16_t)), i));
         }
     }
     else
     {
-        // 16 color append new groups
-        for (PaletteGroup const& group : _other.m_paletteGroups)
+        for (uint32_t i = 0; i < m_paletteGroups.size(); i++)
         {
-            m_paletteGroups.push_back(group);
+            _index.m_palettes.insert(make_pair(HashPaletteGroup(m_paletteGroups[i]), i));
         }
     }
+}
 
-    // Merge animations, fix tileset ID
-    for (Animation anim : _other.m_animations)
+//-----------------------------------------------------
+// Return the ID of an identical tileset, append it if there's none
+//-----------------------------------------------------
+uint32_t BNSprite::AddTileset
+(
+    MergeIndex& _index,
+    Tileset const& _tileset
+)
+{
+    uint64_t const hash = HashBytes(_tileset.GetData(), _tileset.GetSize());
+    auto range = _index.m_tilesets.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it)
     {
-        for (Frame& frame : anim.m_frames)
+        Tileset const& existing = m_tilesets[it->second];
+        if (existing.GetSize() == _tileset.GetSize() && memcmp(existing.GetData(), _tileset.GetData(), _tileset.GetSize()) == 0)
         {
-            frame.m_tilesetID += tilesetIDStart;
-
-            if (m_256ColorMode)
-            {
-                // 256 color fix palette ID
-                frame.m_objects[0].m_paletteIndex += paletteIDStart;
-            }
-            else
-            {
-                // 16 color fix palette group ID
-                frame.m_paletteGroupID += paletteGroupIDStart;
-            }
+            return it->second;
         }
-        m_animations.push_back(anim);
     }
 
-    return true;
+    uint32_t const tilesetID = m_tilesets.size();
+    m_tilesets.push_back(_tileset);
+    _index.m_tilesets.insert(make_pair(hash, tilesetID));
+    return tilesetID;
 }
 
 //-----------------------------------------------------
-// Convert BN sprite to be compatible with SF sprite
-//
+// Return the index of an identical palette in group 0, append it if there's none
 //-----------------------------------------------------
-bool BNSprite::ConvertBNtoSF
+uint32_t BNSprite::AddPalette
 (
-    bool &_modified,
-    string& _errorMsg
+    MergeIndex& _index,
+    Palette const& _palette
 )
 {
-    if (!m_loaded)
+    vector<Palette>& palettes = m_paletteGroups[0].m_palettes;
+    uint64_t const hash = HashBytes(_palette.m_colors.data(), _palette.m_colors.size() * sizeof(uint16_t));
+    auto range = _index.m_palettes.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it)
     {
-        _errorMsg = "Not loaded";
-        return false;
+        if (palettes[it->second] == _palette)
+        {
+            return it->second;
+        }
     }
 
-    _modified = false;
+    uint32_t const paletteID = palettes.size();
+    palettes.push_back(_palette);
+    _index.m_palettes.insert(make_pair(hash, paletteID));
+    return paletteID;
+}
 
-    // SF doesn't support sub animations or multiple objects
-    for (uint32_t i = 0; i < m_animations.size(); i++)
+//-----------------------------------------------------
+// Return the ID of an identical palette group, append it if there's none
+//-----------------------------------------------------
+uint32_t BNSprite::AddPaletteGroup
+(
+    MergeIndex& _index,
+    PaletteGroup const& _group
+)
+{
+    uint64_t const hash = HashPaletteGroup(_group);
+    auto range = _index.m_palettes.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it)
     {
-        Animation const& anim = m_animations[i];
-        for (uint32_t j = 0; j < anim.m_frames.size(); j++)
+        if (m_paletteGroups[it->second] == _group)
         {
-            Frame const& frame = anim.m_frames[j];
-            if (frame.m_subAnimations.size() > 1 || frame.m_subAnimations[0].m_subFrames.size() > 1)
-            {
-                _errorMsg = "Animation " + to_string(i) + " frame " + to_string(j) + ": "
-                          + "SF sprite does not support sub animations";
-                return false;
-            }
-            if (frame.m_objects.size() > 1)
-            {
-                _errorMsg = "Animation " + to_string(i) + " frame " + to_string(j) + ": "
-                          + "SF sprite does not support multiple object lists";
-                return false;
-            }
+            return it->second;
         }
     }
 
-    // For custom sprites, palette group is empty until export
-    if (m_paletteGroups.empty())
+    uint32_t const paletteGroupID = m_paletteGroups.size();
+    m_paletteGroups.push_back(_group);
+    _index.m_palettes.insert(make_pair(hash, paletteGroupID));
+    return paletteGroupID;
+}
+
+//-----------------------------------------------------
+// Merge one sprite using an index of the current content
+//-----------------------------------------------------
+bool BNSprite::MergeSprite
+(
+    BNSprite const& _other,
+    MergeIndex& _index,
+    string& _errorMsg
+)
+{
+    if (m_256ColorMode != _other.m_256ColorMode)
     {
-        _errorMsg = "Please export sprite before converting!";
+        _errorMsg = "Cannot merge 16 color mode sprite with 256 color mode sprite!";
         return false;
     }
 
-    // Combine all palette group into one
-    if (m_paletteGroups.size() > 1)
+    if (_other.m_animations.size() + m_animations.size() > 255)
     {
-        uint16_t paletteCount = 0;
-        vector<uint16_t> paletteStart;
+        _errorMsg = "Total no. of animations exceed 255!";
+        return false;
+    }
 
-        for (PaletteGroup const& palGroup : m_paletteGroups)
+    // Merge palettes, only new content is appended
+    vector<uint32_t> paletteRemap;
+    if (m_256ColorMode)
+    {
+        // 256 color merge to single group
+        vector<Palette>& palettes = m_paletteGroups[0].m_palettes;
+        uint32_t const paletteCount = palettes.size();
+        for (Palette const& pal : _other.m_paletteGroups[0].m_palettes)
         {
-            paletteStart.push_back(paletteCount);
-            paletteCount += palGroup.m_palettes.size();
+            paletteRemap.push_back(AddPalette(_index, pal));
         }
 
-        if (paletteCount > 256)
+        if (palettes.size() > 256)
         {
-            _errorMsg = "There are more than 256 palettes, cannot combine them into one group.";
+            // Undo the palettes added by this sprite
+            palettes.resize(paletteCount);
+            for (auto it = _index.m_palettes.begin(); it != _index.m_palettes.end();)
+            {
+                it = it->second >= paletteCount ? _index.m_palettes.erase(it) : next(it);
+            }
+
+            _errorMsg = "Total no. of palette exceed 256!";
             return false;
         }
+    }
+    else
+    {
+        // 16 color append new groups
+        for (PaletteGroup const& group : _other.m_paletteGroups)
+        {
+            paletteRemap.push_back(AddPaletteGroup(_index, group));
+        }
+    }
 
-        _modified = true;
+    // Merge tileset
+    vector<uint32_t> tilesetRemap;
+    for (Tileset const& tileset : _other.m_tilesets)
+    {
+        tilesetRemap.push_back(AddTileset(_index, tileset));
+    }
 
-        // Combine palettes and leave the first one
-        PaletteGroup& palGroupFirst = m_paletteGroups[0];
-        for (uint32_t i = 1; i < m_paletteGroups.size(); i++)
+    // Merge animations, fix tileset and palette IDs
+    for (AnimationEntry const& otherAnim : _other.m_animations)
+    {
+        AnimationEntry anim;
+        anim.m_loop = otherAnim.m_loop;
+        anim.m_frames.m_start = m_store.m_frames.size();
+        for (uint32_t i = 0; i < otherAnim.m_frames.m_count; i++)
         {
-            PaletteGroup const& palGroup = m_paletteGroups[i];
-            for (Palette const& pal : palGroup.m_palettes)
+            FrameEntry frame = m_store.Append(_other.m_store, _other.m_store.m_frames[otherAnim.m_frames.m_start + i]);
+            frame.m_snapshot = FrameNode();
+            if (frame.m_tilesetID < tilesetRemap.size())
             {
-                palGroupFirst.m_palettes.push_back(pal);
+                frame.m_tilesetID = tilesetRemap[frame.m_tilesetID];
             }
-        }
-        m_paletteGroups.resize(1);
 
-        // Fix palette group and index for all frames
-        for (Animation& anim : m_animations)
-        {
-            for (Frame& frame : anim.m_frames)
+            if (m_256ColorMode)
             {
-                uint32_t const groupID = frame.m_paletteGroupID;
-                if (groupID == 0)
+                // 256 color fix palette ID
+                for (uint32_t j = frame.m_objects.m_start; j < frame.m_objects.End(); j++)
                 {
-                    continue;
+                    ObjectEntry& object = m_store.m_objects[j];
+                    if (object.m_paletteIndex < paletteRemap.size())
+                    {
+                        object.m_paletteIndex = paletteRemap[object.m_paletteIndex];
+                    }
                 }
+            }
+            else if (frame.m_paletteGroupID < paletteRemap.size())
+            {
+                // 16 color fix palette group ID
+                frame.m_paletteGroupID = paletteRemap[frame.m_paletteGroupID];
+            }
 
-                for (Object& obj : frame.m_objects)
-                {
-                    obj.m_paletteIndex += paletteStart[groupID];
-                }
+            m_store.m_frames.push_back(frame);
+            anim.m_frames.m_count++;
+        }
+        m_animations.push_back(anim);
+    }
 
-                frame.m_paletteGroupID = 0;
+    return true;
+}
+
+//-----------------------------------------------------
+// Check ConvertBNtoSF() would succeed without changing anything.
+// Padding can't always make every start tile even, that is checked too
+//-----------------------------------------------------
+bool BNSprite::CanConvertBNtoSF
+(
+    string& _errorMsg
+) const
+{
+    if (!m_loaded)
+    {
+        _errorMsg = "Not loaded";
+        return false;
+    }
+
+    // SF doesn't support sub animations or multiple objects
+    for (uint32_t i = 0; i < m_animations.size(); i++)
+    {
+        AnimationEntry const& anim = m_animations[i];
+        for (uint32_t j = 0; j < anim.m_frames.m_count; j++)
+        {
+            FrameEntry const& frame = GetFrameEntry(anim, j);
+            if (frame.m_tilesetID >= m_tilesets.size())
+            {
+                _errorMsg = "Animation " + to_string(i) + " frame " + to_string(j) + ": "
+                          + "tileset does not exist";
+                return false;
+            }
+            if (frame.m_subAnimations.m_count > 1 || m_store.m_subAnimations[frame.m_subAnimations.m_start].m_subFrames.m_count > 1)
+            {
+                _errorMsg = "Animation " + to_string(i) + " frame " + to_string(j) + ": "
+                          + "SF sprite does not support sub animations";
+                return false;
+            }
+            if (frame.m_objects.m_count > 1)
+            {
+                _errorMsg = "Animation " + to_string(i) + " frame " + to_string(j) + ": "
+                          + "SF sprite does not support multiple object lists";
+                return false;
             }
         }
     }
 
-    typedef vector<uint16_t> OddOAMList;
+    // For custom sprites, palette group is empty until export
+    if (m_paletteGroups.empty())
+    {
+        _errorMsg = "Please export sprite before converting!";
+        return false;
+    }
+
+    uint32_t paletteCount = 0;
+    for (PaletteGroup const& palGroup : m_paletteGroups)
+    {
+        paletteCount += palGroup.m_palettes.size();
+    }
+    if (m_paletteGroups.size() > 1 && paletteCount > 256)
+    {
+        _errorMsg = "There are more than 256 palettes, cannot combine them into one group.";
+        return false;
+    }
+
+    // Every OAM has to end up on an even tile once the padding is inserted
     vector<OddOAMList> listPerTileset;
-    listPerTileset.resize(m_tilesets.size());
+    GetOddOAMLists(listPerTileset);
+    for (uint32_t i = 0; i < m_animations.size(); i++)
+    {
+        AnimationEntry const& anim = m_animations[i];
+        for (uint32_t j = 0; j < anim.m_frames.m_count; j++)
+        {
+            FrameEntry const& frame = GetFrameEntry(anim, j);
+            OddOAMList const& list = listPerTileset[frame.m_tilesetID];
+            ObjectEntry const& obj = m_store.m_objects[frame.m_objects.m_start];
+            for (uint32_t k = obj.m_subObjects.m_start; k < obj.m_subObjects.End(); k++)
+            {
+                uint16_t const startTile = m_store.m_subObjects[k].m_startTile;
+                uint32_t const tileToAdd = upper_bound(list.begin(), list.end(), startTile) - list.begin();
+                if ((startTile + tileToAdd) % 2 != 0)
+                {
+                    _errorMsg = "Animation " + to_string(i) + " frame " + to_string(j) + ": "
+                              + "OAM at tile " + to_string(startTile) + " cannot be moved to an even tile";
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------
+// Find the odd start tiles of each tileset that need a blank tile
+// inserted before them, sorted in ascending order
+//-----------------------------------------------------
+void BNSprite::GetOddOAMLists
+(
+    vector<OddOAMList>& _listPerTileset
+) const
+{
+    _listPerTileset.clear();
+    _listPerTileset.resize(m_tilesets.size());
 
     // Find all odd number OAMs
-    for (Animation const& anim : m_animations)
+    vector<uint16_t> startTiles; // reused by every frame
+    for (AnimationEntry const& anim : m_animations)
     {
-        for (Frame const& frame : anim.m_frames)
+        for (uint32_t i = 0; i < anim.m_frames.m_count; i++)
         {
-            OddOAMList& list = listPerTileset[frame.m_tilesetID];
-            Object const& obj = frame.m_objects[0];
+            FrameEntry const& frame = GetFrameEntry(anim, i);
+            OddOAMList& list = _listPerTileset[frame.m_tilesetID];
+            ObjectEntry const& obj = m_store.m_objects[frame.m_objects.m_start];
 
             // Get a list of unique m_startTile and sort them (accending)
-            vector<uint16_t> startTiles;
-            for (SubObject const& subObj : obj.m_subObjects)
+            startTiles.clear();
+            for (uint32_t j = obj.m_subObjects.m_start; j < obj.m_subObjects.End(); j++)
             {
+                SubObject const& subObj = m_store.m_subObjects[j];
                 auto it = find(startTiles.begin(), startTiles.end(), subObj.m_startTile);
                 if (it == startTiles.end())
                 {
@@ -1943,7 +2549,6 @@ bool BNSprite::ConvertBNtoSF
                     auto it = find(list.begin(), list.end(), startTile);
                     if (it == list.end())
                     {
-                        _modified = true;
                         list.push_back(startTile);
                     }
                 }
@@ -1951,36 +2556,113 @@ bool BNSprite::ConvertBNtoSF
         }
     }
 
-    // Sort the OAM list
-    for (OddOAMList& list : listPerTileset)
+    for (OddOAMList& list : _listPerTileset)
+    {
+        sort(list.begin(), list.end());
+    }
+}
+
+//-----------------------------------------------------
+// Convert BN sprite to be compatible with SF sprite
+//
+//-----------------------------------------------------
+bool BNSprite::ConvertBNtoSF
+(
+    bool &_modified,
+    string& _errorMsg
+)
+{
+    _modified = false;
+
+    // Nothing is changed unless the whole conversion can succeed
+    if (!CanConvertBNtoSF(_errorMsg))
+    {
+        return false;
+    }
+
+    // Combine all palette group into one
+    if (m_paletteGroups.size() > 1)
     {
-        if (!list.empty())
+        uint16_t paletteCount = 0;
+        vector<uint16_t> paletteStart;
+
+        for (PaletteGroup const& palGroup : m_paletteGroups)
+        {
+            paletteStart.push_back(paletteCount);
+            paletteCount += palGroup.m_palettes.size();
+        }
+
+        _modified = true;
+
+        // Combine palettes and leave the first one
+        PaletteGroup& palGroupFirst = m_paletteGroups[0];
+        for (uint32_t i = 1; i < m_paletteGroups.size(); i++)
+        {
+            PaletteGroup const& palGroup = m_paletteGroups[i];
+            for (Palette const& pal : palGroup.m_palettes)
+            {
+                palGroupFirst.m_palettes.push_back(pal);
+            }
+        }
+        m_paletteGroups.resize(1);
+
+        // Fix palette group and index for all frames
+        for (AnimationEntry const& anim : m_animations)
         {
-            sort(list.begin(), list.end());
+            for (uint32_t i = 0; i < anim.m_frames.m_count; i++)
+            {
+                FrameEntry& frame = GetFrameEntry(anim, i);
+                uint32_t const groupID = frame.m_paletteGroupID;
+                if (groupID == 0)
+                {
+                    continue;
+                }
+
+                for (uint32_t j = frame.m_objects.m_start; j < frame.m_objects.End(); j++)
+                {
+                    m_store.m_objects[j].m_paletteIndex += paletteStart[groupID];
+                }
+
+                frame.m_paletteGroupID = 0;
+            }
         }
     }
 
+    vector<OddOAMList> listPerTileset;
+    GetOddOAMLists(listPerTileset);
+    for (OddOAMList const& list : listPerTileset)
+    {
+        _modified = _modified || !list.empty();
+    }
+
     // Pad 8x8 before them (start from the back)
     for(uint32_t i = 0; i < m_tilesets.size(); i++)
     {
-        Tileset& tileset = m_tilesets[i];
         OddOAMList const& list = listPerTileset[i];
+        if (list.empty())
+        {
+            continue;
+        }
+
+        vector<uint8_t>& data = m_tilesets[i].GetMutableData();
         for (int j = list.size() - 1; j >= 0; j--)
         {
             uint16_t const tileStart = list[j];
-            tileset.m_data.insert(tileset.m_data.begin() + tileStart * 32, 32, 0);
+            data.insert(data.begin() + tileStart * 32, 32, 0);
         }
     }
 
     // Fix OAM to even numbers
-    for (Animation& anim : m_animations)
+    for (AnimationEntry const& anim : m_animations)
     {
-        for (Frame& frame : anim.m_frames)
+        for (uint32_t i = 0; i < anim.m_frames.m_count; i++)
         {
+            FrameEntry const& frame = GetFrameEntry(anim, i);
             OddOAMList const& list = listPerTileset[frame.m_tilesetID];
-            Object& obj = frame.m_objects[0];
-            for (SubObject& subObj : obj.m_subObjects)
+            ObjectEntry const& obj = m_store.m_objects[frame.m_objects.m_start];
+            for (uint32_t j = obj.m_subObjects.m_start; j < obj.m_subObjects.End(); j++)
             {
+                SubObject& subObj = m_store.m_subObjects[j];
                 uint16_t tileToAdd = 0;
                 for (uint16_t const& oddOAMTileStart : list)
                 {
@@ -1995,68 +2677,332 @@ bool BNSprite::ConvertBNtoSF
         }
     }
 
-    return true;
-}
-
-//-----------------------------------------------------
-// Get all frames in an animation
-//-----------------------------------------------------
-void BNSprite::GetAnimationFrames
-(
-    int _animID,
-    vector<BNSprite::Frame> &_frames
-)
-{
-    _frames.clear();
-    if (_animID < 0 || _animID >= m_animations.size()) return;
-
-    Animation const& anim = m_animations[_animID];
-    for(Frame const& frame : anim.m_frames)
+    if (_modified)
     {
-        _frames.push_back(frame);
+        DropSnapshotNodes();
     }
+
+    return true;
 }
 
 //-----------------------------------------------------
-// Get tileset data from ID
+// Point OAMs at an earlier block with the same pixels in any of the
+// four flips, then remove the tiles nothing uses anymore.
+// Tiles that were never used by any OAM are kept as they are, and
+// the sprite is left untouched if no tile can be removed
 //-----------------------------------------------------
-void BNSprite::GetTilesetPixels
-(
-    int _tilesetID,
-    vector<uint8_t> &_data
-)
+uint32_t BNSprite::RemoveDuplicateTiles()
 {
-    _data.clear();
-    if (_tilesetID < 0 || _tilesetID >= m_tilesets.size()) return;
-
-    for (uint8_t const& byte : m_tilesets[_tilesetID].m_data)
+    // Sub objects of each tileset, listed once even if frames share them
+    vector<vector<uint32_t>> subObjectsPerTileset(m_tilesets.size());
+    vector<bool> listed(m_store.m_subObjects.size(), false);
+    for (AnimationEntry const& anim : m_animations)
     {
-        if (m_256ColorMode)
-        {
-            _data.push_back(byte);
-        }
-        else
+        for (uint32_t i = 0; i < anim.m_frames.m_count; i++)
         {
-            _data.push_back(byte & 0xF);
-            _data.push_back((byte & 0xF0) >> 4);
+            FrameEntry const& frame = GetFrameEntry(anim, i);
+            if (frame.m_tilesetID >= m_tilesets.size()) continue;
+
+            for (uint32_t j = frame.m_objects.m_start; j < frame.m_objects.End(); j++)
+            {
+                ObjectEntry const& obj = m_store.m_objects[j];
+                for (uint32_t k = obj.m_subObjects.m_start; k < obj.m_subObjects.End(); k++)
+                {
+                    if (!listed[k])
+                    {
+                        listed[k] = true;
+                        subObjectsPerTileset[frame.m_tilesetID].push_back(k);
+                    }
+                }
+            }
         }
     }
-}
 
-//-----------------------------------------------------
-// Get all available palettes
-//-----------------------------------------------------
-void BNSprite::GetAllPaletteGroups
-(
-    vector<BNSprite::PaletteGroup> &_paletteGroups
-)
-{
-    _paletteGroups.clear();
-    for (PaletteGroup const& group : m_paletteGroups)
+    uint32_t const tileBytes = m_256ColorMode ? 64 : 32;
+    uint32_t bytesSaved = 0;
+    bool modified = false;
+    for (uint32_t t = 0; t < m_tilesets.size(); t++)
     {
-        _paletteGroups.push_back(group);
-    }
-}
+        vector<uint32_t>& subObjects = subObjectsPerTileset[t];
+        if (subObjects.empty()) continue;
+
+        // Keep the lowest block of each duplicate set
+        sort(subObjects.begin(), subObjects.end(), [this](uint32_t _a, uint32_t _b)
+        {
+            return m_store.m_subObjects[_a].m_startTile < m_store.m_subObjects[_b].m_startTile;
+        });
+
+        vector<uint8_t> const& pixels = GetTilesetPixels(t);
+        uint32_t const tileCount = pixels.size() / 64;
+        vector<bool> usedBefore(tileCount, false);
+        vector<bool> usedAfter(tileCount, false);
+
+        // Unique blocks are hashed in all four flips, each block maps to where it is drawn from
+        unordered_multimap<uint64_t, TileBlock> uniqueBlocks;
+        map<uint32_t, TileBlock> blockSources;
+        vector<uint8_t> raster;
+        vector<uint8_t> other;
+        bool changed = false;
+
+        for (uint32_t index : subObjects)
+        {
+            SubObject const& subObj = m_store.m_subObjects[index];
+            TileBlock block;
+            block.m_startTile = subObj.m_startTile;
+            block.m_sizeX = subObj.GetSizeX();
+            block.m_sizeY = subObj.GetSizeY();
+            block.m_flip = 0;
+
+            uint32_t const key = (block.m_startTile << 16) | (block.m_sizeX << 8) | block.m_sizeY;
+            uint32_t const blockTiles = (block.m_sizeX / 8) * (block.m_sizeY / 8);
+            for (uint32_t i = block.m_startTile; i < block.m_startTile + blockTiles && i < tileCount; i++)
+            {
+                usedBefore[i] = true;
+            }
+
+            if (blockSources.count(key)) continue;
+
+            // Blocks running past the end are left alone
+            if (block.m_startTile + blockTiles > tileCount)
+            {
+                blockSources[key] = block;
+                continue;
+            }
+
+            ReadTileBlock(pixels, block, raster);
+            uint64_t const hash = HashBytes(raster.data(), raster.size());
+
+            bool found = false;
+            auto range = uniqueBlocks.equal_range(hash);
+            for (auto it = range.first; it != range.second; ++it)
+            {
+                TileBlock const& source = it->second;
+                if (source.m_sizeX != block.m_sizeX || source.m_sizeY != block.m_sizeY) continue;
+
+                ReadTileBlock(pixels, source, other);
+                if (other == raster)
+                {
+                    blockSources[key] = source;
+                    changed = true;
+                    found = true;
+                    break;
+                }
+            }
+
+            if (!found)
+            {
+                blockSources[key] = block;
+                for (uint8_t flip = 0; flip < 4; flip++)
+                {
+                    block.m_flip = flip;
+                    ReadTileBlock(pixels, block, other);
+                    uniqueBlocks.insert(make_pair(HashBytes(other.data(), other.size()), block));
+                }
+            }
+        }
+
+        if (!changed) continue;
+
+        for (auto const& source : blockSources)
+        {
+            TileBlock const& block = source.second;
+            uint32_t const blockTiles = (block.m_sizeX / 8) * (block.m_sizeY / 8);
+            for (uint32_t i = block.m_startTile; i < block.m_startTile + blockTiles && i < tileCount; i++)
+            {
+                usedAfter[i] = true;
+            }
+        }
+
+        // Remove freed tiles in pairs so every start tile keeps its parity (SF needs them even),
+        // an odd run leaves one blank tile behind
+        vector<bool> removed(tileCount, false);
+        vector<uint16_t> removedBefore(tileCount + 1, 0);
+        uint32_t runLength = 0;
+        for (uint32_t i = 0; i <= tileCount; i++)
+        {
+            if (i < tileCount && usedBefore[i] && !usedAfter[i])
+            {
+                runLength++;
+                continue;
+            }
+
+            for (uint32_t j = i - runLength; j < i - runLength % 2; j++)
+            {
+                removed[j] = true;
+            }
+            runLength = 0;
+        }
+
+        uint32_t removedCount = 0;
+        for (uint32_t i = 0; i < tileCount; i++)
+        {
+            removedBefore[i] = removedCount;
+            removedCount += removed[i] ? 1 : 0;
+        }
+        removedBefore[tileCount] = removedCount;
+
+        // Nothing is freed if the duplicates are still used elsewhere, leave the OAMs as they are
+        if (removedCount == 0) continue;
+
+        // Move OAMs to their source block
+        for (uint32_t index : subObjects)
+        {
+            SubObject& subObj = m_store.m_subObjects[index];
+            uint32_t const key = (subObj.m_startTile << 16) | (subObj.GetSizeX() << 8) | subObj.GetSizeY();
+            TileBlock const& source = blockSources[key];
+            subObj.m_startTile = source.m_startTile - removedBefore[min<uint32_t>(source.m_startTile, tileCount)];
+            subObj.SetHFlip(subObj.GetHFlip() != ((source.m_flip & 1) != 0));
+            subObj.SetVFlip(subObj.GetVFlip() != ((source.m_flip & 2) != 0));
+        }
+        modified = true;
+
+        vector<uint8_t>& data = m_tilesets[t].GetMutableData();
+        uint32_t writeTile = 0;
+        for (uint32_t i = 0; i < tileCount; i++)
+        {
+            if (removed[i]) continue;
+            if (writeTile != i)
+            {
+                memmove(&data[writeTile * tileBytes], &data[i * tileBytes], tileBytes);
+            }
+            writeTile++;
+        }
+        data.resize(data.size() - removedCount * tileBytes);
+        bytesSaved += removedCount * tileBytes;
+    }
+
+    if (modified)
+    {
+        DropSnapshotNodes();
+    }
+
+    return bytesSaved;
+}
+
+//-----------------------------------------------------
+// Copy an OAM block into a raster as it would be drawn with _block.m_flip
+//-----------------------------------------------------
+void BNSprite::ReadTileBlock
+(
+    vector<uint8_t> const& _pixels,
+    TileBlock const& _block,
+    vector<uint8_t>& _raster
+)
+{
+    int const sizeX = _block.m_sizeX;
+    int const sizeY = _block.m_sizeY;
+    int const tileXCount = sizeX / 8;
+    bool const hFlip = (_block.m_flip & 1) != 0;
+    bool const vFlip = (_block.m_flip & 2) != 0;
+
+    _raster.resize(sizeX * sizeY);
+    for (int y = 0; y < sizeY; y++)
+    {
+        for (int x = 0; x < sizeX; x++)
+        {
+            uint32_t const tile = _block.m_startTile + (y / 8) * tileXCount + x / 8;
+            int const drawX = hFlip ? sizeX - 1 - x : x;
+            int const drawY = vFlip ? sizeY - 1 - y : y;
+            _raster[drawY * sizeX + drawX] = _pixels[tile * 64 + (y % 8) * 8 + x % 8];
+        }
+    }
+}
+
+//-----------------------------------------------------
+// Get all frames in an animation
+//-----------------------------------------------------
+void BNSprite::GetAnimationFrames
+(
+    int _animID,
+    vector<BNSprite::Frame> &_frames
+)
+{
+    _frames.clear();
+    if (_animID < 0 || _animID >= m_animations.size()) return;
+
+    AnimationEntry const& anim = m_animations[_animID];
+    _frames.reserve(anim.m_frames.m_count);
+    for (uint32_t i = 0; i < anim.m_frames.m_count; i++)
+    {
+        _frames.push_back(m_store.Extract(GetFrameEntry(anim, i)));
+    }
+}
+
+//-----------------------------------------------------
+// Get tileset data from ID
+//-----------------------------------------------------
+void BNSprite::GetTilesetPixels
+(
+    int _tilesetID,
+    vector<uint8_t> &_data
+)
+{
+    _data = GetTilesetPixels(_tilesetID);
+}
+
+//-----------------------------------------------------
+// Get tileset data from ID without copying, one byte per pixel.
+// The reference is valid until the tileset is modified
+//-----------------------------------------------------
+vector<uint8_t> const& BNSprite::GetTilesetPixels
+(
+    int _tilesetID
+) const
+{
+    static vector<uint8_t> const c_empty;
+    if (_tilesetID < 0 || (size_t)_tilesetID >= m_tilesets.size()) return c_empty;
+
+    return *GetSharedTilesetPixels(_tilesetID);
+}
+
+//-----------------------------------------------------
+// Same as above but keeps the pixels alive, a different pointer
+// is returned once the tileset has been modified
+//-----------------------------------------------------
+shared_ptr<vector<uint8_t> const> BNSprite::GetSharedTilesetPixels
+(
+    int _tilesetID
+) const
+{
+    if (_tilesetID < 0 || (size_t)_tilesetID >= m_tilesets.size()) return shared_ptr<vector<uint8_t> const>();
+
+    Tileset const& tileset = m_tilesets[_tilesetID];
+    if (tileset.m_pixels && tileset.m_pixels256Color == m_256ColorMode)
+    {
+        return tileset.m_pixels;
+    }
+
+    shared_ptr<vector<uint8_t>> pixels = make_shared<vector<uint8_t>>();
+    uint8_t const* bytes = tileset.GetData();
+    if (m_256ColorMode)
+    {
+        pixels->assign(bytes, bytes + tileset.GetSize());
+    }
+    else
+    {
+        pixels->resize(tileset.GetSize() * 2);
+        for (uint32_t i = 0; i < tileset.GetSize(); i++)
+        {
+            (*pixels)[i * 2] = bytes[i] & 0xF;
+            (*pixels)[i * 2 + 1] = (bytes[i] & 0xF0) >> 4;
+        }
+    }
+
+    tileset.m_pixels = pixels;
+    tileset.m_pixels256Color = m_256ColorMode;
+    return tileset.m_pixels;
+}
+
+//-----------------------------------------------------
+// Get all available palettes
+//-----------------------------------------------------
+void BNSprite::GetAllPaletteGroups
+(
+    vector<BNSprite::PaletteGroup> &_paletteGroups
+) const
+{
+    _paletteGroups = m_paletteGroups;
+}
 
 //-----------------------------------------------------
 // Replace all palettes
@@ -2066,11 +3012,15 @@ void BNSprite::ReplaceAllPaletteGroups
     vector<BNSprite::PaletteGroup> const&_paletteGroups
 )
 {
-    m_paletteGroups.clear();
-    for (PaletteGroup const& group : _paletteGroups)
-    {
-        m_paletteGroups.push_back(group);
-    }
+    m_paletteGroups = _paletteGroups;
+}
+
+void BNSprite::ReplaceAllPaletteGroups
+(
+    vector<BNSprite::PaletteGroup>&& _paletteGroups
+)
+{
+    m_paletteGroups = move(_paletteGroups);
 }
 
 //-----------------------------------------------------
@@ -2088,186 +3038,1184 @@ BNSprite::Frame BNSprite::GetAnimationFrame
         return Frame();
     }
 
-    Animation const& anim = m_animations[_animID];
-    if (_frameID < 0 || _frameID >= anim.m_frames.size())
+    AnimationEntry const& anim = m_animations[_animID];
+    if (_frameID < 0 || _frameID >= anim.m_frames.m_count)
     {
         assert(false);
         return Frame();
     }
 
-    return anim.m_frames[_frameID];
+    return m_store.Extract(GetFrameEntry(anim, _frameID));
+}
+
+//-----------------------------------------------------
+// Get a read-only view of a frame, IDs must be valid
+//-----------------------------------------------------
+BNSprite::FrameView BNSprite::GetAnimationFrameView
+(
+    int _animID,
+    int _frameID
+) const
+{
+    assert(_animID >= 0 && (size_t)_animID < m_animations.size());
+    AnimationEntry const& anim = m_animations[_animID];
+    assert(_frameID >= 0 && (uint32_t)_frameID < anim.m_frames.m_count);
+    return FrameView(m_store, m_store.m_frames[anim.m_frames.m_start + _frameID]);
+}
+
+//-----------------------------------------------------
+// View accessors
+//-----------------------------------------------------
+BNSprite::ArrayView<BNSprite::SubFrame> BNSprite::SubAnimationView::GetSubFrames() const
+{
+    return ArrayView<SubFrame>(m_store->m_subFrames.data() + m_entry->m_subFrames.m_start, m_entry->m_subFrames.m_count);
+}
+
+BNSprite::ArrayView<BNSprite::SubObject> BNSprite::ObjectView::GetSubObjects() const
+{
+    return ArrayView<SubObject>(m_store->m_subObjects.data() + m_entry->m_subObjects.m_start, m_entry->m_subObjects.m_count);
+}
+
+BNSprite::SubAnimationView BNSprite::FrameView::GetSubAnimation
+(
+    uint32_t _index
+) const
+{
+    assert(_index < m_entry->m_subAnimations.m_count);
+    return SubAnimationView(*m_store, m_store->m_subAnimations[m_entry->m_subAnimations.m_start + _index]);
+}
+
+BNSprite::ObjectView BNSprite::FrameView::GetObject
+(
+    uint32_t _index
+) const
+{
+    assert(_index < m_entry->m_objects.m_count);
+    return ObjectView(*m_store, m_store->m_objects[m_entry->m_objects.m_start + _index]);
+}
+
+//-----------------------------------------------------
+// Edit accessors, anything that may change the frame drops its snapshot node
+//-----------------------------------------------------
+void BNSprite::ObjectEdit::SetPaletteIndex
+(
+    uint8_t _paletteIndex
+)
+{
+    if (m_entry->m_paletteIndex == _paletteIndex) return;
+    m_entry->m_paletteIndex = _paletteIndex;
+    Touch(*m_anim, *m_frame);
+}
+
+BNSprite::SubObject& BNSprite::ObjectEdit::GetSubObject
+(
+    uint32_t _index
+)
+{
+    assert(_index < m_entry->m_subObjects.m_count);
+    Touch(*m_anim, *m_frame);
+    return m_store->m_subObjects[m_entry->m_subObjects.m_start + _index];
+}
+
+void BNSprite::FrameEdit::SetTilesetID
+(
+    uint32_t _tilesetID
+)
+{
+    if (m_entry->m_tilesetID == _tilesetID) return;
+    m_entry->m_tilesetID = _tilesetID;
+    Touch(*m_anim, *m_entry);
+}
+
+void BNSprite::FrameEdit::SetPaletteGroupID
+(
+    uint32_t _paletteGroupID
+)
+{
+    if (m_entry->m_paletteGroupID == _paletteGroupID) return;
+    m_entry->m_paletteGroupID = _paletteGroupID;
+    Touch(*m_anim, *m_entry);
+}
+
+void BNSprite::FrameEdit::SetDelay
+(
+    uint8_t _delay
+)
+{
+    if (m_entry->m_delay == _delay) return;
+    m_entry->m_delay = _delay;
+    Touch(*m_anim, *m_entry);
+}
+
+BNSprite::ObjectEdit BNSprite::FrameEdit::GetObject
+(
+    uint32_t _index
+)
+{
+    assert(_index < m_entry->m_objects.m_count);
+    return ObjectEdit(*m_store, *m_anim, *m_entry, m_store->m_objects[m_entry->m_objects.m_start + _index]);
+}
+
+//-----------------------------------------------------
+// Capture the current content, only what changed since the last snapshot is copied
+//-----------------------------------------------------
+shared_ptr<BNSprite::Snapshot const> BNSprite::TakeSnapshot()
+{
+    shared_ptr<Snapshot> snapshot(new Snapshot());
+    snapshot->m_loaded = m_loaded;
+    snapshot->m_256ColorMode = m_256ColorMode;
+
+    // Changed frames are copied into one new chunk
+    shared_ptr<FrameStore> chunk = make_shared<FrameStore>();
+    snapshot->m_animations.reserve(m_animations.size());
+    for (AnimationEntry& anim : m_animations)
+    {
+        if (!anim.m_snapshot)
+        {
+            shared_ptr<AnimationNode> node = make_shared<AnimationNode>();
+            node->m_loop = anim.m_loop;
+            node->m_frames.reserve(anim.m_frames.m_count);
+            for (uint32_t i = 0; i < anim.m_frames.m_count; i++)
+            {
+                FrameEntry& frame = GetFrameEntry(anim, i);
+                if (!frame.m_snapshot.m_chunk)
+                {
+                    // Copy before linking, the chunk must not reference itself
+                    uint32_t const index = chunk->m_frames.size();
+                    chunk->m_frames.push_back(chunk->Append(m_store, frame));
+                    frame.m_snapshot.m_chunk = chunk;
+                    frame.m_snapshot.m_index = index;
+                }
+                node->m_frames.push_back(frame.m_snapshot);
+            }
+
+            snapshot->m_size += sizeof(AnimationNode) + node->m_frames.size() * sizeof(FrameNode);
+            anim.m_snapshot = node;
+        }
+        snapshot->m_animations.push_back(anim.m_snapshot);
+    }
+
+    snapshot->m_size += chunk->GetMemorySize();
+
+    // Owned tileset data is moved to a shared buffer, later edits copy it again
+    for (Tileset& tileset : m_tilesets)
+    {
+        if (!tileset.m_source)
+        {
+            uint8_t* buffer = new uint8_t[tileset.m_data.size()];
+            if (!tileset.m_data.empty())
+            {
+                memcpy(buffer, tileset.m_data.data(), tileset.m_data.size());
+            }
+
+            tileset.m_source.reset(buffer, default_delete<uint8_t[]>());
+            tileset.m_sourceOffset = 0;
+            tileset.m_sourceSize = tileset.m_data.size();
+            vector<uint8_t>().swap(tileset.m_data);
+            snapshot->m_size += tileset.m_sourceSize;
+        }
+    }
+    snapshot->m_tilesets = m_tilesets;
+
+    // Don't let the history keep unpacked pixels alive, they are rebuilt on demand
+    for (Tileset& tileset : snapshot->m_tilesets)
+    {
+        tileset.m_pixels.reset();
+    }
+
+    // Palettes are small, share them only if nothing changed
+    if (!m_paletteSnapshot || *m_paletteSnapshot != m_paletteGroups)
+    {
+        m_paletteSnapshot = make_shared<vector<PaletteGroup> const>(m_paletteGroups);
+        for (PaletteGroup const& group : m_paletteGroups)
+        {
+            for (Palette const& palette : group.m_palettes)
+            {
+                snapshot->m_size += palette.m_colors.size() * sizeof(uint16_t);
+            }
+        }
+    }
+    snapshot->m_paletteGroups = m_paletteSnapshot;
+
+    return snapshot;
+}
+
+//-----------------------------------------------------
+// Replace the content with a snapshot
+//-----------------------------------------------------
+void BNSprite::RestoreSnapshot
+(
+    Snapshot const& _snapshot
+)
+{
+    m_loaded = _snapshot.m_loaded;
+    m_256ColorMode = _snapshot.m_256ColorMode;
+
+    m_animations.clear();
+    m_store.Clear();
+    m_animations.reserve(_snapshot.m_animations.size());
+    for (shared_ptr<AnimationNode const> const& node : _snapshot.m_animations)
+    {
+        AnimationEntry anim;
+        anim.m_loop = node->m_loop;
+        anim.m_frames.m_start = m_store.m_frames.size();
+        anim.m_frames.m_count = node->m_frames.size();
+        for (FrameNode const& frameNode : node->m_frames)
+        {
+            FrameEntry frame = m_store.Append(*frameNode.m_chunk, frameNode.m_chunk->m_frames[frameNode.m_index]);
+            frame.m_snapshot = frameNode;
+            m_store.m_frames.push_back(frame);
+        }
+        anim.m_snapshot = node;
+        m_animations.push_back(anim);
+    }
+
+    m_tilesets = _snapshot.m_tilesets;
+    m_paletteGroups = *_snapshot.m_paletteGroups;
+    m_paletteSnapshot = _snapshot.m_paletteGroups;
+}
+
+//-----------------------------------------------------
+// Get a read-only view of a frame in a snapshot, IDs must be valid.
+// Snapshots never change so this can be read from any thread while it's kept
+//-----------------------------------------------------
+BNSprite::FrameView BNSprite::GetSnapshotFrameView
+(
+    Snapshot const& _snapshot,
+    int _animID,
+    int _frameID
+)
+{
+    assert(_animID >= 0 && (size_t)_animID < _snapshot.m_animations.size());
+    AnimationNode const& anim = *_snapshot.m_animations[_animID];
+    assert(_frameID >= 0 && (size_t)_frameID < anim.m_frames.size());
+    FrameNode const& node = anim.m_frames[_frameID];
+    return FrameView(*node.m_chunk, node.m_chunk->m_frames[node.m_index]);
+}
+
+//-----------------------------------------------------
+// Check if two snapshots hold the same content, only compares what is shared
+//-----------------------------------------------------
+bool BNSprite::Snapshot::IsSameAs
+(
+    Snapshot const& _other
+) const
+{
+    if (m_loaded != _other.m_loaded || m_256ColorMode != _other.m_256ColorMode) return false;
+    if (m_animations != _other.m_animations || m_paletteGroups != _other.m_paletteGroups) return false;
+    if (m_tilesets.size() != _other.m_tilesets.size()) return false;
+
+    for (uint32_t i = 0; i < m_tilesets.size(); i++)
+    {
+        Tileset const& a = m_tilesets[i];
+        Tileset const& b = _other.m_tilesets[i];
+        if (a.m_source != b.m_source || a.m_sourceOffset != b.m_sourceOffset || a.m_sourceSize != b.m_sourceSize)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------
+// Count animations, frame chunks, tileset data and palettes the same way
+// TakeSnapshot() does, skipping everything another snapshot already counted
+//-----------------------------------------------------
+void BNSprite::Snapshot::CountMemory
+(
+    set<void const*>& _counted,
+    size_t& _size
+) const
+{
+    for (shared_ptr<AnimationNode const> const& node : m_animations)
+    {
+        if (!_counted.insert(node.get()).second) continue;
+        _size += sizeof(AnimationNode) + node->m_frames.size() * sizeof(FrameNode);
+
+        for (FrameNode const& frame : node->m_frames)
+        {
+            if (_counted.insert(frame.m_chunk.get()).second)
+            {
+                _size += frame.m_chunk->GetMemorySize();
+            }
+        }
+    }
+
+    // Tilesets loaded together share one buffer, each one is counted for its own part
+    for (Tileset const& tileset : m_tilesets)
+    {
+        if (tileset.m_source && _counted.insert(tileset.GetData()).second)
+        {
+            _size += tileset.m_sourceSize;
+        }
+    }
+
+    if (m_paletteGroups && _counted.insert(m_paletteGroups.get()).second)
+    {
+        for (PaletteGroup const& group : *m_paletteGroups)
+        {
+            for (Palette const& palette : group.m_palettes)
+            {
+                _size += palette.m_colors.size() * sizeof(uint16_t);
+            }
+        }
+    }
+}
+
+//-----------------------------------------------------
+// Check if anything changed at all
+//-----------------------------------------------------
+bool BNSprite::DirtyInfo::IsDirty() const
+{
+    return m_layout
+        || find(m_animations.begin(), m_animations.end(), true) != m_animations.end()
+        || find(m_tilesets.begin(), m_tilesets.end(), true) != m_tilesets.end()
+        || find(m_paletteGroups.begin(), m_paletteGroups.end(), true) != m_paletteGroups.end();
+}
+
+//-----------------------------------------------------
+// Compare the sprite against the state it was last saved to a file in.
+// Edits drop the cached snapshot nodes, so a node that differs means a change
+//-----------------------------------------------------
+void BNSprite::GetDirtyInfo
+(
+    DirtyInfo& _info
+) const
+{
+    Snapshot const* saved = m_savedFile.m_snapshot.get();
+    _info.m_animations.assign(m_animations.size(), true);
+    _info.m_tilesets.assign(m_tilesets.size(), true);
+    _info.m_paletteGroups.assign(m_paletteGroups.size(), true);
+    _info.m_layout = true;
+    if (!saved) return;
+
+    _info.m_layout = m_256ColorMode != saved->m_256ColorMode
+                  || m_animations.size() != saved->m_animations.size()
+                  || m_tilesets.size() != saved->m_tilesets.size()
+                  || m_paletteGroups.size() != saved->m_paletteGroups->size();
+
+    for (uint32_t i = 0; i < m_animations.size() && i < saved->m_animations.size(); i++)
+    {
+        _info.m_animations[i] = m_animations[i].m_snapshot != saved->m_animations[i];
+    }
+
+    for (uint32_t i = 0; i < m_tilesets.size() && i < saved->m_tilesets.size(); i++)
+    {
+        Tileset const& a = m_tilesets[i];
+        Tileset const& b = saved->m_tilesets[i];
+        _info.m_tilesets[i] = a.m_source != b.m_source || a.m_sourceOffset != b.m_sourceOffset || a.m_sourceSize != b.m_sourceSize;
+    }
+
+    for (uint32_t i = 0; i < m_paletteGroups.size() && i < saved->m_paletteGroups->size(); i++)
+    {
+        _info.m_paletteGroups[i] = !(m_paletteGroups[i] == (*saved->m_paletteGroups)[i]);
+    }
+}
+
+//-----------------------------------------------------
+// Gather statistics in a single pass, serialized sizes are worked out
+// from the same layout SaveBN/SaveSF write instead of saving
+//-----------------------------------------------------
+void BNSprite::GetStatistics
+(
+    Statistics& _stats
+) const
+{
+    _stats = Statistics();
+    _stats.m_framesPerAnimation.reserve(m_animations.size());
+    _stats.m_tilesetReferences.assign(m_tilesets.size(), 0);
+    _stats.m_paletteGroupReferences.assign(m_paletteGroups.size(), 0);
+
+    bool bnValid = !m_256ColorMode;
+    bool sfValid = m_paletteGroups.size() == 1;
+    uint32_t bnFrameBytes = 0;
+
+    // SF stores each distinct tileset and OAM list once
+    unordered_multimap<uint64_t, FrameEntry const*> sfSprites;
+    uint32_t sfSpriteCount = 0;
+    uint32_t sfOAMCount = 0;
+
+    for (AnimationEntry const& anim : m_animations)
+    {
+        _stats.m_framesPerAnimation.push_back(anim.m_frames.m_count);
+        _stats.m_frameCount += anim.m_frames.m_count;
+
+        for (uint32_t i = 0; i < anim.m_frames.m_count; i++)
+        {
+            FrameEntry const& frame = GetFrameEntry(anim, i);
+            if (frame.m_tilesetID < m_tilesets.size())
+            {
+                _stats.m_tilesetReferences[frame.m_tilesetID]++;
+            }
+            if (frame.m_paletteGroupID < m_paletteGroups.size())
+            {
+                _stats.m_paletteGroupReferences[frame.m_paletteGroupID]++;
+            }
+
+            // BN sub animations, 3 bytes per sub frame and the end marker
+            uint32_t subAnimBytes = 0x04 * frame.m_subAnimations.m_count;
+            for (uint32_t j = frame.m_subAnimations.m_start; j < frame.m_subAnimations.End(); j++)
+            {
+                subAnimBytes += 0x03 * (m_store.m_subAnimations[j].m_subFrames.m_count + 1);
+            }
+            bnFrameBytes += (subAnimBytes + 0x03) & ~0x03;
+
+            // BN objects, 5 bytes per OAM and the end marker
+            uint32_t objectBytes = 0x04 * frame.m_objects.m_count;
+            for (uint32_t j = frame.m_objects.m_start; j < frame.m_objects.End(); j++)
+            {
+                ObjectEntry const& object = m_store.m_objects[j];
+                _stats.m_objectCount++;
+                _stats.m_oamCount += object.m_subObjects.m_count;
+                if (_stats.m_oamsPerObject.size() <= object.m_subObjects.m_count)
+                {
+                    _stats.m_oamsPerObject.resize(object.m_subObjects.m_count + 1, 0);
+                }
+                _stats.m_oamsPerObject[object.m_subObjects.m_count]++;
+
+                objectBytes += 0x05 * (object.m_subObjects.m_count + 1);
+                bnValid = bnValid && object.m_paletteIndex <= 0x0F;
+                for (uint32_t k = object.m_subObjects.m_start; k < object.m_subObjects.End(); k++)
+                {
+                    uint16_t const startTile = m_store.m_subObjects[k].m_startTile;
+                    bnValid = bnValid && startTile <= 0xFF;
+                    sfValid = sfValid && (m_256ColorMode || (startTile & 1) == 0);
+                }
+            }
+
+            // Every animation but the last pads at least one byte
+            bool const padExtra = &anim != &m_animations.back();
+            bnFrameBytes += (objectBytes + (padExtra ? 0x04 : 0x03)) & ~0x03;
+
+            // SF frames have a single object and no sub animations
+            sfValid = sfValid
+                   && frame.m_objects.m_count == 1
+                   && frame.m_subAnimations.m_count <= 1
+                   && (frame.m_subAnimations.m_count == 0 || m_store.m_subAnimations[frame.m_subAnimations.m_start].m_subFrames.m_count <= 1);
+            if (!sfValid) continue;
+
+            Range const& subObjects = m_store.m_objects[frame.m_objects.m_start].m_subObjects;
+            uint64_t hash = HashBytes(&frame.m_tilesetID, sizeof(frame.m_tilesetID));
+            for (uint32_t k = subObjects.m_start; k < subObjects.End(); k++)
+            {
+                SubObject const& subObj = m_store.m_subObjects[k];
+                hash = HashBytes(&subObj.m_startTile, sizeof(subObj.m_startTile), hash);
+                hash = HashBytes(&subObj.m_posX, sizeof(subObj.m_posX), hash);
+                hash = HashBytes(&subObj.m_posY, sizeof(subObj.m_posY), hash);
+                hash = HashBytes(&subObj.m_attributes, sizeof(subObj.m_attributes), hash);
+            }
+
+            bool found = false;
+            auto range = sfSprites.equal_range(hash);
+            for (auto it = range.first; it != range.second && !found; ++it)
+            {
+                FrameEntry const& other = *it->second;
+                Range const& otherSubObjects = m_store.m_objects[other.m_objects.m_start].m_subObjects;
+                found = other.m_tilesetID == frame.m_tilesetID
+                     && otherSubObjects.m_count == subObjects.m_count
+                     && equal(m_store.m_subObjects.begin() + subObjects.m_start,
+                              m_store.m_subObjects.begin() + subObjects.End(),
+                              m_store.m_subObjects.begin() + otherSubObjects.m_start);
+            }
+
+            if (!found)
+            {
+                sfSprites.insert(make_pair(hash, &frame));
+                sfSpriteCount++;
+                sfOAMCount += subObjects.m_count;
+            }
+        }
+    }
+    sfValid = sfValid && sfSpriteCount <= 0xFF;
+
+    // Tilesets and palette groups, only the used ones are saved
+    uint32_t const tileSize = m_256ColorMode ? 0x40 : 0x20;
+    uint32_t bnTilesetBytes = 0;
+    uint32_t sfTilesetBytes = 0;
+    _stats.m_tilesPerTileset.reserve(m_tilesets.size());
+    _stats.m_heapBytes += m_tilesets.capacity() * sizeof(Tileset);
+    for (uint32_t i = 0; i < m_tilesets.size(); i++)
+    {
+        Tileset const& tileset = m_tilesets[i];
+        _stats.m_tilesPerTileset.push_back(tileset.GetSize() / tileSize);
+
+        uint32_t const references = _stats.m_tilesetReferences[i];
+        _stats.m_sharedTilesets += references > 1 ? 1 : 0;
+        _stats.m_uniqueTilesets += references == 1 ? 1 : 0;
+        if (references > 0)
+        {
+            bnTilesetBytes += 0x04 + tileset.GetSize();
+            sfTilesetBytes += tileset.GetSize();
+        }
+
+        if (tileset.m_source)
+        {
+            _stats.m_sharedHeapBytes += tileset.m_sourceSize;
+        }
+        _stats.m_heapBytes += tileset.m_data.capacity();
+        if (tileset.m_pixels)
+        {
+            _stats.m_heapBytes += tileset.m_pixels->capacity();
+        }
+    }
+
+    uint32_t bnPaletteBytes = 0;
+    _stats.m_heapBytes += m_paletteGroups.capacity() * sizeof(PaletteGroup);
+    for (uint32_t i = 0; i < m_paletteGroups.size(); i++)
+    {
+        PaletteGroup const& paletteGroup = m_paletteGroups[i];
+        uint32_t const references = _stats.m_paletteGroupReferences[i];
+        _stats.m_sharedPaletteGroups += references > 1 ? 1 : 0;
+        _stats.m_uniquePaletteGroups += references == 1 ? 1 : 0;
+
+        uint32_t colorCount = 0;
+        _stats.m_heapBytes += paletteGroup.m_palettes.capacity() * sizeof(Palette);
+        for (Palette const& palette : paletteGroup.m_palettes)
+        {
+            colorCount += palette.m_colors.size();
+            _stats.m_heapBytes += palette.m_colors.capacity() * sizeof(uint16_t);
+        }
+
+        if (references > 0)
+        {
+            bnPaletteBytes += 0x04 + colorCount * 0x02;
+        }
+    }
+
+    if (bnValid)
+    {
+        _stats.m_bnSize = 0x04 + 0x04 * m_animations.size() + 0x14 * _stats.m_frameCount
+                        + bnTilesetBytes + bnPaletteBytes + bnFrameBytes;
+    }
+
+    if (sfValid)
+    {
+        uint32_t colorCount = 0;
+        for (Palette const& palette : m_paletteGroups[0].m_palettes)
+        {
+            colorCount += palette.m_colors.size();
+        }
+
+        uint32_t size = 0x14 + 0x08 + 0x04 * sfSpriteCount;             // header, tileset header
+        size = (size + sfTilesetBytes + 0x03) & ~0x03;                  // tilesets
+        size = (size + 0x04 + colorCount * 0x02 + 0x03) & ~0x03;        // palettes
+        size += 0x04 + 0x04 * m_animations.size();                      // animation header
+        size += 0x04 * _stats.m_frameCount;                             // frames
+        size += 0x04 + 0x04 * sfSpriteCount + 0x08 * sfOAMCount;        // sprites
+        _stats.m_sfSize = size;
+    }
+
+    // Storage of the frames, snapshot nodes shared with the undo history are not counted
+    _stats.m_heapBytes += sizeof(BNSprite)
+                        + m_animations.capacity() * sizeof(AnimationEntry)
+                        + m_store.m_frames.capacity() * sizeof(FrameEntry)
+                        + m_store.m_subAnimations.capacity() * sizeof(SubAnimationEntry)
+                        + m_store.m_subFrames.capacity() * sizeof(SubFrame)
+                        + m_store.m_objects.capacity() * sizeof(ObjectEntry)
+                        + m_store.m_subObjects.capacity() * sizeof(SubObject);
+    if (m_savedFile.m_data)
+    {
+        _stats.m_heapBytes += m_savedFile.m_data->capacity();
+    }
+}
+
+//-----------------------------------------------------
+// Save a sprite file and remember what was written. Saving to the same
+// file again only writes the changed bytes, or nothing if nothing changed.
+// Keeps a copy of the file in memory, only meant for repeated saves
+//-----------------------------------------------------
+bool BNSprite::SaveIncremental
+(
+    wstring const& _fileName,
+    bool _sfFormat,
+    string& _errorMsg
+)
+{
+    bool const sameFile = IsSavedFileUnchanged(_fileName, _sfFormat);
+    if (sameFile)
+    {
+        DirtyInfo dirty;
+        GetDirtyInfo(dirty);
+        if (!dirty.IsDirty())
+        {
+            return true;
+        }
+    }
+
+    vector<uint8_t> buffer;
+    if (!(_sfFormat ? SaveSF(buffer, _errorMsg) : SaveBN(buffer, _errorMsg)))
+    {
+        return false;
+    }
+
+    // After serializing, which can clamp palettes
+    shared_ptr<Snapshot const> snapshot = TakeSnapshot();
+
+    bool written = false;
+    if (sameFile && m_savedFile.m_data->size() == buffer.size())
+    {
+        written = PatchFile(_fileName, *m_savedFile.m_data, buffer);
+    }
+
+    // Offsets shifted or the file changed, write everything
+    if (!written && !SaveBufferToFile(_fileName, buffer.data(), buffer.size()))
+    {
+        m_savedFile = SavedFile();
+        _errorMsg = "Unable to open file!";
+        return false;
+    }
+
+    m_savedFile.m_fileName = _fileName;
+    m_savedFile.m_sfFormat = _sfFormat;
+    m_savedFile.m_data = make_shared<vector<uint8_t> const>(move(buffer));
+    m_savedFile.m_snapshot = snapshot;
+    if (!GetFileStamp(_fileName, m_savedFile.m_fileSize, m_savedFile.m_fileTime))
+    {
+        m_savedFile.m_fileSize = -1;
+    }
+    return true;
+}
+
+//-----------------------------------------------------
+// Check the file is still exactly what SaveIncremental() last wrote to it.
+// A stamp of whole seconds (FAT, older file systems) can't tell a rewrite
+// within the same second apart, so it never counts as unchanged
+//-----------------------------------------------------
+bool BNSprite::IsSavedFileUnchanged
+(
+    wstring const& _fileName,
+    bool _sfFormat
+) const
+{
+    if (!m_savedFile.m_snapshot || m_savedFile.m_fileName != _fileName || m_savedFile.m_sfFormat != _sfFormat)
+    {
+        return false;
+    }
+
+    int64_t fileSize = -1;
+    int64_t fileTime = 0;
+    return GetFileStamp(_fileName, fileSize, fileTime)
+        && fileSize == m_savedFile.m_fileSize
+        && fileTime == m_savedFile.m_fileTime
+        && fileTime % c_fileTimeTicksPerSecond != 0;
+}
+
+//-----------------------------------------------------
+// Forget all snapshot nodes, used after changes made in bulk
+//-----------------------------------------------------
+void BNSprite::DropSnapshotNodes()
+{
+    for (AnimationEntry& anim : m_animations)
+    {
+        anim.m_snapshot.reset();
+    }
+    for (FrameEntry& frame : m_store.m_frames)
+    {
+        frame.m_snapshot = FrameNode();
+    }
+}
+
+//-----------------------------------------------------
+// Create new animation
+//-----------------------------------------------------
+int BNSprite::NewAnimation
+(
+    int _copyFrom // = -1
+)
+{
+    if (_copyFrom == -1 && m_animations.size() < 256)
+    {
+        AnimationEntry anim;
+        PushFrame(anim, m_store.AppendDefault());
+        m_animations.push_back(anim);
+
+        return m_animations.size() - 1;
+    }
+    else if (_copyFrom >= 0 && _copyFrom < m_animations.size())
+    {
+        // Deep copy, ranges are never shared between entries
+        AnimationEntry anim;
+        anim.m_loop = m_animations[_copyFrom].m_loop;
+        for (uint32_t i = 0; i < m_animations[_copyFrom].m_frames.m_count; i++)
+        {
+            FrameEntry const copy = m_store.Append(m_store, GetFrameEntry(m_animations[_copyFrom], i));
+            PushFrame(anim, copy);
+        }
+        m_animations.push_back(anim);
+
+        return m_animations.size() - 1;
+    }
+
+    return -1;
+}
+
+//-----------------------------------------------------
+// Swap two animations
+//-----------------------------------------------------
+void BNSprite::SwapAnimations
+(
+    int _id1,
+    int _id2
+)
+{
+    if (_id1 < 0 || _id1 >= m_animations.size()) return;
+    if (_id2 < 0 || _id2 >= m_animations.size()) return;
+    iter_swap(m_animations.begin() + _id1, m_animations.begin() + _id2);
+}
+
+//-----------------------------------------------------
+// Delete animation
+//-----------------------------------------------------
+void BNSprite::DeleteAnimation
+(
+    int _animID
+)
+{
+    if (_animID < 0 || _animID >= m_animations.size()) return;
+
+    AnimationEntry const& anim = m_animations[_animID];
+    for (uint32_t i = 0; i < anim.m_frames.m_count; i++)
+    {
+        m_store.m_unusedCount += m_store.GetEntryCount(GetFrameEntry(anim, i));
+    }
+    m_animations.erase(m_animations.begin() + _animID);
+    CompactIfNeeded();
+}
+
+//-----------------------------------------------------
+// Set if animation loops
+//-----------------------------------------------------
+void BNSprite::SetAnimationLoop
+(
+    int _animID,
+    bool _loop
+)
+{
+    if (_animID < 0 || _animID >= m_animations.size()) return;
+    if (m_animations[_animID].m_loop == _loop) return;
+    m_animations[_animID].m_loop = _loop;
+    m_animations[_animID].m_snapshot.reset();
+}
+
+//-----------------------------------------------------
+// Create new frame
+//-----------------------------------------------------
+int BNSprite::NewFrame
+(
+    int _animID,
+    int _copyAnimID, //= -1
+    int _copyFrameID //= -1
+)
+{
+    if (_animID < 0 || _animID >= m_animations.size()) return -1;
+    AnimationEntry& anim = m_animations[_animID];
+
+    if (_copyAnimID == -1)
+    {
+        PushFrame(anim, m_store.AppendDefault());
+
+        return anim.m_frames.m_count - 1;
+    }
+    else
+    {
+        if (_copyFrameID < 0 || _copyAnimID >= m_animations.size()) return -1;
+        AnimationEntry const& copyAnim = m_animations[_copyAnimID];
+
+        if (_copyFrameID >= copyAnim.m_frames.m_count) return -1;
+
+        FrameEntry const copy = m_store.Append(m_store, GetFrameEntry(copyAnim, _copyFrameID));
+        PushFrame(anim, copy);
+
+        return anim.m_frames.m_count - 1;
+    }
+}
+
+//-----------------------------------------------------
+// Swap two frames
+//-----------------------------------------------------
+void BNSprite::SwapFrames
+(
+    int _animID,
+    int _id1,
+    int _id2
+)
+{
+    if (_animID < 0 || _animID >= m_animations.size()) return;
+    AnimationEntry& anim = m_animations[_animID];
+
+    if (_id1 < 0 || _id1 >= anim.m_frames.m_count) return;
+    if (_id2 < 0 || _id2 >= anim.m_frames.m_count) return;
+    swap(GetFrameEntry(anim, _id1), GetFrameEntry(anim, _id2));
+    anim.m_snapshot.reset();
+}
+
+//-----------------------------------------------------
+// Delete frame
+//-----------------------------------------------------
+void BNSprite::DeleteFrame
+(
+    int _animID,
+    int _frameID
+)
+{
+    if (_animID < 0 || _animID >= m_animations.size()) return;
+    AnimationEntry& anim = m_animations[_animID];
+
+    if (_frameID < 0 || _frameID >= anim.m_frames.m_count) return;
+
+    // Shift the rest of the range down, the last slot becomes unused
+    vector<FrameEntry>::iterator first = m_store.m_frames.begin() + anim.m_frames.m_start;
+    m_store.m_unusedCount += m_store.GetEntryCount(first[_frameID]);
+    rotate(first + _frameID, first + _frameID + 1, first + anim.m_frames.m_count);
+    anim.m_frames.m_count--;
+    anim.m_snapshot.reset();
+    CompactIfNeeded();
+}
+
+//-----------------------------------------------------
+// Replace frame
+//-----------------------------------------------------
+void BNSprite::ReplaceFrame
+(
+    int _animID,
+    int _frameID,
+    BNSprite::Frame const& _frame
+)
+{
+    if (_animID < 0 || _animID >= m_animations.size()) return;
+    AnimationEntry& anim = m_animations[_animID];
+
+    if (_frameID < 0 || _frameID >= anim.m_frames.m_count) return;
+
+    // Nothing to do if the content is the same, the editor saves frames on every change
+    FrameEntry& entry = GetFrameEntry(anim, _frameID);
+    if (m_store.Matches(entry, _frame)) return;
+
+    // New content is appended, the old ranges are left for compaction
+    m_store.m_unusedCount += m_store.GetEntryCount(entry) - 1;
+    entry = m_store.Append(_frame);
+    anim.m_snapshot.reset();
+    CompactIfNeeded();
+
+    std::cout << "Anim " << to_string(_animID) << " Frame " << to_string(_frameID) << " saved!" << endl;
+}
+
+//-----------------------------------------------------
+// Add a frame to the end of an animation, moving the animation's
+// frames to the end of the store if something was added after them
+//-----------------------------------------------------
+void BNSprite::PushFrame
+(
+    AnimationEntry& _anim,
+    FrameEntry const& _entry
+)
+{
+    vector<FrameEntry>& frames = m_store.m_frames;
+    if (_anim.m_frames.m_count == 0)
+    {
+        _anim.m_frames.m_start = frames.size();
+    }
+    else if (_anim.m_frames.End() != frames.size())
+    {
+        uint32_t const start = frames.size();
+        for (uint32_t i = 0; i < _anim.m_frames.m_count; i++)
+        {
+            frames.push_back(frames[_anim.m_frames.m_start + i]);
+        }
+        m_store.m_unusedCount += _anim.m_frames.m_count;
+        _anim.m_frames.m_start = start;
+    }
+
+    frames.push_back(_entry);
+    _anim.m_frames.m_count++;
+    _anim.m_snapshot.reset();
+}
+
+//-----------------------------------------------------
+// Compact the frame store once most of it is unused
+//-----------------------------------------------------
+void BNSprite::CompactIfNeeded()
+{
+    if (m_store.m_unusedCount > 0x400 && m_store.m_unusedCount * 2 > m_store.GetTotalCount())
+    {
+        Compact();
+    }
+}
+
+//-----------------------------------------------------
+// Rebuild the frame store with only the used ranges, in animation order
+//-----------------------------------------------------
+void BNSprite::Compact()
+{
+    FrameStore store;
+    for (AnimationEntry& anim : m_animations)
+    {
+        uint32_t const start = store.m_frames.size();
+        for (uint32_t i = 0; i < anim.m_frames.m_count; i++)
+        {
+            store.m_frames.push_back(store.Append(m_store, GetFrameEntry(anim, i)));
+        }
+        anim.m_frames.m_start = start;
+    }
+
+    swap(m_store, store);
+}
+
+//-----------------------------------------------------
+// Clear the frame store
+//-----------------------------------------------------
+void BNSprite::FrameStore::Clear()
+{
+    m_frames.clear();
+    m_subAnimations.clear();
+    m_subFrames.clear();
+    m_objects.clear();
+    m_subObjects.clear();
+    m_unusedCount = 0;
 }
 
 //-----------------------------------------------------
-// Create new animation
+// Add the content of a frame, the frame entry itself is returned
 //-----------------------------------------------------
-int BNSprite::NewAnimation
+BNSprite::FrameEntry BNSprite::FrameStore::Append
 (
-    int _copyFrom // = -1
+    Frame const& _frame
 )
 {
-    if (_copyFrom == -1 && m_animations.size() < 256)
+    FrameEntry entry;
+    entry.m_specialFlag0 = _frame.m_specialFlag0;
+    entry.m_specialFlag1 = _frame.m_specialFlag1;
+    entry.m_tilesetID = _frame.m_tilesetID;
+    entry.m_paletteGroupID = _frame.m_paletteGroupID;
+    entry.m_delay = _frame.m_delay;
+
+    entry.m_subAnimations.m_start = m_subAnimations.size();
+    entry.m_subAnimations.m_count = _frame.m_subAnimations.size();
+    for (SubAnimation const& subAnim : _frame.m_subAnimations)
     {
-        SubAnimation subAnim;
-        subAnim.m_subFrames.push_back(SubFrame());
-        Object object;
-        object.m_subObjects.push_back(SubObject());
-
-        Frame frame;
-        frame.m_subAnimations.push_back(subAnim);
-        frame.m_objects.push_back(object);
-
-        Animation anim;
-        anim.m_frames.push_back(frame);
-        m_animations.push_back(anim);
-
-        return m_animations.size() - 1;
+        SubAnimationEntry subAnimEntry;
+        subAnimEntry.m_loop = subAnim.m_loop;
+        subAnimEntry.m_subFrames.m_start = m_subFrames.size();
+        subAnimEntry.m_subFrames.m_count = subAnim.m_subFrames.size();
+        m_subFrames.insert(m_subFrames.end(), subAnim.m_subFrames.begin(), subAnim.m_subFrames.end());
+        m_subAnimations.push_back(subAnimEntry);
     }
-    else if (_copyFrom >= 0 && _copyFrom < m_animations.size())
-    {
-        Animation const& anim = m_animations[_copyFrom];
-        m_animations.push_back(anim);
 
-        return m_animations.size() - 1;
+    entry.m_objects.m_start = m_objects.size();
+    entry.m_objects.m_count = _frame.m_objects.size();
+    for (Object const& object : _frame.m_objects)
+    {
+        ObjectEntry objectEntry;
+        objectEntry.m_paletteIndex = object.m_paletteIndex;
+        objectEntry.m_subObjects.m_start = m_subObjects.size();
+        objectEntry.m_subObjects.m_count = object.m_subObjects.size();
+        m_subObjects.insert(m_subObjects.end(), object.m_subObjects.begin(), object.m_subObjects.end());
+        m_objects.push_back(objectEntry);
     }
 
-    return -1;
+    return entry;
 }
 
 //-----------------------------------------------------
-// Swap two animations
+// Append the frame new animations and frames start with,
+// one sub animation and one object each with a default entry
 //-----------------------------------------------------
-void BNSprite::SwapAnimations
-(
-    int _id1,
-    int _id2
-)
+BNSprite::FrameEntry BNSprite::FrameStore::AppendDefault()
 {
-    if (_id1 < 0 || _id1 >= m_animations.size()) return;
-    if (_id2 < 0 || _id2 >= m_animations.size()) return;
-    iter_swap(m_animations.begin() + _id1, m_animations.begin() + _id2);
+    Frame const frame;
+    FrameEntry entry;
+    entry.m_specialFlag0 = frame.m_specialFlag0;
+    entry.m_specialFlag1 = frame.m_specialFlag1;
+    entry.m_tilesetID = frame.m_tilesetID;
+    entry.m_paletteGroupID = frame.m_paletteGroupID;
+    entry.m_delay = frame.m_delay;
+
+    SubAnimationEntry subAnimEntry;
+    subAnimEntry.m_loop = SubAnimation().m_loop;
+    subAnimEntry.m_subFrames.m_start = m_subFrames.size();
+    subAnimEntry.m_subFrames.m_count = 1;
+    m_subFrames.push_back(SubFrame());
+
+    entry.m_subAnimations.m_start = m_subAnimations.size();
+    entry.m_subAnimations.m_count = 1;
+    m_subAnimations.push_back(subAnimEntry);
+
+    ObjectEntry objectEntry;
+    objectEntry.m_paletteIndex = Object().m_paletteIndex;
+    objectEntry.m_subObjects.m_start = m_subObjects.size();
+    objectEntry.m_subObjects.m_count = 1;
+    m_subObjects.push_back(SubObject());
+
+    entry.m_objects.m_start = m_objects.size();
+    entry.m_objects.m_count = 1;
+    m_objects.push_back(objectEntry);
+
+    return entry;
 }
 
 //-----------------------------------------------------
-// Delete animation
+// Copy the content of a frame from a store, which can be this one
 //-----------------------------------------------------
-void BNSprite::DeleteAnimation
+BNSprite::FrameEntry BNSprite::FrameStore::Append
 (
-    int _animID
+    FrameStore const& _source,
+    FrameEntry const& _entry
 )
 {
-    if (_animID < 0 || _animID >= m_animations.size()) return;
-    m_animations.erase(m_animations.begin() + _animID);
+    FrameEntry entry = _entry;
+
+    entry.m_subAnimations.m_start = m_subAnimations.size();
+    for (uint32_t i = _entry.m_subAnimations.m_start; i < _entry.m_subAnimations.End(); i++)
+    {
+        SubAnimationEntry subAnim = _source.m_subAnimations[i];
+        uint32_t const subFrameStart = m_subFrames.size();
+        for (uint32_t j = subAnim.m_subFrames.m_start; j < subAnim.m_subFrames.End(); j++)
+        {
+            m_subFrames.push_back(_source.m_subFrames[j]);
+        }
+        subAnim.m_subFrames.m_start = subFrameStart;
+        m_subAnimations.push_back(subAnim);
+    }
+
+    entry.m_objects.m_start = m_objects.size();
+    for (uint32_t i = _entry.m_objects.m_start; i < _entry.m_objects.End(); i++)
+    {
+        ObjectEntry object = _source.m_objects[i];
+        uint32_t const subObjectStart = m_subObjects.size();
+        for (uint32_t j = object.m_subObjects.m_start; j < object.m_subObjects.End(); j++)
+        {
+            m_subObjects.push_back(_source.m_subObjects[j]);
+        }
+        object.m_subObjects.m_start = subObjectStart;
+        m_objects.push_back(object);
+    }
+
+    return entry;
 }
 
 //-----------------------------------------------------
-// Set if animation loops
+// Build a standalone frame from an entry
 //-----------------------------------------------------
-void BNSprite::SetAnimationLoop
+BNSprite::Frame BNSprite::FrameStore::Extract
 (
-    int _animID,
-    bool _loop
-)
+    FrameEntry const& _entry
+) const
 {
-    if (_animID < 0 || _animID >= m_animations.size()) return;
-    m_animations[_animID].m_loop = _loop;
+    Frame frame;
+    frame.m_specialFlag0 = _entry.m_specialFlag0;
+    frame.m_specialFlag1 = _entry.m_specialFlag1;
+    frame.m_tilesetID = _entry.m_tilesetID;
+    frame.m_paletteGroupID = _entry.m_paletteGroupID;
+    frame.m_delay = _entry.m_delay;
+
+    frame.m_subAnimations.resize(_entry.m_subAnimations.m_count);
+    for (uint32_t i = 0; i < _entry.m_subAnimations.m_count; i++)
+    {
+        SubAnimationEntry const& subAnimEntry = m_subAnimations[_entry.m_subAnimations.m_start + i];
+        SubAnimation& subAnim = frame.m_subAnimations[i];
+        subAnim.m_loop = subAnimEntry.m_loop;
+        subAnim.m_subFrames.assign(m_subFrames.begin() + subAnimEntry.m_subFrames.m_start,
+                                   m_subFrames.begin() + subAnimEntry.m_subFrames.End());
+    }
+
+    frame.m_objects.resize(_entry.m_objects.m_count);
+    for (uint32_t i = 0; i < _entry.m_objects.m_count; i++)
+    {
+        ObjectEntry const& objectEntry = m_objects[_entry.m_objects.m_start + i];
+        Object& object = frame.m_objects[i];
+        object.m_paletteIndex = objectEntry.m_paletteIndex;
+        object.m_subObjects.assign(m_subObjects.begin() + objectEntry.m_subObjects.m_start,
+                                   m_subObjects.begin() + objectEntry.m_subObjects.End());
+    }
+
+    return frame;
 }
 
 //-----------------------------------------------------
-// Create new frame
+// Check if an entry holds the same content as a frame
 //-----------------------------------------------------
-int BNSprite::NewFrame
+bool BNSprite::FrameStore::Matches
 (
-    int _animID,
-    int _copyAnimID, //= -1
-    int _copyFrameID //= -1
-)
+    FrameEntry const& _entry,
+    Frame const& _frame
+) const
 {
-    if (_animID < 0 || _animID >= m_animations.size()) return -1;
-    Animation& anim = m_animations[_animID];
+    if (_entry.m_specialFlag0 != _frame.m_specialFlag0 || _entry.m_specialFlag1 != _frame.m_specialFlag1) return false;
+    if (_entry.m_tilesetID != _frame.m_tilesetID || _entry.m_paletteGroupID != _frame.m_paletteGroupID) return false;
+    if (_entry.m_delay != _frame.m_delay) return false;
+    if (_entry.m_subAnimations.m_count != _frame.m_subAnimations.size()) return false;
+    if (_entry.m_objects.m_count != _frame.m_objects.size()) return false;
 
-    if (_copyAnimID == -1)
+    for (uint32_t i = 0; i < _entry.m_subAnimations.m_count; i++)
     {
-        SubAnimation subAnim;
-        subAnim.m_subFrames.push_back(SubFrame());
-        Object object;
-        object.m_subObjects.push_back(SubObject());
+        SubAnimationEntry const& subAnimEntry = m_subAnimations[_entry.m_subAnimations.m_start + i];
+        SubAnimation const& subAnim = _frame.m_subAnimations[i];
+        if (subAnimEntry.m_loop != subAnim.m_loop || subAnimEntry.m_subFrames.m_count != subAnim.m_subFrames.size()) return false;
 
-        Frame frame;
-        frame.m_subAnimations.push_back(subAnim);
-        frame.m_objects.push_back(object);
-        anim.m_frames.push_back(frame);
-
-        return anim.m_frames.size() - 1;
+        for (uint32_t j = 0; j < subAnimEntry.m_subFrames.m_count; j++)
+        {
+            SubFrame const& a = m_subFrames[subAnimEntry.m_subFrames.m_start + j];
+            SubFrame const& b = subAnim.m_subFrames[j];
+            if (a.m_objectIndex != b.m_objectIndex || a.m_delay != b.m_delay) return false;
+        }
     }
-    else
-    {
-        if (_copyFrameID < 0 || _copyAnimID >= m_animations.size()) return -1;
-        Animation const& copyAnim = m_animations[_copyAnimID];
 
-        if (_copyFrameID >= copyAnim.m_frames.size()) return -1;
-
-        Frame const& frame = copyAnim.m_frames[_copyFrameID];
-        anim.m_frames.push_back(frame);
+    for (uint32_t i = 0; i < _entry.m_objects.m_count; i++)
+    {
+        ObjectEntry const& objectEntry = m_objects[_entry.m_objects.m_start + i];
+        Object const& object = _frame.m_objects[i];
+        if (objectEntry.m_paletteIndex != object.m_paletteIndex || objectEntry.m_subObjects.m_count != object.m_subObjects.size()) return false;
 
-        return anim.m_frames.size() - 1;
+        for (uint32_t j = 0; j < objectEntry.m_subObjects.m_count; j++)
+        {
+            SubObject const& a = m_subObjects[objectEntry.m_subObjects.m_start + j];
+            SubObject const& b = object.m_subObjects[j];
+            if (a != b) return false;
+        }
     }
+
+    return true;
 }
 
 //-----------------------------------------------------
-// Swap two frames
+// Number of entries used by a frame across all levels
 //-----------------------------------------------------
-void BNSprite::SwapFrames
+uint32_t BNSprite::FrameStore::GetEntryCount
 (
-    int _animID,
-    int _id1,
-    int _id2
-)
+    FrameEntry const& _entry
+) const
 {
-    if (_animID < 0 || _animID >= m_animations.size()) return;
-    Animation& anim = m_animations[_animID];
-
-    if (_id1 < 0 || _id1 >= anim.m_frames.size()) return;
-    if (_id2 < 0 || _id2 >= anim.m_frames.size()) return;
-    iter_swap(anim.m_frames.begin() + _id1, anim.m_frames.begin() + _id2);
+    uint32_t count = 1 + _entry.m_subAnimations.m_count + _entry.m_objects.m_count;
+    for (uint32_t i = _entry.m_subAnimations.m_start; i < _entry.m_subAnimations.End(); i++)
+    {
+        count += m_subAnimations[i].m_subFrames.m_count;
+    }
+    for (uint32_t i = _entry.m_objects.m_start; i < _entry.m_objects.End(); i++)
+    {
+        count += m_objects[i].m_subObjects.m_count;
+    }
+    return count;
 }
 
 //-----------------------------------------------------
-// Delete frame
+// Number of entries in the store, used or not
 //-----------------------------------------------------
-void BNSprite::DeleteFrame
-(
-    int _animID,
-    int _frameID
-)
+uint32_t BNSprite::FrameStore::GetTotalCount() const
 {
-    if (_animID < 0 || _animID >= m_animations.size()) return;
-    Animation& anim = m_animations[_animID];
-
-    if (_frameID < 0 || _frameID >= anim.m_frames.size()) return;
-    anim.m_frames.erase(anim.m_frames.begin() + _frameID);
+    return m_frames.size() + m_subAnimations.size() + m_subFrames.size() + m_objects.size() + m_subObjects.size();
 }
 
 //-----------------------------------------------------
-// Replace frame
+// Bytes used by the entries of the store
 //-----------------------------------------------------
-void BNSprite::ReplaceFrame
-(
-    int _animID,
-    int _frameID,
-    BNSprite::Frame const& _frame
-)
+size_t BNSprite::FrameStore::GetMemorySize() const
 {
-    if (_animID < 0 || _animID >= m_animations.size()) return;
-    Animation& anim = m_animations[_animID];
-
-    if (_frameID < 0 || _frameID >= anim.m_frames.size()) return;
-
-    anim.m_frames.push_back(_frame);
-    iter_swap(anim.m_frames.begin() + _frameID, anim.m_frames.end() - 1);
-    anim.m_frames.pop_back();
-
-    std::cout << "Anim " << to_string(_animID) << " Frame " << to_string(_frameID) << " saved!" << endl;
+    return m_frames.size() * sizeof(FrameEntry)
+         + m_subAnimations.size() * sizeof(SubAnimationEntry)
+         + m_subFrames.size() * sizeof(SubFrame)
+         + m_objects.size() * sizeof(ObjectEntry)
+         + m_subObjects.size() * sizeof(SubObject);
 }
 
 //-----------------------------------------------------
@@ -2286,23 +4234,19 @@ bool BNSprite::ImportTileset
         return false;
     }
 
-    FILE* f;
-    _wfopen_s(&f, _fileName.c_str(), L"rb");
-    if (!f)
+    vector<uint8_t> buffer;
+    if (!LoadFileToBuffer(_fileName, buffer))
     {
         _errorMsg = "Unable to open file!";
-        fclose(f);
         return false;
     }
 
     // File size
-    fseek(f, 0, SEEK_END);
-    uint32_t fileSize = ftell(f);
+    uint32_t fileSize = buffer.size();
 
     if (fileSize == 0)
     {
         _errorMsg = "File is empty!";
-        fclose(f);
         return false;
     }
 
@@ -2311,20 +4255,15 @@ bool BNSprite::ImportTileset
         _errorMsg = "Invalid tileset file, size must be multiple of ";
         _errorMsg += m_256ColorMode ? "0x40" : "0x20";
         _errorMsg += " bytes!";
-        fclose(f);
         return false;
     }
 
-    // Overwrite tileset
+    // Overwrite tileset, it no longer references the sprite file
     Tileset& tileset = m_tilesets[_tilesetID];
-    tileset.m_data.clear();
-    fseek(f, 0, SEEK_SET);
-    for (uint32_t i = 0; i < fileSize; i++)
-    {
-        tileset.m_data.push_back(ReadByte(f));
-    }
+    tileset.m_source.reset();
+    tileset.m_pixels.reset();
+    tileset.m_data.swap(buffer);
 
-    fclose(f);
     return true;
 }
 
@@ -2344,21 +4283,13 @@ bool BNSprite::ExportTileset
         return false;
     }
 
-    FILE* f;
-    _wfopen_s(&f, _fileName.c_str(), L"wb");
-    if (!f)
+    Tileset const& tileset = m_tilesets[_tilesetID];
+    if (!SaveBufferToFile(_fileName, tileset.GetData(), tileset.GetSize()))
     {
         _errorMsg = "Unable to open file!";
-        fclose(f);
         return false;
     }
 
-    for (uint8_t const& byte : m_tilesets[_tilesetID].m_data)
-    {
-        WriteByte(f, byte);
-    }
-
-    fclose(f);
     return true;
 }
 
@@ -2371,10 +4302,16 @@ void BNSprite::ImportCustomTileset(const vector<uint8_t> &_data)
     m_tilesets.push_back(Tileset());
 
     Tileset& tileset = m_tilesets[m_tilesets.size() - 1];
-    tileset.m_data.reserve(_data.size());
     tileset.m_data.assign(_data.begin(), _data.end());
 }
 
+void BNSprite::ImportCustomTileset(vector<uint8_t>&& _data)
+{
+    m_loaded = true;
+    m_tilesets.push_back(Tileset());
+    m_tilesets.back().m_data = move(_data);
+}
+
 //-----------------------------------------------------
 // Convert GBA color to RGB
 //-----------------------------------------------------
@@ -2429,12 +4366,17 @@ uint32_t BNSprite::ClampRGB(uint32_t _color)
 //-----------------------------------------------------
 uint8_t BNSprite::ReadByte
 (
-    FILE* _file
+    ByteStream& _stream
 )
 {
-    uint8_t byte;
-    fread(&byte, 1, 1, _file);
-    return byte;
+    if (_stream.Remaining() < 1)
+    {
+        // Out of bounds, behave like reading past end of file
+        _stream.Seek(_stream.m_size);
+        return 0;
+    }
+
+    return _stream.m_data[_stream.m_pos++];
 }
 
 //-----------------------------------------------------
@@ -2442,12 +4384,12 @@ uint8_t BNSprite::ReadByte
 //-----------------------------------------------------
 uint16_t BNSprite::ReadShort
 (
-    FILE* _file
+    ByteStream& _stream
 )
 {
-    // Read short, require flipping bytes
-    uint16_t value;
-    fread(&value, 2, 1, _file);
+    // Little endian regardless of host
+    uint16_t value = ReadByte(_stream);
+    value |= static_cast<uint16_t>(ReadByte(_stream)) << 8;
     return value;
 }
 
@@ -2456,25 +4398,126 @@ uint16_t BNSprite::ReadShort
 //-----------------------------------------------------
 uint32_t BNSprite::ReadInt
 (
-    FILE* _file
+    ByteStream& _stream
 )
 {
-    // Read int, require flipping bytes
-    uint32_t value;
-    fread(&value, 4, 1, _file);
+    // Little endian regardless of host
+    uint32_t value = ReadShort(_stream);
+    value |= static_cast<uint32_t>(ReadShort(_stream)) << 16;
     return value;
 }
 
+//-----------------------------------------------------
+// Open a file for binary read or write, nullptr if fail
+//-----------------------------------------------------
+FILE* BNSprite::OpenFile
+(
+    wstring const& _fileName,
+    FileMode _mode
+)
+{
+    FILE* f = nullptr;
+#ifdef _WIN32
+    wchar_t const* modes[] = { L"rb", L"wb", L"r+b" };
+    _wfopen_s(&f, _fileName.c_str(), modes[_mode]);
+#else
+    // Other platforms take UTF-8 paths
+    string fileName;
+    fileName.reserve(_fileName.size());
+    for (wchar_t const& c : _fileName)
+    {
+        uint32_t const code = static_cast<uint32_t>(c);
+        if (code < 0x80)
+        {
+            fileName.push_back(static_cast<char>(code));
+        }
+        else if (code < 0x800)
+        {
+            fileName.push_back(static_cast<char>(0xC0 | (code >> 6)));
+            fileName.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+        }
+        else if (code < 0x10000)
+        {
+            fileName.push_back(static_cast<char>(0xE0 | (code >> 12)));
+            fileName.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+            fileName.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+        }
+        else
+        {
+            fileName.push_back(static_cast<char>(0xF0 | (code >> 18)));
+            fileName.push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3F)));
+            fileName.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+            fileName.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+        }
+    }
+    char const* modes[] = { "rb", "wb", "r+b" };
+    f = fopen(fileName.c_str(), modes[_mode]);
+#endif
+    return f;
+}
+
+//-----------------------------------------------------
+// Read the entire file into a buffer, return false if fail
+//-----------------------------------------------------
+bool BNSprite::LoadFileToBuffer
+(
+    wstring const& _fileName,
+    vector<uint8_t>& _data
+)
+{
+    _data.clear();
+
+    FILE* f = OpenFile(_fileName, FM_Read);
+    if (!f)
+    {
+        return false;
+    }
+
+    // File size
+    fseek(f, 0, SEEK_END);
+    long fileSize = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (fileSize < 0)
+    {
+        fclose(f);
+        return false;
+    }
+
+    // One read for the whole file
+    _data.resize(fileSize);
+    if (fileSize > 0 && fread(_data.data(), 1, fileSize, f) != (size_t)fileSize)
+    {
+        _data.clear();
+        fclose(f);
+        return false;
+    }
+
+    fclose(f);
+    return true;
+}
+
 //-----------------------------------------------------
 // Write a byte
 //-----------------------------------------------------
 void BNSprite::WriteByte
 (
-    FILE* _file,
+    ByteBuffer& _buffer,
     uint8_t _writeByte
 )
 {
-    fwrite(&_writeByte, 1, 1, _file);
+    vector<uint8_t>& data = _buffer.m_data;
+    if (_buffer.m_pos < data.size())
+    {
+        // Patching previously written data
+        data[_buffer.m_pos] = _writeByte;
+    }
+    else
+    {
+        // Skipped regions are zero filled
+        data.resize(_buffer.m_pos);
+        data.push_back(_writeByte);
+    }
+    _buffer.m_pos++;
 }
 
 //-----------------------------------------------------
@@ -2482,11 +4525,13 @@ void BNSprite::WriteByte
 //-----------------------------------------------------
 void BNSprite::WriteShort
 (
-    FILE* _file,
+    ByteBuffer& _buffer,
     uint16_t _writeShort
 )
 {
-    fwrite(&_writeShort, 2, 1, _file);
+    // Little endian regardless of host
+    WriteByte(_buffer, _writeShort & 0xFF);
+    WriteByte(_buffer, _writeShort >> 8);
 }
 
 //-----------------------------------------------------
@@ -2494,11 +4539,36 @@ void BNSprite::WriteShort
 //-----------------------------------------------------
 void BNSprite::WriteInt
 (
-    FILE* _file,
+    ByteBuffer& _buffer,
     uint32_t _writeInt
 )
 {
-    fwrite(&_writeInt, 4, 1, _file);
+    // Little endian regardless of host
+    WriteShort(_buffer, _writeInt & 0xFFFF);
+    WriteShort(_buffer, _writeInt >> 16);
+}
+
+//-----------------------------------------------------
+// Write a block of bytes
+//-----------------------------------------------------
+void BNSprite::WriteBytes
+(
+    ByteBuffer& _buffer,
+    uint8_t const* _bytes,
+    uint32_t _count
+)
+{
+    vector<uint8_t>& data = _buffer.m_data;
+    uint32_t const end = _buffer.m_pos + _count;
+    if (data.size() < end)
+    {
+        data.resize(end);
+    }
+    if (_count > 0)
+    {
+        memcpy(data.data() + _buffer.m_pos, _bytes, _count);
+    }
+    _buffer.m_pos = end;
 }
 
 //-----------------------------------------------------
@@ -2506,20 +4576,134 @@ void BNSprite::WriteInt
 //-----------------------------------------------------
 void BNSprite::AlignFourBytes
 (
-    FILE* _file,
+    ByteBuffer& _buffer,
     bool _padExtra
 )
 {
     // At least pad one byte, why
     if (_padExtra)
     {
-        WriteByte(_file, 0x00);
+        WriteByte(_buffer, 0x00);
+    }
+
+    while (_buffer.Tell() % 0x04)
+    {
+        WriteByte(_buffer, 0x00);
+    }
+}
+
+//-----------------------------------------------------
+// Write a buffer to file in one go, return false if fail
+//-----------------------------------------------------
+bool BNSprite::SaveBufferToFile
+(
+    wstring const& _fileName,
+    uint8_t const* _data,
+    uint32_t _size
+)
+{
+    FILE* f = OpenFile(_fileName, FM_Write);
+    if (!f)
+    {
+        return false;
+    }
+
+    bool success = _size == 0 || fwrite(_data, 1, _size, f) == _size;
+    fclose(f);
+    return success;
+}
+
+//-----------------------------------------------------
+// Overwrite the blocks that differ in a file of the same size
+//-----------------------------------------------------
+bool BNSprite::PatchFile
+(
+    wstring const& _fileName,
+    vector<uint8_t> const& _oldData,
+    vector<uint8_t> const& _newData
+)
+{
+    assert(_oldData.size() == _newData.size());
+
+    FILE* f = OpenFile(_fileName, FM_Update);
+    if (!f)
+    {
+        return false;
+    }
+
+    // Neighbouring dirty blocks are written together
+    uint32_t const blockSize = 0x1000;
+    uint32_t const size = _newData.size();
+    bool success = true;
+    uint32_t offset = 0;
+    while (success && offset < size)
+    {
+        uint32_t length = min(blockSize, size - offset);
+        if (memcmp(_oldData.data() + offset, _newData.data() + offset, length) == 0)
+        {
+            offset += length;
+            continue;
+        }
+
+        uint32_t end = offset + length;
+        while (end < size)
+        {
+            uint32_t const next = min(blockSize, size - end);
+            if (memcmp(_oldData.data() + end, _newData.data() + end, next) == 0) break;
+            end += next;
+        }
+
+        success = fseek(f, offset, SEEK_SET) == 0 && fwrite(_newData.data() + offset, 1, end - offset, f) == end - offset;
+        offset = end;
+    }
+
+    success = fclose(f) == 0 && success;
+    return success;
+}
+
+//-----------------------------------------------------
+// Size and last modified time in c_fileTimeTicksPerSecond units, used to tell if a file changed
+//-----------------------------------------------------
+bool BNSprite::GetFileStamp
+(
+    wstring const& _fileName,
+    int64_t& _size,
+    int64_t& _time
+)
+{
+#ifdef _WIN32
+    // st_mtime only has whole seconds, the file time has 100ns ticks and fits in 63 bits as is
+    WIN32_FILE_ATTRIBUTE_DATA info;
+    if (!GetFileAttributesExW(_fileName.c_str(), GetFileExInfoStandard, &info))
+    {
+        return false;
+    }
+
+    _size = (static_cast<int64_t>(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+    _time = (static_cast<int64_t>(info.ftLastWriteTime.dwHighDateTime) << 32) | info.ftLastWriteTime.dwLowDateTime;
+    return true;
+#else
+    FILE* f = OpenFile(_fileName, FM_Read);
+    if (!f)
+    {
+        return false;
     }
 
-    while (ftell(_file) % 0x04)
+    struct stat info;
+    bool const success = fstat(fileno(f), &info) == 0;
+    fclose(f);
+
+    if (success)
     {
-        WriteByte(_file, 0x00);
+        _size = info.st_size;
+#ifdef __APPLE__
+        _time = static_cast<int64_t>(info.st_mtimespec.tv_sec) * 1000000000 + info.st_mtimespec.tv_nsec;
+#else
+        _time = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+#endif
     }
+    return success;
+#endif
 }
 
 //-----------------------------------------------------
@@ -1,10 +1,15 @@
 #ifndef BNSPRITE_H
 #define BNSPRITE_H
 
+#include <cstdint>
+#include <cstdio>
+#include <functional>
 #include <string>
 #include <vector>
 #include <set>
 #include <map>
+#include <memory>
+#include <unordered_map>
 
 using namespace std;
 
@@ -16,20 +21,52 @@ public:
         uint16_t m_startTile;
         int8_t m_posX;
         int8_t m_posY;
-        bool m_hFlip;
-        bool m_vFlip;
-        int32_t m_sizeX;
-        int32_t m_sizeY;
+        uint8_t m_attributes; // GBA OAM shape (bit 0-1), size (bit 2-3), h-flip (bit 4), v-flip (bit 5)
 
         SubObject()
             : m_startTile(0)
             , m_posX(-4)
             , m_posY(-4)
-            , m_hFlip(false)
-            , m_vFlip(false)
-            , m_sizeX(8)
-            , m_sizeY(8)
+            , m_attributes(0)
         {}
+
+        bool operator==(SubObject const& _other) const
+        {
+            return m_startTile == _other.m_startTile && m_posX == _other.m_posX && m_posY == _other.m_posY && m_attributes == _other.m_attributes;
+        }
+        bool operator!=(SubObject const& _other) const { return !(*this == _other); }
+
+        // Dimension in pixels
+        int32_t GetSizeX() const { return c_sizeX[m_attributes & 0x0F]; }
+        int32_t GetSizeY() const { return c_sizeY[m_attributes & 0x0F]; }
+        bool SetSize(int32_t _sizeX, int32_t _sizeY);
+
+        // Encoding used by OAM, shape 3 is not valid
+        uint8_t GetOAMShape() const { return m_attributes & 0x03; }
+        uint8_t GetOAMSize() const { return (m_attributes >> 2) & 0x03; }
+        bool SetOAMShapeSize(uint8_t _shape, uint8_t _size);
+
+        bool GetHFlip() const { return m_attributes & 0x10; }
+        bool GetVFlip() const { return m_attributes & 0x20; }
+        void SetHFlip(bool _flip) { m_attributes = _flip ? (m_attributes | 0x10) : (m_attributes & ~0x10); }
+        void SetVFlip(bool _flip) { m_attributes = _flip ? (m_attributes | 0x20) : (m_attributes & ~0x20); }
+
+        // Dimension from (size << 2 | shape)
+        static constexpr int32_t c_sizeX[16] = { 8, 16,  8, 0, 16, 32,  8, 0, 32, 32, 16, 0, 64, 64, 32, 0 };
+        static constexpr int32_t c_sizeY[16] = { 8,  8, 16, 0, 16,  8, 32, 0, 32, 16, 32, 0, 64, 32, 64, 0 };
+
+        // (size << 2 | shape) from dimension index 8/16/32/64 -> 0-3, 0xFF if not valid
+        static constexpr uint8_t c_shapeSize[4][4] =
+        {
+            { 0x00, 0x02, 0x06, 0xFF },
+            { 0x01, 0x04, 0x0A, 0xFF },
+            { 0x05, 0x09, 0x08, 0x0E },
+            { 0xFF, 0xFF, 0x0D, 0x0C },
+        };
+        static constexpr int GetDimensionIndex(int32_t _size)
+        {
+            return _size == 8 ? 0 : _size == 16 ? 1 : _size == 32 ? 2 : _size == 64 ? 3 : -1;
+        }
     };
 
     struct Object
@@ -66,16 +103,72 @@ public:
     struct Palette
     {
         vector<uint16_t> m_colors;
+
+        bool operator==(Palette const& _other) const { return m_colors == _other.m_colors; }
     };
 
     struct PaletteGroup
     {
         vector<Palette> m_palettes;
+
+        bool operator==(PaletteGroup const& _other) const { return m_palettes == _other.m_palettes; }
     };
 
     struct Tileset
     {
         vector<uint8_t> m_data;
+
+        // Loaded tilesets can reference the file buffer instead of owning a copy,
+        // m_data is only filled in when the tileset needs to be modified
+        shared_ptr<uint8_t const> m_source;
+        uint32_t m_sourceOffset;
+        uint32_t m_sourceSize;
+
+        // One byte per pixel, built on first use by GetTilesetPixels() and
+        // dropped whenever the data is modified
+        mutable shared_ptr<vector<uint8_t> const> m_pixels;
+        mutable bool m_pixels256Color;
+
+        Tileset()
+            : m_sourceOffset(0)
+            , m_sourceSize(0)
+            , m_pixels256Color(false)
+        {}
+
+        uint8_t const* GetData() const { return m_source ? m_source.get() + m_sourceOffset : m_data.data(); }
+        uint32_t GetSize() const { return m_source ? m_sourceSize : m_data.size(); }
+        vector<uint8_t>& GetMutableData()
+        {
+            m_pixels.reset();
+            if (m_source)
+            {
+                m_data.assign(GetData(), GetData() + m_sourceSize);
+                m_source.reset();
+            }
+            return m_data;
+        }
+    };
+
+    // Summary of a sprite file from ScanBN/ScanSF
+    struct ScanInfo
+    {
+        bool m_256ColorMode;
+        uint32_t m_animationCount;
+        uint32_t m_frameCount;
+        uint32_t m_tilesetCount;
+        uint32_t m_paletteGroupCount;
+        uint32_t m_paletteCount;
+        uint32_t m_oamCount;
+
+        ScanInfo()
+            : m_256ColorMode(false)
+            , m_animationCount(0)
+            , m_frameCount(0)
+            , m_tilesetCount(0)
+            , m_paletteGroupCount(0)
+            , m_paletteCount(0)
+            , m_oamCount(0)
+        {}
     };
 
     struct Frame
@@ -111,35 +204,87 @@ public:
 
 public:
     BNSprite();
+    BNSprite(BNSprite const& _other) = default;
+    BNSprite(BNSprite&& _other) = default;
     ~BNSprite();
 
+    BNSprite& operator=(BNSprite const& _other) = default;
+    BNSprite& operator=(BNSprite&& _other) = default;
+
     bool IsLoaded() { return m_loaded; }
     bool Is256Color() { return m_256ColorMode; }
     void Clear();
 
     // Load & Save
     bool LoadBN(wstring const& _fileName, string& _errorMsg);
+    bool LoadBN(uint8_t const* _data, uint32_t _size, string& _errorMsg);
     bool LoadSF(wstring const& _fileName, string& _errorMsg);
+    bool LoadSF(uint8_t const* _data, uint32_t _size, string& _errorMsg);
     bool SaveBN(wstring const& _fileName, string& _errorMsg);
+    bool SaveBN(vector<uint8_t>& _data, string& _errorMsg);
     bool SaveSF(wstring const& _fileName, string& _errorMsg);
+    bool SaveSF(vector<uint8_t>& _data, string& _errorMsg);
+    bool SaveIncremental(wstring const& _fileName, bool _sfFormat, string& _errorMsg);
+
+    // Validate a file with the same checks as loading, without building the sprite
+    static bool ScanBN(wstring const& _fileName, ScanInfo& _info, string& _errorMsg);
+    static bool ScanBN(uint8_t const* _data, uint32_t _size, ScanInfo& _info, string& _errorMsg);
+    static bool ScanSF(wstring const& _fileName, ScanInfo& _info, string& _errorMsg);
+    static bool ScanSF(uint8_t const* _data, uint32_t _size, ScanInfo& _info, string& _errorMsg);
+
+    // Batch loading, every file is loaded into its own sprite
+    struct LoadRequest
+    {
+        wstring m_fileName;
+        bool m_sfFormat;
+
+        LoadRequest()
+            : m_sfFormat(false)
+        {}
+    };
+
+    struct LoadResult
+    {
+        bool m_success;
+        string m_errorMsg;
+
+        LoadResult()
+            : m_success(false)
+        {}
+    };
 
-    // Merge with another sprite
+    // Load files concurrently, _sprites and _results are indexed like _requests
+    static void LoadMultiple(vector<LoadRequest> const& _requests, vector<BNSprite>& _sprites, vector<LoadResult>& _results, unsigned _threadCount = 0);
+
+    // Run _task for every index below _count on a pool of worker threads, 0 threads uses all cores
+    static void RunParallel(size_t _count, unsigned _threadCount, function<void(size_t)> const& _task);
+
+    // Merge with other sprites, identical tilesets and palettes are shared instead of appended.
+    // Multiple sprites are merged in order and stop at the first failure, _mergedCount is how many succeeded
     bool Merge(BNSprite const& _other, string& _errorMsg);
+    bool Merge(vector<BNSprite const*> const& _others, uint32_t& _mergedCount, string& _errorMsg);
 
-    // Fix BN sprite to SF
+    // Fix BN sprite to SF, the sprite is left as it was if it can't be converted
     bool ConvertBNtoSF(bool& _modified, string& _errorMsg);
+    bool CanConvertBNtoSF(string& _errorMsg) const;
+
+    // Share identical (or flipped) OAM blocks and drop the tiles they no longer use, returns bytes saved
+    uint32_t RemoveDuplicateTiles();
 
     // Helper
     int GetAnimationCount() { return m_animations.size(); }
-    int GetAnimationFrameCount(int _animID) { return m_animations[_animID].m_frames.size(); }
+    int GetAnimationFrameCount(int _animID) { return m_animations[_animID].m_frames.m_count; }
     bool GetAnimationLoop(int _animID) { return m_animations[_animID].m_loop; }
     Frame GetAnimationFrame(int _animID, int _frameID);
     void GetAnimationFrames(int _animID, vector<Frame>& _frames);
     int GetTilesetCount() { return m_tilesets.size(); }
-    int GetTilesetPixelCount(int _tilesetID) { return m_tilesets[_tilesetID].m_data.size() * (m_256ColorMode ? 1 : 2); }
+    int GetTilesetPixelCount(int _tilesetID) { return m_tilesets[_tilesetID].GetSize() * (m_256ColorMode ? 1 : 2); }
     void GetTilesetPixels(int _tilesetID, vector<uint8_t>& _data);
-    void GetAllPaletteGroups(vector<PaletteGroup>& _paletteGroups);
+    vector<uint8_t> const& GetTilesetPixels(int _tilesetID) const;
+    shared_ptr<vector<uint8_t> const> GetSharedTilesetPixels(int _tilesetID) const;
+    void GetAllPaletteGroups(vector<PaletteGroup>& _paletteGroups) const;
     void ReplaceAllPaletteGroups(vector<PaletteGroup> const& _paletteGroups);
+    void ReplaceAllPaletteGroups(vector<PaletteGroup>&& _paletteGroups);
 
     // Animation functions
     int NewAnimation(int _copyFrom = -1);
@@ -165,29 +310,516 @@ public:
     // Custom Sprite functions
     void Set256Color(bool _256Color) { m_256ColorMode = _256Color; }
     void ImportCustomTileset(vector<uint8_t> const& _data);
+    void ImportCustomTileset(vector<uint8_t>&& _data);
     void ImportCustomFrame();
 
 private:
+    // Bounds-checked view of a file loaded into memory
+    struct ByteStream
+    {
+        uint8_t const* m_data;
+        uint32_t m_size;
+        uint32_t m_pos;
+
+        ByteStream(uint8_t const* _data, uint32_t _size)
+            : m_data(_data)
+            , m_size(_size)
+            , m_pos(0)
+        {}
+
+        uint32_t Tell() const { return m_pos; }
+        uint32_t Remaining() const { return m_pos < m_size ? m_size - m_pos : 0; }
+        uint8_t const* Current() const { return m_data + m_pos; }
+        void Seek(uint32_t _pos) { m_pos = _pos; }
+        void Skip(uint32_t _count) { m_pos += _count; }
+    };
+
     // Reading from bytes
-    uint8_t ReadByte(FILE* _file);
-    uint16_t ReadShort(FILE* _file);
-    uint32_t ReadInt(FILE* _file);
+    uint8_t ReadByte(ByteStream& _stream);
+    uint16_t ReadShort(ByteStream& _stream);
+    uint32_t ReadInt(ByteStream& _stream);
+    enum FileMode
+    {
+        FM_Read,
+        FM_Write,
+        FM_Update, // read and write an existing file without truncating it
+    };
+    static FILE* OpenFile(wstring const& _fileName, FileMode _mode);
+    static bool LoadFileToBuffer(wstring const& _fileName, vector<uint8_t>& _data);
+
+    // Growable output that can seek back to patch pointers
+    struct ByteBuffer
+    {
+        vector<uint8_t>& m_data;
+        uint32_t m_pos;
+
+        ByteBuffer(vector<uint8_t>& _data)
+            : m_data(_data)
+            , m_pos(0)
+        {}
+
+        uint32_t Tell() const { return m_pos; }
+        void Seek(uint32_t _pos) { m_pos = _pos; }
+        void Skip(uint32_t _count) { m_pos += _count; }
+    };
 
     // Writing bytes
-    void WriteByte(FILE* _file, uint8_t _writeByte);
-    void WriteShort(FILE* _file, uint16_t _writeShort);
-    void WriteInt(FILE* _file, uint32_t _writeInt);
-    void AlignFourBytes(FILE* _file, bool _padExtra = false);
+    void WriteByte(ByteBuffer& _buffer, uint8_t _writeByte);
+    void WriteShort(ByteBuffer& _buffer, uint16_t _writeShort);
+    void WriteInt(ByteBuffer& _buffer, uint32_t _writeInt);
+    void WriteBytes(ByteBuffer& _buffer, uint8_t const* _bytes, uint32_t _count);
+    void AlignFourBytes(ByteBuffer& _buffer, bool _padExtra = false);
+    static bool SaveBufferToFile(wstring const& _fileName, uint8_t const* _data, uint32_t _size);
 
     string GetAddressString(uint32_t _address);
 
+    // Parsers shared by loading and scanning
+    bool ParseBN(uint8_t const* _data, uint32_t _size, ScanInfo* _scan, string& _errorMsg);
+    bool ParseSF(shared_ptr<uint8_t const> const& _data, uint32_t _size, ScanInfo* _scan, string& _errorMsg);
+
+    // Content hashes of existing tilesets and palettes, used by merging to find duplicates
+    struct MergeIndex
+    {
+        unordered_multimap<uint64_t, uint32_t> m_tilesets;
+        unordered_multimap<uint64_t, uint32_t> m_palettes;  // palettes of group 0 in 256 color, palette groups in 16 color
+    };
+
+    static uint64_t HashBytes(void const* _data, size_t _size, uint64_t _hash = 0xCBF29CE484222325ull);
+    static uint64_t HashPaletteGroup(PaletteGroup const& _group);
+    void BuildMergeIndex(MergeIndex& _index) const;
+    uint32_t AddTileset(MergeIndex& _index, Tileset const& _tileset);
+    uint32_t AddPalette(MergeIndex& _index, Palette const& _palette);
+    uint32_t AddPaletteGroup(MergeIndex& _index, PaletteGroup const& _group);
+    bool MergeSprite(BNSprite const& _other, MergeIndex& _index, string& _errorMsg);
+
+    // OAM block used by RemoveDuplicateTiles(), _flip has horizontal in bit 0 and vertical in bit 1
+    struct TileBlock
+    {
+        uint16_t m_startTile;
+        uint8_t m_sizeX;
+        uint8_t m_sizeY;
+        uint8_t m_flip;
+    };
+
+    static void ReadTileBlock(vector<uint8_t> const& _pixels, TileBlock const& _block, vector<uint8_t>& _raster);
+
+    // Flat frame storage, every level is a single array for the whole sprite and
+    // entries refer to a range of the level below. Each range is owned by one entry,
+    // replacing a frame appends new ranges and leaves the old ones unused until compacted
+    struct Range
+    {
+        uint32_t m_start;
+        uint32_t m_count;
+
+        Range()
+            : m_start(0)
+            , m_count(0)
+        {}
+
+        uint32_t End() const { return m_start + m_count; }
+    };
+
+    // Snapshot nodes are immutable and shared by every snapshot until the content changes,
+    // frames captured together are stored in one chunk
+    struct FrameStore;
+    struct FrameNode
+    {
+        shared_ptr<FrameStore const> m_chunk;
+        uint32_t m_index;
+
+        FrameNode()
+            : m_index(0)
+        {}
+    };
+
+    struct AnimationNode
+    {
+        bool m_loop;
+        vector<FrameNode> m_frames;
+    };
+
+    struct AnimationEntry
+    {
+        bool m_loop;
+        Range m_frames;
+        shared_ptr<AnimationNode const> m_snapshot; // reset when the animation changes
+
+        AnimationEntry()
+            : m_loop(false)
+        {}
+    };
+
+    struct FrameEntry
+    {
+        bool m_specialFlag0;
+        bool m_specialFlag1;
+
+        uint32_t m_tilesetID;
+        uint32_t m_paletteGroupID;
+        Range m_subAnimations;
+        Range m_objects;
+
+        uint8_t m_delay;
+        FrameNode m_snapshot;   // reset when the frame changes in place
+
+        FrameEntry()
+            : m_specialFlag0(false)
+            , m_specialFlag1(false)
+            , m_tilesetID(0)
+            , m_paletteGroupID(0)
+            , m_delay(1)
+        {}
+    };
+
+    struct SubAnimationEntry
+    {
+        bool m_loop;
+        Range m_subFrames;
+
+        SubAnimationEntry()
+            : m_loop(false)
+        {}
+    };
+
+    struct ObjectEntry
+    {
+        uint8_t m_paletteIndex;
+        Range m_subObjects;
+
+        ObjectEntry()
+            : m_paletteIndex(0)
+        {}
+    };
+
+    struct FrameStore
+    {
+        vector<FrameEntry> m_frames;
+        vector<SubAnimationEntry> m_subAnimations;
+        vector<SubFrame> m_subFrames;
+        vector<ObjectEntry> m_objects;
+        vector<SubObject> m_subObjects;
+        uint32_t m_unusedCount;
+
+        FrameStore()
+            : m_unusedCount(0)
+        {}
+
+        void Clear();
+        FrameEntry Append(Frame const& _frame);
+        FrameEntry AppendDefault();
+        FrameEntry Append(FrameStore const& _source, FrameEntry const& _entry);
+        Frame Extract(FrameEntry const& _entry) const;
+        bool Matches(FrameEntry const& _entry, Frame const& _frame) const;
+        uint32_t GetEntryCount(FrameEntry const& _entry) const;
+        uint32_t GetTotalCount() const;
+        size_t GetMemorySize() const;
+    };
+
+    // Odd start tiles ConvertBNtoSF() pads a blank tile before, per tileset
+    typedef vector<uint16_t> OddOAMList;
+    void GetOddOAMLists(vector<OddOAMList>& _listPerTileset) const;
+
+    // Snapshot helpers
+    static void Touch(AnimationEntry& _anim, FrameEntry& _frame) { _anim.m_snapshot.reset(); _frame.m_snapshot = FrameNode(); }
+    void DropSnapshotNodes();
+
+    // Frame storage helpers
+    FrameEntry& GetFrameEntry(AnimationEntry const& _anim, uint32_t _frameID) { return m_store.m_frames[_anim.m_frames.m_start + _frameID]; }
+    FrameEntry const& GetFrameEntry(AnimationEntry const& _anim, uint32_t _frameID) const { return m_store.m_frames[_anim.m_frames.m_start + _frameID]; }
+    void PushFrame(AnimationEntry& _anim, FrameEntry const& _entry);
+    void CompactIfNeeded();
+    void Compact();
+
+public:
+    // Views read frames directly from the storage without copying them,
+    // they are only valid until the sprite is next modified
+    template <typename T>
+    class ArrayView
+    {
+    public:
+        ArrayView(T const* _data, uint32_t _size)
+            : m_data(_data)
+            , m_size(_size)
+        {}
+
+        ArrayView(vector<T> const& _data)
+            : m_data(_data.data())
+            , m_size(_data.size())
+        {}
+
+        T const* begin() const { return m_data; }
+        T const* end() const { return m_data + m_size; }
+        uint32_t size() const { return m_size; }
+        bool empty() const { return m_size == 0; }
+        T const& operator[](uint32_t _index) const { return m_data[_index]; }
+
+    private:
+        T const* m_data;
+        uint32_t m_size;
+    };
+
+    class SubAnimationView
+    {
+    public:
+        bool GetLoop() const { return m_entry->m_loop; }
+        ArrayView<SubFrame> GetSubFrames() const;
+
+    private:
+        friend class BNSprite;
+        SubAnimationView(FrameStore const& _store, SubAnimationEntry const& _entry)
+            : m_store(&_store)
+            , m_entry(&_entry)
+        {}
+
+        FrameStore const* m_store;
+        SubAnimationEntry const* m_entry;
+    };
+
+    class ObjectView
+    {
+    public:
+        uint8_t GetPaletteIndex() const { return m_entry->m_paletteIndex; }
+        ArrayView<SubObject> GetSubObjects() const;
+
+    private:
+        friend class BNSprite;
+        ObjectView(FrameStore const& _store, ObjectEntry const& _entry)
+            : m_store(&_store)
+            , m_entry(&_entry)
+        {}
+
+        FrameStore const* m_store;
+        ObjectEntry const* m_entry;
+    };
+
+    class FrameView
+    {
+    public:
+        bool GetSpecialFlag0() const { return m_entry->m_specialFlag0; }
+        bool GetSpecialFlag1() const { return m_entry->m_specialFlag1; }
+        uint32_t GetTilesetID() const { return m_entry->m_tilesetID; }
+        uint32_t GetPaletteGroupID() const { return m_entry->m_paletteGroupID; }
+        uint8_t GetDelay() const { return m_entry->m_delay; }
+        uint32_t GetSubAnimationCount() const { return m_entry->m_subAnimations.m_count; }
+        SubAnimationView GetSubAnimation(uint32_t _index) const;
+        uint32_t GetObjectCount() const { return m_entry->m_objects.m_count; }
+        ObjectView GetObject(uint32_t _index) const;
+        Frame ToFrame() const { return m_store->Extract(*m_entry); }
+
+    private:
+        friend class BNSprite;
+        FrameView(FrameStore const& _store, FrameEntry const& _entry)
+            : m_store(&_store)
+            , m_entry(&_entry)
+        {}
+
+        FrameStore const* m_store;
+        FrameEntry const* m_entry;
+    };
+
+    // Edits change the stored frame in place, the structure of the frame cannot change
+    class ObjectEdit
+    {
+    public:
+        uint8_t GetPaletteIndex() const { return m_entry->m_paletteIndex; }
+        void SetPaletteIndex(uint8_t _paletteIndex);
+        uint32_t GetSubObjectCount() const { return m_entry->m_subObjects.m_count; }
+        SubObject& GetSubObject(uint32_t _index);
+
+    private:
+        friend class BNSprite;
+        ObjectEdit(FrameStore& _store, AnimationEntry& _anim, FrameEntry& _frame, ObjectEntry& _entry)
+            : m_store(&_store)
+            , m_anim(&_anim)
+            , m_frame(&_frame)
+            , m_entry(&_entry)
+        {}
+
+        FrameStore* m_store;
+        AnimationEntry* m_anim;
+        FrameEntry* m_frame;
+        ObjectEntry* m_entry;
+    };
+
+    class FrameEdit
+    {
+    public:
+        uint32_t GetTilesetID() const { return m_entry->m_tilesetID; }
+        void SetTilesetID(uint32_t _tilesetID);
+        uint32_t GetPaletteGroupID() const { return m_entry->m_paletteGroupID; }
+        void SetPaletteGroupID(uint32_t _paletteGroupID);
+        uint8_t GetDelay() const { return m_entry->m_delay; }
+        void SetDelay(uint8_t _delay);
+        uint32_t GetObjectCount() const { return m_entry->m_objects.m_count; }
+        ObjectEdit GetObject(uint32_t _index);
+
+    private:
+        friend class BNSprite;
+        FrameEdit(FrameStore& _store, AnimationEntry& _anim, FrameEntry& _entry)
+            : m_store(&_store)
+            , m_anim(&_anim)
+            , m_entry(&_entry)
+        {}
+
+        FrameStore* m_store;
+        AnimationEntry* m_anim;
+        FrameEntry* m_entry;
+    };
+
+    FrameView GetAnimationFrameView(int _animID, int _frameID) const;
+
+    // Immutable copy of the whole sprite for undo history. Frames and animations that did not
+    // change since the previous snapshot are shared with it, tilesets share their data until modified
+    class Snapshot
+    {
+    public:
+        size_t GetSize() const { return m_size; }
+        bool IsSameAs(Snapshot const& _other) const;
+
+        // Add the bytes held by this snapshot that aren't in _counted yet, so snapshots
+        // sharing data can be counted together without counting anything twice
+        void CountMemory(set<void const*>& _counted, size_t& _size) const;
+
+    private:
+        friend class BNSprite;
+        Snapshot()
+            : m_loaded(false)
+            , m_256ColorMode(false)
+            , m_size(0)
+        {}
+
+        bool m_loaded;
+        bool m_256ColorMode;
+        vector<shared_ptr<AnimationNode const>> m_animations;
+        vector<Tileset> m_tilesets;
+        shared_ptr<vector<PaletteGroup> const> m_paletteGroups;
+        size_t m_size;  // bytes allocated by this snapshot, not counting what it shares
+    };
+
+    shared_ptr<Snapshot const> TakeSnapshot();
+    void RestoreSnapshot(Snapshot const& _snapshot);
+    static FrameView GetSnapshotFrameView(Snapshot const& _snapshot, int _animID, int _frameID);
+
+    // What changed since the last SaveIncremental(), everything is dirty before the first one.
+    // Saving to the same file again only writes the bytes that changed if the file size stays the same
+    struct DirtyInfo
+    {
+        bool m_layout; // color mode or number of animations, tilesets or palette groups changed
+        vector<bool> m_animations;
+        vector<bool> m_tilesets;
+        vector<bool> m_paletteGroups;
+
+        DirtyInfo()
+            : m_layout(false)
+        {}
+
+        bool IsDirty() const;
+    };
+    void GetDirtyInfo(DirtyInfo& _info) const;
+
+    // Size and sharing numbers gathered in one pass over the sprite
+    struct Statistics
+    {
+        uint32_t m_frameCount;
+        vector<uint32_t> m_framesPerAnimation;
+        uint32_t m_objectCount;
+        uint32_t m_oamCount;
+        vector<uint32_t> m_oamsPerObject;           // number of objects with [n] OAMs
+
+        vector<uint32_t> m_tilesPerTileset;
+        vector<uint32_t> m_tilesetReferences;       // frames using each tileset
+        vector<uint32_t> m_paletteGroupReferences;  // frames using each palette group
+        uint32_t m_sharedTilesets;                  // used by more than one frame
+        uint32_t m_uniqueTilesets;                  // used by exactly one frame
+        uint32_t m_sharedPaletteGroups;
+        uint32_t m_uniquePaletteGroups;
+
+        uint32_t m_bnSize;                          // 0 if SaveBN would fail
+        uint32_t m_sfSize;                          // 0 if SaveSF would fail
+        uint64_t m_heapBytes;                       // owned by this sprite
+        uint64_t m_sharedHeapBytes;                 // tileset data shared with the loaded file or the undo history
+
+        Statistics()
+            : m_frameCount(0)
+            , m_objectCount(0)
+            , m_oamCount(0)
+            , m_sharedTilesets(0)
+            , m_uniqueTilesets(0)
+            , m_sharedPaletteGroups(0)
+            , m_uniquePaletteGroups(0)
+            , m_bnSize(0)
+            , m_sfSize(0)
+            , m_heapBytes(0)
+            , m_sharedHeapBytes(0)
+        {}
+    };
+    void GetStatistics(Statistics& _stats) const;
+
+    // Call _visitor(animID, frameID, FrameEdit&) for every frame of every animation
+    template <typename Visitor>
+    void VisitFrames(Visitor _visitor)
+    {
+        for (uint32_t i = 0; i < m_animations.size(); i++)
+        {
+            for (uint32_t j = 0; j < m_animations[i].m_frames.m_count; j++)
+            {
+                FrameEdit frame(m_store, m_animations[i], GetFrameEntry(m_animations[i], j));
+                _visitor(static_cast<int>(i), static_cast<int>(j), frame);
+            }
+        }
+    }
+
+    // Call _visitor(ObjectEdit&) for every object of every frame
+    template <typename Visitor>
+    void VisitObjects(Visitor _visitor)
+    {
+        for (uint32_t i = 0; i < m_animations.size(); i++)
+        {
+            Range const& frames = m_animations[i].m_frames;
+            for (uint32_t j = frames.m_start; j < frames.End(); j++)
+            {
+                Range const& objects = m_store.m_frames[j].m_objects;
+                for (uint32_t k = objects.m_start; k < objects.End(); k++)
+                {
+                    ObjectEdit object(m_store, m_animations[i], m_store.m_frames[j], m_store.m_objects[k]);
+                    _visitor(object);
+                }
+            }
+        }
+    }
+
+private:
+    // Last file written by SaveIncremental() and the sprite state it was written from
+    struct SavedFile
+    {
+        wstring m_fileName;
+        bool m_sfFormat;
+        shared_ptr<vector<uint8_t> const> m_data;
+        shared_ptr<Snapshot const> m_snapshot;
+        int64_t m_fileSize;
+        int64_t m_fileTime;
+
+        SavedFile()
+            : m_sfFormat(false)
+            , m_fileSize(-1)
+            , m_fileTime(0)
+        {}
+    };
+
+    bool IsSavedFileUnchanged(wstring const& _fileName, bool _sfFormat) const;
+    static bool PatchFile(wstring const& _fileName, vector<uint8_t> const& _oldData, vector<uint8_t> const& _newData);
+    static bool GetFileStamp(wstring const& _fileName, int64_t& _size, int64_t& _time);
+
 private:
     bool m_loaded;
     bool m_256ColorMode;
 
-    vector<Animation> m_animations;
+    vector<AnimationEntry> m_animations;
+    FrameStore m_store;
+    shared_ptr<vector<PaletteGroup> const> m_paletteSnapshot;
     vector<Tileset> m_tilesets;
     vector<PaletteGroup> m_paletteGroups;
+    SavedFile m_savedFile;
 };
 
 #endif // BNSPRITE_H
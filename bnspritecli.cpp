@@ -0,0 +1,1359 @@
+#include "allocationcounter.h"
+#include "bnsprite.h"
+#include "bnspritegenerator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+enum class SpriteFormat
+{
+    BN,
+    SF
+};
+
+struct CliOptions
+{
+    SpriteFormat m_from = SpriteFormat::BN;
+    SpriteFormat m_to = SpriteFormat::BN;
+    bool m_toSet = false;
+    string m_extension;
+    int m_threads = 0;
+    bool m_verbose = false;
+    bool m_dedupeTiles = false;
+    int m_iterations = 20;
+    string m_json;
+    BNSpriteGenerator::Options m_generator;
+    double m_budgets[3] = {0.0, 0.0, 0.0};
+    vector<string> m_args;
+};
+
+struct ConvertTask
+{
+    fs::path m_input;
+    fs::path m_output;
+    uint32_t m_bytesSaved = 0;
+    bool m_success = false;
+    string m_errorMsg;
+};
+
+struct BenchResult
+{
+    string m_sprite;
+    string m_operation;
+    int m_iterations = 0;
+    double m_seconds = 0.0;
+    double m_bytes = 0.0;
+    double m_frames = 0.0;
+    uint64_t m_allocations = 0;
+    uint64_t m_allocatedBytes = 0;
+    string m_errorMsg;
+};
+
+// Timed stages of a round trip, budgets are given in the same order
+enum RoundTripStage
+{
+    RTS_Load,
+    RTS_Save,
+    RTS_Reload,
+    RTS_COUNT
+};
+
+char const* const c_roundTripStageNames[RTS_COUNT] = {"load", "save", "reload"};
+
+struct RoundTripTask
+{
+    fs::path m_input;
+    double m_seconds[RTS_COUNT] = {0.0, 0.0, 0.0};
+    bool m_success = false;
+    string m_errorMsg;
+};
+
+struct ScanTask
+{
+    fs::path m_input;
+    BNSprite::ScanInfo m_info;
+    bool m_success = false;
+    string m_errorMsg;
+};
+
+struct StatsTask
+{
+    fs::path m_input;
+    BNSprite::Statistics m_stats;
+    bool m_success = false;
+    string m_errorMsg;
+};
+
+//-----------------------------------------------------
+// Print usage
+//-----------------------------------------------------
+static void PrintUsage()
+{
+    printf("Usage: bnspritecli <command> [options] <paths...>\n"
+           "\n"
+           "Commands:\n"
+           "  convert <input> <output>     Convert a sprite, or every sprite in a directory tree\n"
+           "  merge <output> <inputs...>   Merge sprites into a single file\n"
+           "  scan <inputs...>             Validate sprites and print their statistics\n"
+           "  stats <inputs...>            Load sprites and print their sizes, sharing and memory use\n"
+           "  bench [fixtures...]          Time the sprite core on a synthetic sprite and fixtures\n"
+           "  generate <output>            Generate a deterministic synthetic sprite\n"
+           "  roundtrip <inputs...>        Check sprites survive load, save and reload unchanged\n"
+           "\n"
+           "Options:\n"
+           "  --from bn|sf     Input sprite format (default: bn)\n"
+           "  --to bn|sf       Output sprite format (default: same as input)\n"
+           "  --ext <ext>      Only process files with this extension in directories\n"
+           "  -j <threads>     Number of worker threads (default: all cores)\n"
+           "  -v               Show loader progress output\n"
+           "  --dedupe-tiles   Convert: share duplicate and flipped OAM tiles before saving\n"
+           "  --iterations <n> Benchmark iterations per operation (default: 20)\n"
+           "  --json <file>    Also write benchmark or stats results as JSON\n"
+           "  --budget-load <ms>, --budget-save <ms>, --budget-reload <ms>\n"
+           "                   Fail a round trip if a stage takes longer than this\n"
+           "\n"
+           "Generate options:\n"
+           "  --seed <n>            Random seed (default: 0)\n"
+           "  --animations <n>      Animation count (default: 16)\n"
+           "  --frames <n>          Frames per animation (default: 8)\n"
+           "  --unique-frames <n>   Reuse frame layouts after this many, 0 for all unique (default: 0)\n"
+           "  --objects <n>         Objects per frame, BN only (default: 1)\n"
+           "  --oams <n>            OAMs per object (default: 4)\n"
+           "  --sub-anims <n>       Sub animations per frame, BN only (default: 1)\n"
+           "  --sub-frames <n>      Frames per sub animation, BN only (default: 1)\n"
+           "  --tilesets <n>        Tileset count (default: 16)\n"
+           "  --tiles <n>           Tiles per tileset (default: 128)\n"
+           "  --palette-groups <n>  Palette group count, BN only (default: 1)\n"
+           "  --palettes <n>        Palettes per group (default: 16)\n"
+           "  --256                 256 color mode, SF only\n");
+}
+
+//-----------------------------------------------------
+// Parse sprite format name
+//-----------------------------------------------------
+static bool ParseFormat
+(
+    string const& _name,
+    SpriteFormat& _format
+)
+{
+    if (_name == "bn")
+    {
+        _format = SpriteFormat::BN;
+        return true;
+    }
+    if (_name == "sf")
+    {
+        _format = SpriteFormat::SF;
+        return true;
+    }
+    return false;
+}
+
+//-----------------------------------------------------
+// Parse options after the command, return false if fail
+//-----------------------------------------------------
+static bool ParseOptions
+(
+    int _argc,
+    char* _argv[],
+    CliOptions& _options
+)
+{
+    BNSpriteGenerator::Options& generator = _options.m_generator;
+    pair<char const*, int*> const generatorOptions[] =
+    {
+        {"--animations", &generator.m_animationCount},
+        {"--frames", &generator.m_frameCount},
+        {"--unique-frames", &generator.m_uniqueFrameCount},
+        {"--objects", &generator.m_objectCount},
+        {"--oams", &generator.m_subObjectCount},
+        {"--sub-anims", &generator.m_subAnimationCount},
+        {"--sub-frames", &generator.m_subFrameCount},
+        {"--tilesets", &generator.m_tilesetCount},
+        {"--tiles", &generator.m_tileCount},
+        {"--palette-groups", &generator.m_paletteGroupCount},
+        {"--palettes", &generator.m_paletteCount},
+    };
+
+    for (int i = 2; i < _argc; i++)
+    {
+        string const arg = _argv[i];
+        bool const hasValue = i + 1 < _argc;
+
+        auto generatorOption = find_if(begin(generatorOptions), end(generatorOptions),
+            [&arg](pair<char const*, int*> const& _option) { return arg == _option.first; });
+        if (generatorOption != end(generatorOptions) && hasValue)
+        {
+            *generatorOption->second = atoi(_argv[++i]);
+        }
+        else if (arg == "--seed" && hasValue)
+        {
+            generator.m_seed = static_cast<uint32_t>(strtoul(_argv[++i], nullptr, 0));
+        }
+        else if (arg == "--256")
+        {
+            generator.m_256ColorMode = true;
+        }
+        else if (arg == "--from" && hasValue)
+        {
+            if (!ParseFormat(_argv[++i], _options.m_from)) return false;
+        }
+        else if (arg == "--to" && hasValue)
+        {
+            if (!ParseFormat(_argv[++i], _options.m_to)) return false;
+            _options.m_toSet = true;
+        }
+        else if (arg == "--ext" && hasValue)
+        {
+            _options.m_extension = _argv[++i];
+            if (!_options.m_extension.empty() && _options.m_extension[0] != '.')
+            {
+                _options.m_extension = "." + _options.m_extension;
+            }
+        }
+        else if (arg == "-j" && hasValue)
+        {
+            _options.m_threads = atoi(_argv[++i]);
+        }
+        else if (arg == "-v")
+        {
+            _options.m_verbose = true;
+        }
+        else if (arg == "--dedupe-tiles")
+        {
+            _options.m_dedupeTiles = true;
+        }
+        else if (arg == "--iterations" && hasValue)
+        {
+            _options.m_iterations = max(1, atoi(_argv[++i]));
+        }
+        else if (arg.compare(0, 9, "--budget-") == 0 && hasValue)
+        {
+            auto stage = find(begin(c_roundTripStageNames), end(c_roundTripStageNames), arg.substr(9));
+            if (stage == end(c_roundTripStageNames)) return false;
+            _options.m_budgets[stage - begin(c_roundTripStageNames)] = atof(_argv[++i]);
+        }
+        else if (arg == "--json" && hasValue)
+        {
+            _options.m_json = _argv[++i];
+        }
+        else if (!arg.empty() && arg[0] == '-')
+        {
+            return false;
+        }
+        else
+        {
+            _options.m_args.push_back(arg);
+        }
+    }
+
+    if (!_options.m_toSet)
+    {
+        _options.m_to = _options.m_from;
+    }
+
+    if (_options.m_threads <= 0)
+    {
+        _options.m_threads = max(1u, thread::hardware_concurrency());
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------
+// Load a sprite in the given format
+//-----------------------------------------------------
+static bool LoadSprite
+(
+    BNSprite& _sprite,
+    fs::path const& _path,
+    SpriteFormat _format,
+    string& _errorMsg
+)
+{
+    if (_format == SpriteFormat::SF)
+    {
+        return _sprite.LoadSF(_path.wstring(), _errorMsg);
+    }
+    return _sprite.LoadBN(_path.wstring(), _errorMsg);
+}
+
+//-----------------------------------------------------
+// Save a sprite in the given format, converting BN to SF when needed
+//-----------------------------------------------------
+static bool SaveSprite
+(
+    BNSprite& _sprite,
+    fs::path const& _path,
+    SpriteFormat _from,
+    SpriteFormat _to,
+    string& _errorMsg
+)
+{
+    if (_to == SpriteFormat::SF)
+    {
+        if (_from == SpriteFormat::BN && !_sprite.Is256Color())
+        {
+            bool modified = false;
+            if (!_sprite.ConvertBNtoSF(modified, _errorMsg))
+            {
+                return false;
+            }
+        }
+        return _sprite.SaveSF(_path.wstring(), _errorMsg);
+    }
+    return _sprite.SaveBN(_path.wstring(), _errorMsg);
+}
+
+//-----------------------------------------------------
+// Collect sprite files from a file or directory tree
+//-----------------------------------------------------
+static void CollectInputs
+(
+    fs::path const& _input,
+    string const& _extension,
+    vector<fs::path>& _files
+)
+{
+    if (!fs::is_directory(_input))
+    {
+        _files.push_back(_input);
+        return;
+    }
+
+    for (fs::directory_entry const& entry : fs::recursive_directory_iterator(_input))
+    {
+        if (!entry.is_regular_file()) continue;
+        if (!_extension.empty() && entry.path().extension() != _extension) continue;
+        _files.push_back(entry.path());
+    }
+    sort(_files.begin(), _files.end());
+}
+
+//-----------------------------------------------------
+// Convert a sprite or a directory tree of sprites
+//-----------------------------------------------------
+static int RunConvert
+(
+    CliOptions const& _options
+)
+{
+    if (_options.m_args.size() != 2)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    fs::path const input = _options.m_args[0];
+    fs::path const output = _options.m_args[1];
+    bool const isDirectory = fs::is_directory(input);
+
+    vector<fs::path> files;
+    CollectInputs(input, _options.m_extension, files);
+
+    // Mirror the input tree in the output directory
+    vector<ConvertTask> tasks(files.size());
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        tasks[i].m_input = files[i];
+        if (isDirectory)
+        {
+            tasks[i].m_output = output / fs::relative(files[i], input);
+        }
+        else
+        {
+            tasks[i].m_output = fs::is_directory(output) ? output / input.filename() : output;
+        }
+    }
+
+    BNSprite::RunParallel(tasks.size(), _options.m_threads, [&](size_t _index)
+    {
+        ConvertTask& task = tasks[_index];
+
+        error_code ec;
+        if (task.m_output.has_parent_path())
+        {
+            fs::create_directories(task.m_output.parent_path(), ec);
+        }
+
+        // Each task owns its sprite, nothing is shared between workers
+        BNSprite sprite;
+        task.m_success = LoadSprite(sprite, task.m_input, _options.m_from, task.m_errorMsg);
+        if (task.m_success && _options.m_dedupeTiles)
+        {
+            task.m_bytesSaved = sprite.RemoveDuplicateTiles();
+        }
+        task.m_success = task.m_success && SaveSprite(sprite, task.m_output, _options.m_from, _options.m_to, task.m_errorMsg);
+    });
+
+    int failCount = 0;
+    uint64_t totalBytesSaved = 0;
+    for (ConvertTask const& task : tasks)
+    {
+        if (task.m_success && _options.m_dedupeTiles)
+        {
+            printf("OK   %s (%u tile bytes saved)\n", task.m_input.string().c_str(), task.m_bytesSaved);
+            totalBytesSaved += task.m_bytesSaved;
+        }
+        else if (task.m_success)
+        {
+            printf("OK   %s\n", task.m_input.string().c_str());
+        }
+        else
+        {
+            printf("FAIL %s: %s\n", task.m_input.string().c_str(), task.m_errorMsg.c_str());
+            failCount++;
+        }
+    }
+
+    printf("%d converted, %d failed\n", (int)tasks.size() - failCount, failCount);
+    if (_options.m_dedupeTiles)
+    {
+        printf("%llu tile bytes saved\n", (unsigned long long)totalBytesSaved);
+    }
+    return failCount > 0 ? 1 : 0;
+}
+
+//-----------------------------------------------------
+// Merge several sprites into one
+//-----------------------------------------------------
+static int RunMerge
+(
+    CliOptions const& _options
+)
+{
+    if (_options.m_args.size() < 3)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    fs::path const output = _options.m_args[0];
+    vector<BNSprite::LoadRequest> requests(_options.m_args.size() - 1);
+    for (size_t i = 0; i < requests.size(); i++)
+    {
+        requests[i].m_fileName = fs::path(_options.m_args[i + 1]).wstring();
+        requests[i].m_sfFormat = _options.m_from == SpriteFormat::SF;
+    }
+
+    // Load in parallel, merge in the order given
+    vector<BNSprite> sprites;
+    vector<BNSprite::LoadResult> results;
+    BNSprite::LoadMultiple(requests, sprites, results, _options.m_threads);
+
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        if (!results[i].m_success)
+        {
+            printf("FAIL %s: %s\n", _options.m_args[i + 1].c_str(), results[i].m_errorMsg.c_str());
+            return 1;
+        }
+    }
+
+    vector<BNSprite const*> others;
+    for (size_t i = 1; i < sprites.size(); i++)
+    {
+        others.push_back(&sprites[i]);
+    }
+
+    string errorMsg;
+    uint32_t mergedCount = 0;
+    if (!sprites[0].Merge(others, mergedCount, errorMsg))
+    {
+        printf("FAIL %s: %s\n", _options.m_args[mergedCount + 2].c_str(), errorMsg.c_str());
+        return 1;
+    }
+
+    if (!SaveSprite(sprites[0], output, _options.m_from, _options.m_to, errorMsg))
+    {
+        printf("FAIL %s: %s\n", output.string().c_str(), errorMsg.c_str());
+        return 1;
+    }
+
+    printf("OK   %s (%d animations)\n", output.string().c_str(), sprites[0].GetAnimationCount());
+    return 0;
+}
+
+//-----------------------------------------------------
+// Validate sprites without loading them
+//-----------------------------------------------------
+static int RunScan
+(
+    CliOptions const& _options
+)
+{
+    if (_options.m_args.empty())
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    vector<fs::path> files;
+    for (string const& arg : _options.m_args)
+    {
+        CollectInputs(arg, _options.m_extension, files);
+    }
+
+    vector<ScanTask> tasks(files.size());
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        tasks[i].m_input = files[i];
+    }
+
+    BNSprite::RunParallel(tasks.size(), _options.m_threads, [&](size_t _index)
+    {
+        ScanTask& task = tasks[_index];
+        if (_options.m_from == SpriteFormat::SF)
+        {
+            task.m_success = BNSprite::ScanSF(task.m_input.wstring(), task.m_info, task.m_errorMsg);
+        }
+        else
+        {
+            task.m_success = BNSprite::ScanBN(task.m_input.wstring(), task.m_info, task.m_errorMsg);
+        }
+    });
+
+    int failCount = 0;
+    BNSprite::ScanInfo total;
+    for (ScanTask const& task : tasks)
+    {
+        if (!task.m_success)
+        {
+            printf("FAIL %s: %s\n", task.m_input.string().c_str(), task.m_errorMsg.c_str());
+            failCount++;
+            continue;
+        }
+
+        BNSprite::ScanInfo const& info = task.m_info;
+        printf("OK   %s: %u animations, %u frames, %u tilesets, %u palettes in %u groups, %u OAMs%s\n",
+               task.m_input.string().c_str(), info.m_animationCount, info.m_frameCount, info.m_tilesetCount,
+               info.m_paletteCount, info.m_paletteGroupCount, info.m_oamCount, info.m_256ColorMode ? " (256 colors)" : "");
+
+        total.m_animationCount += info.m_animationCount;
+        total.m_frameCount += info.m_frameCount;
+        total.m_tilesetCount += info.m_tilesetCount;
+        total.m_paletteCount += info.m_paletteCount;
+        total.m_oamCount += info.m_oamCount;
+    }
+
+    printf("%d valid, %d invalid: %u animations, %u frames, %u tilesets, %u palettes, %u OAMs\n",
+           (int)tasks.size() - failCount, failCount, total.m_animationCount, total.m_frameCount,
+           total.m_tilesetCount, total.m_paletteCount, total.m_oamCount);
+    return failCount > 0 ? 1 : 0;
+}
+
+//-----------------------------------------------------
+// Escape a string for JSON output
+//-----------------------------------------------------
+static string EscapeJson
+(
+    string const& _text
+)
+{
+    string escaped;
+    for (char c : _text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            escaped.push_back('\\');
+            escaped.push_back(c);
+        }
+        else if (c == '\n') escaped += "\\n";
+        else if (c == '\r') escaped += "\\r";
+        else if (c == '\t') escaped += "\\t";
+        else if ((unsigned char)c < 0x20)
+        {
+            char code[8];
+            snprintf(code, sizeof(code), "\\u%04x", (unsigned char)c);
+            escaped += code;
+        }
+        else
+        {
+            escaped.push_back(c);
+        }
+    }
+    return escaped;
+}
+
+//-----------------------------------------------------
+// Write a list of numbers as a JSON array
+//-----------------------------------------------------
+static void WriteJsonArray
+(
+    FILE* _file,
+    vector<uint32_t> const& _values
+)
+{
+    fprintf(_file, "[");
+    for (size_t i = 0; i < _values.size(); i++)
+    {
+        fprintf(_file, "%s%u", i > 0 ? ", " : "", _values[i]);
+    }
+    fprintf(_file, "]");
+}
+
+//-----------------------------------------------------
+// Load sprites and print their statistics
+//-----------------------------------------------------
+static int RunStats
+(
+    CliOptions const& _options
+)
+{
+    if (_options.m_args.empty())
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    vector<fs::path> files;
+    for (string const& arg : _options.m_args)
+    {
+        CollectInputs(arg, _options.m_extension, files);
+    }
+
+    vector<StatsTask> tasks(files.size());
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        tasks[i].m_input = files[i];
+    }
+
+    BNSprite::RunParallel(tasks.size(), _options.m_threads, [&](size_t _index)
+    {
+        StatsTask& task = tasks[_index];
+
+        BNSprite sprite;
+        task.m_success = LoadSprite(sprite, task.m_input, _options.m_from, task.m_errorMsg);
+        if (task.m_success)
+        {
+            sprite.GetStatistics(task.m_stats);
+        }
+    });
+
+    int failCount = 0;
+    for (StatsTask const& task : tasks)
+    {
+        if (!task.m_success)
+        {
+            printf("FAIL %s: %s\n", task.m_input.string().c_str(), task.m_errorMsg.c_str());
+            failCount++;
+            continue;
+        }
+
+        BNSprite::Statistics const& stats = task.m_stats;
+        printf("OK   %s: %u frames in %d animations, %u objects, %u OAMs (max %d per object), "
+               "%d tilesets (%u shared), %d palette groups (%u shared), BN %u bytes, SF %u bytes, %.1f KB in memory\n",
+               task.m_input.string().c_str(), stats.m_frameCount, (int)stats.m_framesPerAnimation.size(),
+               stats.m_objectCount, stats.m_oamCount, max(0, (int)stats.m_oamsPerObject.size() - 1),
+               (int)stats.m_tilesPerTileset.size(), stats.m_sharedTilesets,
+               (int)stats.m_paletteGroupReferences.size(), stats.m_sharedPaletteGroups,
+               stats.m_bnSize, stats.m_sfSize, (stats.m_heapBytes + stats.m_sharedHeapBytes) / 1024.0);
+    }
+    printf("%d loaded, %d failed\n", (int)tasks.size() - failCount, failCount);
+
+    if (!_options.m_json.empty())
+    {
+        FILE* f = fopen(_options.m_json.c_str(), "w");
+        if (!f)
+        {
+            printf("FAIL %s: Unable to open file!\n", _options.m_json.c_str());
+            return 1;
+        }
+
+        fprintf(f, "{\n  \"sprites\": [");
+        bool first = true;
+        for (StatsTask const& task : tasks)
+        {
+            if (!task.m_success) continue;
+
+            BNSprite::Statistics const& stats = task.m_stats;
+            fprintf(f, "%s\n    {\"sprite\": \"%s\", \"frames\": %u, \"frames_per_animation\": ",
+                    first ? "" : ",", EscapeJson(task.m_input.string()).c_str(), stats.m_frameCount);
+            WriteJsonArray(f, stats.m_framesPerAnimation);
+            fprintf(f, ", \"objects\": %u, \"oams\": %u, \"oams_per_object\": ", stats.m_objectCount, stats.m_oamCount);
+            WriteJsonArray(f, stats.m_oamsPerObject);
+            fprintf(f, ", \"tiles_per_tileset\": ");
+            WriteJsonArray(f, stats.m_tilesPerTileset);
+            fprintf(f, ", \"tileset_references\": ");
+            WriteJsonArray(f, stats.m_tilesetReferences);
+            fprintf(f, ", \"palette_group_references\": ");
+            WriteJsonArray(f, stats.m_paletteGroupReferences);
+            fprintf(f, ", \"shared_tilesets\": %u, \"unique_tilesets\": %u, \"shared_palette_groups\": %u, \"unique_palette_groups\": %u"
+                       ", \"bn_size\": %u, \"sf_size\": %u, \"heap_bytes\": %llu, \"shared_heap_bytes\": %llu}",
+                    stats.m_sharedTilesets, stats.m_uniqueTilesets, stats.m_sharedPaletteGroups, stats.m_uniquePaletteGroups,
+                    stats.m_bnSize, stats.m_sfSize,
+                    static_cast<unsigned long long>(stats.m_heapBytes), static_cast<unsigned long long>(stats.m_sharedHeapBytes));
+            first = false;
+        }
+        fprintf(f, "\n  ]\n}\n");
+        fclose(f);
+    }
+
+    return failCount > 0 ? 1 : 0;
+}
+
+//-----------------------------------------------------
+// Compare the content of two sprites, tilesets and palette groups
+// are compared by content since saving may reorder them
+//-----------------------------------------------------
+static bool CompareSprites
+(
+    BNSprite& _expected,
+    BNSprite& _actual,
+    string& _errorMsg
+)
+{
+    if (_expected.Is256Color() != _actual.Is256Color())
+    {
+        _errorMsg = "Color mode differs";
+        return false;
+    }
+    if (_expected.GetAnimationCount() != _actual.GetAnimationCount())
+    {
+        _errorMsg = "Animation count differs";
+        return false;
+    }
+
+    vector<BNSprite::PaletteGroup> expectedGroups;
+    vector<BNSprite::PaletteGroup> actualGroups;
+    _expected.GetAllPaletteGroups(expectedGroups);
+    _actual.GetAllPaletteGroups(actualGroups);
+
+    auto samePaletteGroup = [&](uint32_t _expectedID, uint32_t _actualID)
+    {
+        if (_expectedID >= expectedGroups.size() || _actualID >= actualGroups.size())
+        {
+            return _expectedID >= expectedGroups.size() && _actualID >= actualGroups.size();
+        }
+
+        vector<BNSprite::Palette> const& a = expectedGroups[_expectedID].m_palettes;
+        vector<BNSprite::Palette> const& b = actualGroups[_actualID].m_palettes;
+        return a.size() == b.size() && equal(a.begin(), a.end(), b.begin(),
+            [](BNSprite::Palette const& _a, BNSprite::Palette const& _b) { return _a.m_colors == _b.m_colors; });
+    };
+
+    vector<uint8_t> expectedPixels;
+    vector<uint8_t> actualPixels;
+    for (int i = 0; i < _expected.GetAnimationCount(); i++)
+    {
+        vector<BNSprite::Frame> expectedFrames;
+        vector<BNSprite::Frame> actualFrames;
+        _expected.GetAnimationFrames(i, expectedFrames);
+        _actual.GetAnimationFrames(i, actualFrames);
+
+        string const prefix = "Animation " + to_string(i);
+        if (expectedFrames.size() != actualFrames.size())
+        {
+            _errorMsg = prefix + ": frame count differs";
+            return false;
+        }
+        if (_expected.GetAnimationLoop(i) != _actual.GetAnimationLoop(i))
+        {
+            _errorMsg = prefix + ": loop flag differs";
+            return false;
+        }
+
+        for (size_t j = 0; j < expectedFrames.size(); j++)
+        {
+            BNSprite::Frame const& a = expectedFrames[j];
+            BNSprite::Frame const& b = actualFrames[j];
+            string const framePrefix = prefix + " frame " + to_string(j) + ": ";
+
+            if (a.m_delay != b.m_delay || a.m_specialFlag0 != b.m_specialFlag0 || a.m_specialFlag1 != b.m_specialFlag1)
+            {
+                _errorMsg = framePrefix + "delay or flags differ";
+                return false;
+            }
+
+            if (a.m_tilesetID >= (uint32_t)_expected.GetTilesetCount() || b.m_tilesetID >= (uint32_t)_actual.GetTilesetCount())
+            {
+                _errorMsg = framePrefix + "invalid tileset";
+                return false;
+            }
+            _expected.GetTilesetPixels(a.m_tilesetID, expectedPixels);
+            _actual.GetTilesetPixels(b.m_tilesetID, actualPixels);
+            if (expectedPixels != actualPixels)
+            {
+                _errorMsg = framePrefix + "tileset differs";
+                return false;
+            }
+
+            if (!samePaletteGroup(a.m_paletteGroupID, b.m_paletteGroupID))
+            {
+                _errorMsg = framePrefix + "palette group differs";
+                return false;
+            }
+
+            if (a.m_objects.size() != b.m_objects.size())
+            {
+                _errorMsg = framePrefix + "object count differs";
+                return false;
+            }
+            for (size_t k = 0; k < a.m_objects.size(); k++)
+            {
+                BNSprite::Object const& objectA = a.m_objects[k];
+                BNSprite::Object const& objectB = b.m_objects[k];
+                if (objectA.m_paletteIndex != objectB.m_paletteIndex || objectA.m_subObjects != objectB.m_subObjects)
+                {
+                    _errorMsg = framePrefix + "object " + to_string(k) + " differs";
+                    return false;
+                }
+            }
+
+            if (a.m_subAnimations.size() != b.m_subAnimations.size())
+            {
+                _errorMsg = framePrefix + "sub animation count differs";
+                return false;
+            }
+            for (size_t k = 0; k < a.m_subAnimations.size(); k++)
+            {
+                BNSprite::SubAnimation const& subAnimA = a.m_subAnimations[k];
+                BNSprite::SubAnimation const& subAnimB = b.m_subAnimations[k];
+                if (subAnimA.m_loop != subAnimB.m_loop
+                 || subAnimA.m_subFrames.size() != subAnimB.m_subFrames.size()
+                 || !equal(subAnimA.m_subFrames.begin(), subAnimA.m_subFrames.end(), subAnimB.m_subFrames.begin(),
+                    [](BNSprite::SubFrame const& _a, BNSprite::SubFrame const& _b)
+                    {
+                        return _a.m_objectIndex == _b.m_objectIndex && _a.m_delay == _b.m_delay;
+                    }))
+                {
+                    _errorMsg = framePrefix + "sub animation " + to_string(k) + " differs";
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------
+// Load, save and reload one sprite, timing each stage
+//-----------------------------------------------------
+static bool RoundTripSprite
+(
+    RoundTripTask& _task,
+    SpriteFormat _format
+)
+{
+    bool const sf = _format == SpriteFormat::SF;
+    auto timeStage = [&_task](RoundTripStage _stage, function<bool()> const& _function)
+    {
+        auto start = chrono::steady_clock::now();
+        bool success = _function();
+        _task.m_seconds[_stage] = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        return success;
+    };
+
+    BNSprite original;
+    if (!timeStage(RTS_Load, [&]() { return LoadSprite(original, _task.m_input, _format, _task.m_errorMsg); }))
+    {
+        return false;
+    }
+
+    vector<uint8_t> saved;
+    if (!timeStage(RTS_Save, [&]() { return sf ? original.SaveSF(saved, _task.m_errorMsg) : original.SaveBN(saved, _task.m_errorMsg); }))
+    {
+        _task.m_errorMsg = "Save failed: " + _task.m_errorMsg;
+        return false;
+    }
+
+    BNSprite reloaded;
+    if (!timeStage(RTS_Reload, [&]()
+        {
+            return sf ? reloaded.LoadSF(saved.data(), saved.size(), _task.m_errorMsg)
+                      : reloaded.LoadBN(saved.data(), saved.size(), _task.m_errorMsg);
+        }))
+    {
+        _task.m_errorMsg = "Reload failed: " + _task.m_errorMsg;
+        return false;
+    }
+
+    if (!CompareSprites(original, reloaded, _task.m_errorMsg))
+    {
+        _task.m_errorMsg = "Structure mismatch: " + _task.m_errorMsg;
+        return false;
+    }
+
+    // The first save may reorder data, saving again after that must not change a byte
+    vector<uint8_t> resaved;
+    if (!(sf ? reloaded.SaveSF(resaved, _task.m_errorMsg) : reloaded.SaveBN(resaved, _task.m_errorMsg)))
+    {
+        _task.m_errorMsg = "Resave failed: " + _task.m_errorMsg;
+        return false;
+    }
+    if (resaved != saved)
+    {
+        auto mismatch = std::mismatch(saved.begin(), saved.end(), resaved.begin(), resaved.end());
+        _task.m_errorMsg = "Resaved file differs at offset " + to_string(mismatch.first - saved.begin());
+        return false;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------
+// Round trip sprites and check the stage budgets
+//-----------------------------------------------------
+static int RunRoundTrip
+(
+    CliOptions const& _options
+)
+{
+    if (_options.m_args.empty())
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    vector<fs::path> files;
+    for (string const& arg : _options.m_args)
+    {
+        CollectInputs(arg, _options.m_extension, files);
+    }
+
+    // Sprites run one at a time so the stage timings don't compete for cores
+    int failCount = 0;
+    for (fs::path const& file : files)
+    {
+        RoundTripTask task;
+        task.m_input = file;
+        task.m_success = RoundTripSprite(task, _options.m_from);
+
+        string timings;
+        for (int i = 0; i < RTS_COUNT; i++)
+        {
+            double const ms = task.m_seconds[i] * 1000.0;
+            char buffer[64];
+            snprintf(buffer, sizeof(buffer), "%s%s %.3fms", i > 0 ? ", " : "", c_roundTripStageNames[i], ms);
+            timings += buffer;
+
+            if (task.m_success && _options.m_budgets[i] > 0.0 && ms > _options.m_budgets[i])
+            {
+                task.m_success = false;
+                snprintf(buffer, sizeof(buffer), "%s took %.3fms, budget is %.3fms", c_roundTripStageNames[i], ms, _options.m_budgets[i]);
+                task.m_errorMsg = buffer;
+            }
+        }
+
+        if (task.m_success)
+        {
+            printf("OK   %s (%s)\n", file.string().c_str(), timings.c_str());
+        }
+        else
+        {
+            printf("FAIL %s: %s (%s)\n", file.string().c_str(), task.m_errorMsg.c_str(), timings.c_str());
+            failCount++;
+        }
+    }
+
+    printf("%d passed, %d failed\n", (int)files.size() - failCount, failCount);
+    return failCount > 0 || files.empty() ? 1 : 0;
+}
+
+//-----------------------------------------------------
+// Total frame count of a sprite
+//-----------------------------------------------------
+static int GetTotalFrameCount
+(
+    BNSprite& _sprite
+)
+{
+    int frameCount = 0;
+    for (int i = 0; i < _sprite.GetAnimationCount(); i++)
+    {
+        frameCount += _sprite.GetAnimationFrameCount(i);
+    }
+    return frameCount;
+}
+
+//-----------------------------------------------------
+// Time an operation over several iterations, _setup is not timed
+//-----------------------------------------------------
+static BenchResult TimeOperation
+(
+    string const& _sprite,
+    string const& _operation,
+    int _iterations,
+    double _bytes,
+    double _frames,
+    function<void()> const& _setup,
+    function<bool(string&)> const& _run
+)
+{
+    BenchResult result;
+    result.m_sprite = _sprite;
+    result.m_operation = _operation;
+    result.m_bytes = _bytes;
+    result.m_frames = _frames;
+
+    // Report the median so a single slow run doesn't skew the numbers
+    vector<double> times;
+    times.reserve(_iterations);
+    for (int i = 0; i < _iterations; i++)
+    {
+        if (_setup)
+        {
+            _setup();
+        }
+
+        AllocationCounter allocations;
+        auto start = chrono::steady_clock::now();
+        bool success = _run(result.m_errorMsg);
+        auto end = chrono::steady_clock::now();
+        if (!success)
+        {
+            return result;
+        }
+
+        // Every run does the same work, so the last one is as good as any
+        result.m_allocations = allocations.GetCount();
+        result.m_allocatedBytes = allocations.GetBytes();
+
+        times.push_back(chrono::duration<double>(end - start).count());
+    }
+
+    sort(times.begin(), times.end());
+    result.m_iterations = _iterations;
+    result.m_seconds = times[times.size() / 2];
+    return result;
+}
+
+//-----------------------------------------------------
+// Time every core operation on one sprite
+//-----------------------------------------------------
+static void BenchSprite
+(
+    string const& _name,
+    BNSprite const& _source,
+    int _iterations,
+    vector<BenchResult>& _results
+)
+{
+    BNSprite sprite = _source;
+    double const frames = GetTotalFrameCount(sprite);
+
+    double tilesetBytes = 0.0;
+    for (int i = 0; i < sprite.GetTilesetCount(); i++)
+    {
+        tilesetBytes += sprite.GetTilesetPixelCount(i) / (sprite.Is256Color() ? 1 : 2);
+    }
+
+    // Serialize once up front, loading is timed from memory
+    string bnErrorMsg;
+    string sfErrorMsg;
+    vector<uint8_t> bnData;
+    vector<uint8_t> sfData;
+    bool const hasBN = sprite.SaveBN(bnData, bnErrorMsg);
+    bool const hasSF = sprite.SaveSF(sfData, sfErrorMsg);
+    if (!hasBN)
+    {
+        fprintf(stderr, "%s: skipping BN operations: %s\n", _name.c_str(), bnErrorMsg.c_str());
+    }
+    if (!hasSF)
+    {
+        fprintf(stderr, "%s: skipping SF operations: %s\n", _name.c_str(), sfErrorMsg.c_str());
+    }
+
+    BNSprite work;
+    vector<uint8_t> buffer;
+    if (hasBN)
+    {
+        _results.push_back(TimeOperation(_name, "SaveBN", _iterations, bnData.size(), frames, nullptr,
+            [&](string& _errorMsg) { return sprite.SaveBN(buffer, _errorMsg); }));
+        _results.push_back(TimeOperation(_name, "LoadBN", _iterations, bnData.size(), frames, nullptr,
+            [&](string& _errorMsg) { return work.LoadBN(bnData.data(), bnData.size(), _errorMsg); }));
+    }
+    if (hasSF)
+    {
+        _results.push_back(TimeOperation(_name, "SaveSF", _iterations, sfData.size(), frames, nullptr,
+            [&](string& _errorMsg) { return sprite.SaveSF(buffer, _errorMsg); }));
+        _results.push_back(TimeOperation(_name, "LoadSF", _iterations, sfData.size(), frames, nullptr,
+            [&](string& _errorMsg) { return work.LoadSF(sfData.data(), sfData.size(), _errorMsg); }));
+    }
+
+    if (hasBN && !sprite.Is256Color())
+    {
+        // Only time conversions that can succeed, the rest are reported as skipped
+        string convertErrorMsg;
+        if (sprite.CanConvertBNtoSF(convertErrorMsg))
+        {
+            _results.push_back(TimeOperation(_name, "ConvertBNtoSF", _iterations, bnData.size(), frames,
+                [&]() { string ignored; work.LoadBN(bnData.data(), bnData.size(), ignored); },
+                [&](string& _errorMsg) { bool modified = false; return work.ConvertBNtoSF(modified, _errorMsg); }));
+        }
+        else
+        {
+            BenchResult skipped;
+            skipped.m_sprite = _name;
+            skipped.m_operation = "ConvertBNtoSF";
+            skipped.m_errorMsg = "not SF compatible: " + convertErrorMsg;
+            _results.push_back(skipped);
+        }
+    }
+
+    if (sprite.GetAnimationCount() <= 127)
+    {
+        _results.push_back(TimeOperation(_name, "Merge", _iterations, bnData.size(), frames,
+            [&]() { work = sprite; },
+            [&](string& _errorMsg) { return work.Merge(sprite, _errorMsg); }));
+    }
+
+    // Build the same sprite again through the editing API, like the custom sprite manager does.
+    // Inputs are copied in the untimed setup so the run can hand them over
+    vector<vector<BNSprite::Frame>> animations(sprite.GetAnimationCount());
+    for (int i = 0; i < sprite.GetAnimationCount(); i++)
+    {
+        sprite.GetAnimationFrames(i, animations[i]);
+    }
+
+    vector<vector<uint8_t>> tilesets(sprite.GetTilesetCount());
+    for (int i = 0; i < sprite.GetTilesetCount(); i++)
+    {
+        vector<uint8_t> pixels;
+        sprite.GetTilesetPixels(i, pixels);
+        if (sprite.Is256Color())
+        {
+            tilesets[i] = pixels;
+            continue;
+        }
+
+        tilesets[i].resize(pixels.size() / 2);
+        for (size_t j = 0; j < tilesets[i].size(); j++)
+        {
+            tilesets[i][j] = pixels[j * 2] | (pixels[j * 2 + 1] << 4);
+        }
+    }
+
+    vector<BNSprite::PaletteGroup> paletteGroups;
+    sprite.GetAllPaletteGroups(paletteGroups);
+
+    vector<vector<uint8_t>> pendingTilesets;
+    vector<BNSprite::PaletteGroup> pendingPaletteGroups;
+    _results.push_back(TimeOperation(_name, "Build", _iterations, tilesetBytes, frames,
+        [&]()
+        {
+            work.Clear();
+            pendingTilesets = tilesets;
+            pendingPaletteGroups = paletteGroups;
+        },
+        [&](string&)
+        {
+            work.Set256Color(sprite.Is256Color());
+            for (vector<uint8_t>& tileset : pendingTilesets)
+            {
+                work.ImportCustomTileset(move(tileset));
+            }
+            work.ReplaceAllPaletteGroups(move(pendingPaletteGroups));
+
+            for (size_t i = 0; i < animations.size(); i++)
+            {
+                int const animID = work.NewAnimation();
+                for (size_t j = 0; j < animations[i].size(); j++)
+                {
+                    if (j > 0)
+                    {
+                        work.NewFrame(animID);
+                    }
+                    work.ReplaceFrame(animID, j, animations[i][j]);
+                }
+                work.SetAnimationLoop(animID, sprite.GetAnimationLoop(i));
+            }
+            return true;
+        }));
+
+    vector<uint8_t> pixels;
+    _results.push_back(TimeOperation(_name, "GetTilesetPixels", _iterations, tilesetBytes, 0.0, nullptr,
+        [&](string&)
+        {
+            for (int i = 0; i < sprite.GetTilesetCount(); i++)
+            {
+                sprite.GetTilesetPixels(i, pixels);
+            }
+            return true;
+        }));
+}
+
+//-----------------------------------------------------
+// Benchmark the sprite core
+//-----------------------------------------------------
+static int RunBench
+(
+    CliOptions const& _options
+)
+{
+    vector<BenchResult> results;
+
+    // Fixed shape that is valid as both BN and SF so every operation can run
+    BNSpriteGenerator::Options generator;
+    generator.m_sfCompatible = true;
+    generator.m_animationCount = 64;
+    generator.m_frameCount = 16;
+    generator.m_uniqueFrameCount = 255;
+    generator.m_subObjectCount = 8;
+    generator.m_tilesetCount = 32;
+
+    BNSprite synthetic;
+    string errorMsg;
+    if (!BNSpriteGenerator::Generate(generator, synthetic, errorMsg))
+    {
+        printf("FAIL synthetic: %s\n", errorMsg.c_str());
+        return 1;
+    }
+    BenchSprite("synthetic", synthetic, _options.m_iterations, results);
+
+    for (string const& arg : _options.m_args)
+    {
+        BNSprite fixture;
+        if (!LoadSprite(fixture, arg, _options.m_from, errorMsg))
+        {
+            printf("FAIL %s: %s\n", arg.c_str(), errorMsg.c_str());
+            return 1;
+        }
+        BenchSprite(arg, fixture, _options.m_iterations, results);
+    }
+
+    bool const countAllocations = AllocationCounter::IsEnabled();
+    printf("%-24s %-18s %12s %12s %14s", "Sprite", "Operation", "ms", "MB/s", "frames/s");
+    printf(countAllocations ? " %10s %12s\n" : "\n", "allocs", "alloc KB");
+    for (BenchResult const& result : results)
+    {
+        string const sprite = fs::path(result.m_sprite).filename().string();
+        if (result.m_iterations == 0)
+        {
+            printf("%-24s %-18s skipped: %s\n", sprite.c_str(), result.m_operation.c_str(), result.m_errorMsg.c_str());
+            continue;
+        }
+
+        double const seconds = max(result.m_seconds, 1e-9);
+        printf("%-24s %-18s %12.3f %12.1f %14.0f", sprite.c_str(), result.m_operation.c_str(),
+               seconds * 1000.0, result.m_bytes / seconds / (1024.0 * 1024.0), result.m_frames / seconds);
+        if (countAllocations)
+        {
+            printf(" %10llu %12.1f", static_cast<unsigned long long>(result.m_allocations), result.m_allocatedBytes / 1024.0);
+        }
+        printf("\n");
+    }
+
+    if (!_options.m_json.empty())
+    {
+        FILE* f = fopen(_options.m_json.c_str(), "w");
+        if (!f)
+        {
+            printf("FAIL %s: Unable to open file!\n", _options.m_json.c_str());
+            return 1;
+        }
+
+        fprintf(f, "{\n  \"results\": [");
+        bool first = true;
+        for (BenchResult const& result : results)
+        {
+            if (result.m_iterations == 0) continue;
+
+            double const seconds = max(result.m_seconds, 1e-9);
+            fprintf(f, "%s\n    {\"sprite\": \"%s\", \"operation\": \"%s\", \"iterations\": %d, "
+                       "\"seconds\": %.9f, \"mb_per_s\": %.3f, \"frames_per_s\": %.1f",
+                    first ? "" : ",", EscapeJson(result.m_sprite).c_str(), result.m_operation.c_str(), result.m_iterations,
+                    seconds, result.m_bytes / seconds / (1024.0 * 1024.0), result.m_frames / seconds);
+            if (countAllocations)
+            {
+                fprintf(f, ", \"allocations\": %llu, \"allocated_bytes\": %llu",
+                        static_cast<unsigned long long>(result.m_allocations), static_cast<unsigned long long>(result.m_allocatedBytes));
+            }
+            fprintf(f, "}");
+            first = false;
+        }
+        fprintf(f, "\n  ]\n}\n");
+        fclose(f);
+    }
+
+    return 0;
+}
+
+//-----------------------------------------------------
+// Generate a synthetic sprite and save it
+//-----------------------------------------------------
+static int RunGenerate
+(
+    CliOptions const& _options
+)
+{
+    if (_options.m_args.size() != 1)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    // SF output needs a sprite SF can store directly
+    BNSpriteGenerator::Options generator = _options.m_generator;
+    generator.m_sfCompatible = _options.m_to == SpriteFormat::SF;
+
+    BNSprite sprite;
+    string errorMsg;
+    fs::path const output = _options.m_args[0];
+    if (!BNSpriteGenerator::Generate(generator, sprite, errorMsg)
+     || !SaveSprite(sprite, output, _options.m_to, _options.m_to, errorMsg))
+    {
+        printf("FAIL %s: %s\n", output.string().c_str(), errorMsg.c_str());
+        return 1;
+    }
+
+    printf("OK   %s\n", output.string().c_str());
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    CliOptions options;
+    if (argc < 2 || !ParseOptions(argc, argv, options))
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    // BNSprite reports loading progress on cout, only keep it when asked
+    if (!options.m_verbose)
+    {
+        std::cout.setstate(ios::badbit);
+    }
+
+    string const command = argv[1];
+    if (command == "convert")
+    {
+        return RunConvert(options);
+    }
+    if (command == "merge")
+    {
+        return RunMerge(options);
+    }
+    if (command == "scan")
+    {
+        return RunScan(options);
+    }
+    if (command == "stats")
+    {
+        return RunStats(options);
+    }
+    if (command == "bench")
+    {
+        return RunBench(options);
+    }
+    if (command == "generate")
+    {
+        return RunGenerate(options);
+    }
+    if (command == "roundtrip")
+    {
+        return RunRoundTrip(options);
+    }
+
+    PrintUsage();
+    return 1;
+}
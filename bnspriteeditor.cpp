@@ -1,6 +1,8 @@
 #include "bnspriteeditor.h"
 #include "ui_bnspriteeditor.h"
 
+#include <QtConcurrent>
+
 #define IMPORT_EXTENSIONS "BN Sprite (*.bnsa *.bnsprite *.dmp);;All files (*.*)"
 #define IMPORT_EXTENSIONS_SF "SF Sprite (*.sfsa *.sfsprite *.bin);;All files (*.*)"
 #define EXPORT_EXTENSIONS "Memory Dump (*.dmp);;BN Sprite (*.bnsa *.bnsprite);;All files (*.*)"
@@ -8,6 +10,7 @@
 #define PALETTE_EXTENSIONS "Palette File (*.pal);;All files (*.*)"
 
 static const QString c_programVersion = "v0.4.0";
+static const int c_thumbnailPrefetchRows = 4;
 
 //---------------------------------------------------------------------------
 // Constructor
@@ -31,6 +34,7 @@ BNSpriteEditor::BNSpriteEditor(QWidget *parent)
 
     m_copyAnim = -1;
     m_copyFrame = -1;
+    m_historyPending = false;
 
     m_tilesetImage = Q_NULLPTR;
     m_tilesetGraphic = new QGraphicsScene(this);
@@ -74,6 +78,16 @@ BNSpriteEditor::BNSpriteEditor(QWidget *parent)
     m_subAnimationTimer->setSingleShot(true);
     connect(m_subAnimationTimer, SIGNAL(timeout()), SLOT(on_SubFrame_Play_timeout()));
 
+    // Thumbnails are rendered after the lists are painted, for the rows they showed
+    m_thumbnailTicket = 0;
+    m_thumbnailTimer = new QTimer(this);
+    m_thumbnailTimer->setSingleShot(true);
+    m_thumbnailTimer->setInterval(0);
+    connect(m_thumbnailTimer, SIGNAL(timeout()), SLOT(on_Thumbnail_timeout()));
+    connect(&m_thumbnailWatcher, SIGNAL(resultReadyAt(int)), SLOT(on_Thumbnail_resultReadyAt(int)));
+    ui->Anim_LW->viewport()->installEventFilter(this);
+    ui->Frame_LW->viewport()->installEventFilter(this);
+
     connect(ui->Preview_GV, SIGNAL(previewScreenPressed(QPoint)), this, SLOT(on_Preview_pressed(QPoint)));
     connect(ui->Palette_GV, SIGNAL(colorChanged(int,int,QRgb)), this, SLOT(on_Palette_Color_changed(int,int,QRgb)));
     ui->Palette_Warning->setHidden(true);
@@ -98,6 +112,8 @@ BNSpriteEditor::BNSpriteEditor(QWidget *parent)
 //---------------------------------------------------------------------------
 BNSpriteEditor::~BNSpriteEditor()
 {
+    StopThumbnailRendering();
+
     m_settings->setValue("DefaultDirectory", m_path);
     m_settings->setValue("SimpleMode", m_simpleMode);
 
@@ -110,18 +126,6 @@ BNSpriteEditor::~BNSpriteEditor()
         delete m_oamImage;
     }
 
-    for (QImage* image : m_animThumbnails)
-    {
-        delete image;
-    }
-    m_animThumbnails.clear();
-
-    for (QImage* image : m_frameThumbnails)
-    {
-        delete image;
-    }
-    m_frameThumbnails.clear();
-
     delete ui;
 }
 
@@ -130,6 +134,13 @@ BNSpriteEditor::~BNSpriteEditor()
 //---------------------------------------------------------------------------
 bool BNSpriteEditor::eventFilter(QObject *object, QEvent *event)
 {
+    // Scrolled, resized or items changed, see if any thumbnails are missing
+    if (event->type() == QEvent::Paint && (object == ui->Anim_LW->viewport() || object == ui->Frame_LW->viewport()))
+    {
+        m_thumbnailTimer->start();
+        return false;
+    }
+
     // Changing a color of a color block
     if (event->type() == QEvent::FocusIn)
     {
@@ -313,6 +324,7 @@ void BNSpriteEditor::ImportSprite(QString const& file, bool isSFSprite, bool sho
     else
     {
         LoadSpriteToUI();
+        ResetHistory();
         if (showSuccess)
         {
             QMessageBox::information(this, "Open", "File load successful!", QMessageBox::Ok);
@@ -342,7 +354,6 @@ void BNSpriteEditor::LoadSpriteToUI()
     for (int i = 0; i < animationCount; i++)
     {
         AddAnimationThumbnail(i);
-        qApp->processEvents();
     }
 
     // Enable buttons
@@ -386,17 +397,9 @@ void BNSpriteEditor::ExportSprite(bool isSFSprite)
     // Overwrite palette
     ReplacePaletteInSprite();
 
-    // Save sprite file
+    // Save sprite file, exporting to the same file again only writes what changed
     string errorMsg;
-    bool success = false;
-    if (isSFSprite)
-    {
-        success = m_sprite.SaveSF(file.toStdWString(), errorMsg);
-    }
-    else
-    {
-        success = m_sprite.SaveBN(file.toStdWString(), errorMsg);
-    }
+    bool success = m_sprite.SaveIncremental(file.toStdWString(), isSFSprite, errorMsg);
 
     if (!success)
     {
@@ -411,23 +414,26 @@ void BNSpriteEditor::ExportSprite(bool isSFSprite)
 void BNSpriteEditor::ReplacePaletteInSprite()
 {
     vector<BNSprite::PaletteGroup> paletteGroups;
+    paletteGroups.reserve(m_paletteGroups.size());
     for (PaletteGroup const& group : m_paletteGroups)
     {
         BNSprite::PaletteGroup groupCopy;
+        groupCopy.m_palettes.reserve(group.size());
         for (Palette const& pal : group)
         {
             BNSprite::Palette palCopy;
+            palCopy.m_colors.reserve(pal.size());
             for (uint32_t i = 0; i < pal.size(); i++)
             {
                 uint32_t const& rgb = pal[i];
                 uint16_t col = BNSprite::RGBtoGBA(rgb);
                 palCopy.m_colors.push_back(col);
             }
-            groupCopy.m_palettes.push_back(palCopy);
+            groupCopy.m_palettes.push_back(std::move(palCopy));
         }
-        paletteGroups.push_back(groupCopy);
+        paletteGroups.push_back(std::move(groupCopy));
     }
-    m_sprite.ReplaceAllPaletteGroups(paletteGroups);
+    m_sprite.ReplaceAllPaletteGroups(std::move(paletteGroups));
 }
 
 void BNSpriteEditor::on_actionClose_triggered()
@@ -510,80 +516,94 @@ void BNSpriteEditor::on_actionMerge_Sprite_triggered()
         path = m_path;
     }
 
-    QString file = QFileDialog::getOpenFileName(this, tr("Merga Sprite"), path, isSFSprite ? IMPORT_EXTENSIONS_SF : IMPORT_EXTENSIONS);
-    if (file == Q_NULLPTR) return;
+    QStringList files = QFileDialog::getOpenFileNames(this, tr("Merga Sprite"), path, isSFSprite ? IMPORT_EXTENSIONS_SF : IMPORT_EXTENSIONS);
+    if (files.isEmpty()) return;
 
     // Save directory
-    QFileInfo info(file);
+    QFileInfo info(files[0]);
     m_path = info.dir().absolutePath();
 
-    // Load sprite file
-    string errorMsg;
-    bool success = false;
-    if (isSFSprite)
+    // Load all sprite files at once
+    vector<BNSprite::LoadRequest> requests;
+    for (QString const& file : files)
     {
-        success = m_spriteMerge.LoadSF(file.toStdWString(), errorMsg);
+        BNSprite::LoadRequest request;
+        request.m_fileName = file.toStdWString();
+        request.m_sfFormat = isSFSprite;
+        requests.push_back(request);
     }
-    else
+    vector<BNSprite> sprites;
+    vector<BNSprite::LoadResult> results;
+    BNSprite::LoadMultiple(requests, sprites, results);
+
+    // Merge in the selected order up to the first file that failed to load
+    string errorMsg;
+    vector<BNSprite const*> others;
+    for (size_t i = 0; i < sprites.size() && results[i].m_success; i++)
     {
-        success = m_spriteMerge.LoadBN(file.toStdWString(), errorMsg);
+        others.push_back(&sprites[i]);
     }
 
-    if (!success)
+    uint32_t mergeCount = 0;
+    int const animationCount = m_sprite.GetAnimationCount();
+    if (m_sprite.Merge(others, mergeCount, errorMsg) && mergeCount < sprites.size())
     {
-        QMessageBox::critical(this, "Error", QString::fromStdString(errorMsg), QMessageBox::Ok);
+        errorMsg = results[mergeCount].m_errorMsg;
     }
-    else
+
+    if (mergeCount < sprites.size() && files.size() > 1)
     {
-        // Loaded 2nd sprite, attempt to merge
-        int const animationCount = m_sprite.GetAnimationCount();
-        if (m_sprite.Merge(m_spriteMerge, errorMsg))
-        {
-            // Import additional palettes
-            if (m_sprite.Is256Color())
-            {
-                // 256 color append to current group (just reload it)
-                m_paletteGroups.clear();
-                vector<BNSprite::PaletteGroup> paletteGroups;
-                m_sprite.GetAllPaletteGroups(paletteGroups);
-                AddPaletteGroupFromSprite(paletteGroups[0]);
-
-                // Set new palette group/index limit
-                int group = ui->Palette_SB_Group->value();
-                ui->Palette_SB_Index->setMaximum(m_paletteGroups[group].size() - 1);
-            }
-            else
-            {
-                // 16 color append new groups
-                int const paletteGroupCount = m_paletteGroups.size();
-                vector<BNSprite::PaletteGroup> paletteGroups;
-                m_sprite.GetAllPaletteGroups(paletteGroups);
-                for (int i = paletteGroupCount; i < paletteGroups.size(); i++)
-                {
-                    AddPaletteGroupFromSprite(paletteGroups[i]);
-                }
+        errorMsg = QFileInfo(files[mergeCount]).fileName().toStdString() + ": " + errorMsg;
+    }
 
-                // Set new palette group limit
-                ui->Palette_SB_Group->setMaximum(m_paletteGroups.size() - 1);
-            }
+    if (mergeCount > 0)
+    {
+        RecordHistory();
 
-            // Generate additional thumbnails
-            int const animationCountNew = m_sprite.GetAnimationCount();
-            for (int i = animationCount; i < animationCountNew; i++)
+        // Import additional palettes
+        if (m_sprite.Is256Color())
+        {
+            // 256 color append to current group (just reload it)
+            m_paletteGroups.clear();
+            vector<BNSprite::PaletteGroup> paletteGroups;
+            m_sprite.GetAllPaletteGroups(paletteGroups);
+            AddPaletteGroupFromSprite(paletteGroups[0]);
+
+            // Set new palette group/index limit
+            int group = ui->Palette_SB_Group->value();
+            ui->Palette_SB_Index->setMaximum(m_paletteGroups[group].size() - 1);
+        }
+        else
+        {
+            // 16 color append new groups
+            int const paletteGroupCount = m_paletteGroups.size();
+            vector<BNSprite::PaletteGroup> paletteGroups;
+            m_sprite.GetAllPaletteGroups(paletteGroups);
+            for (int i = paletteGroupCount; i < paletteGroups.size(); i++)
             {
-                AddAnimationThumbnail(i);
-                qApp->processEvents();
+                AddPaletteGroupFromSprite(paletteGroups[i]);
             }
 
-            QMessageBox::information(this, "Merge", "Sprite merge completed!", QMessageBox::Ok);
+            // Set new palette group limit
+            ui->Palette_SB_Group->setMaximum(m_paletteGroups.size() - 1);
         }
-        else
+
+        // Generate additional thumbnails
+        int const animationCountNew = m_sprite.GetAnimationCount();
+        for (int i = animationCount; i < animationCountNew; i++)
         {
-            QMessageBox::critical(this, "Error", QString::fromStdString(errorMsg), QMessageBox::Ok);
+            AddAnimationThumbnail(i);
         }
     }
 
-    m_spriteMerge.Clear();
+    if (mergeCount < sprites.size())
+    {
+        QMessageBox::critical(this, "Error", QString::fromStdString(errorMsg), QMessageBox::Ok);
+    }
+    else
+    {
+        QMessageBox::information(this, "Merge", "Sprite merge completed!", QMessageBox::Ok);
+    }
 }
 
 void BNSpriteEditor::on_actionExport_Sprite_as_Single_PNG_triggered()
@@ -615,8 +635,7 @@ void BNSpriteEditor::on_actionExport_Sprite_as_Single_PNG_triggered()
     QSize imageSize(0,0);
     for (int i = 0; i < ui->Anim_LW->count(); i++)
     {
-        vector<BNSprite::Frame> frames;
-        m_sprite.GetAnimationFrames(i, frames);
+        int const frameCount = m_sprite.GetAnimationFrameCount(i);
 
         int minX = -1;
         int maxX = 0;
@@ -624,15 +643,15 @@ void BNSpriteEditor::on_actionExport_Sprite_as_Single_PNG_triggered()
         int maxY = 0;
 
         // Get minimum size that fits all frames in each animation
-        for (BNSprite::Frame const& frame : frames)
+        for (int j = 0; j < frameCount; j++)
         {
-            BNSprite::Object const& object = frame.m_objects[0];
-            for (BNSprite::SubObject const& subObject : object.m_subObjects)
+            BNSprite::ObjectView const object = m_sprite.GetAnimationFrameView(i, j).GetObject(0);
+            for (BNSprite::SubObject const& subObject : object.GetSubObjects())
             {
                 minX = qMin(minX, (int)subObject.m_posX);
                 minY = qMin(minY, (int)subObject.m_posY);
-                maxX = qMax(maxX, subObject.m_posX + subObject.m_sizeX - 1);
-                maxY = qMax(maxY, subObject.m_posY + subObject.m_sizeY - 1);
+                maxX = qMax(maxX, subObject.m_posX + subObject.GetSizeX() - 1);
+                maxY = qMax(maxY, subObject.m_posY + subObject.GetSizeY() - 1);
             }
         }
 
@@ -640,7 +659,7 @@ void BNSpriteEditor::on_actionExport_Sprite_as_Single_PNG_triggered()
 
         // Add new animation height, get max width
         imageSize.rheight() += animSize.height();
-        imageSize.setWidth(qMax(imageSize.width(), animSize.width() * (int)frames.size()));
+        imageSize.setWidth(qMax(imageSize.width(), animSize.width() * frameCount));
 
         animSizes.push_back(animSize);
         animMins.push_back(QPoint(minX - borderSize, minY - borderSize));
@@ -657,12 +676,9 @@ void BNSpriteEditor::on_actionExport_Sprite_as_Single_PNG_triggered()
         QSize const& animSize = animSizes[i];
         QPoint const& animMin = animMins[i];
 
-        vector<BNSprite::Frame> frames;
-        m_sprite.GetAnimationFrames(i, frames);
-
-        for (int j = 0; j < frames.size(); j++)
+        for (int j = 0; j < m_sprite.GetAnimationFrameCount(i); j++)
         {
-            BNSprite::Frame const& frame = frames[j];
+            BNSprite::FrameView const frame = m_sprite.GetAnimationFrameView(i, j);
             QImage image(animSize, QImage::Format_Indexed8);
             UpdateFrameImage(frame, &image, animMin.x(), animMin.y());
             painter.drawImage(animSize.width() * j, currentY, image);
@@ -710,8 +726,7 @@ void BNSpriteEditor::on_actionExport_Sprite_as_Individual_PNG_triggered()
     int frameCount = 0;
     for (int i = 0; i < ui->Anim_LW->count(); i++)
     {
-        vector<BNSprite::Frame> frames;
-        m_sprite.GetAnimationFrames(i, frames);
+        int const animFrameCount = m_sprite.GetAnimationFrameCount(i);
 
         int minX = 127;
         int maxX = -128;
@@ -719,24 +734,24 @@ void BNSpriteEditor::on_actionExport_Sprite_as_Individual_PNG_triggered()
         int maxY = -128;
 
         // Get minimum size that fits all frames in each animation
-        for (BNSprite::Frame const& frame : frames)
+        for (int j = 0; j < animFrameCount; j++)
         {
-            BNSprite::Object const& object = frame.m_objects[0];
-            for (BNSprite::SubObject const& subObject : object.m_subObjects)
+            BNSprite::ObjectView const object = m_sprite.GetAnimationFrameView(i, j).GetObject(0);
+            for (BNSprite::SubObject const& subObject : object.GetSubObjects())
             {
                 minX = qMin(minX, (int)subObject.m_posX);
                 minY = qMin(minY, (int)subObject.m_posY);
-                maxX = qMax(maxX, subObject.m_posX + subObject.m_sizeX - 1);
-                maxY = qMax(maxY, subObject.m_posY + subObject.m_sizeY - 1);
+                maxX = qMax(maxX, subObject.m_posX + subObject.GetSizeX() - 1);
+                maxY = qMax(maxY, subObject.m_posY + subObject.GetSizeY() - 1);
             }
         }
 
         // Draw and export export each frame with the same size
-        for (int j = 0; j < frames.size(); j++)
+        for (int j = 0; j < animFrameCount; j++)
         {
             frameCount++;
 
-            BNSprite::Frame const& frame = frames[j];
+            BNSprite::FrameView const frame = m_sprite.GetAnimationFrameView(i, j);
             QImage image(maxX - minX + 1, maxY - minY + 1, QImage::Format_Indexed8);
             UpdateFrameImage(frame, &image, minX, minY);
 
@@ -841,6 +856,7 @@ void BNSpriteEditor::on_actionConvert_Sprite_to_be_Compatible_with_SF_triggered(
         {
             ResetProgram(false);
             LoadSpriteToUI();
+            RecordHistory();
             QMessageBox::information(this, "Convert to SF", "Conversion completed!", QMessageBox::Ok);
         }
         else
@@ -854,6 +870,171 @@ void BNSpriteEditor::on_actionConvert_Sprite_to_be_Compatible_with_SF_triggered(
     }
 }
 
+void BNSpriteEditor::on_actionRemove_Duplicate_Tiles_triggered()
+{
+    if (!m_sprite.IsLoaded())
+    {
+        return;
+    }
+
+    if (IsCustomSpriteMakerActive())
+    {
+        QMessageBox::critical(this, "Error", "You should not use this while making custom sprites.", QMessageBox::Ok);
+        return;
+    }
+
+    QMessageBox::StandardButton resBtn = QMessageBox::Yes;
+    QString message = "Remove duplicate tiles from all tilesets?";
+    message += "\n*OAMs using the same tiles, or the same tiles flipped, will share them";
+    message += "\n*Tiles not used by any OAM are kept";
+    resBtn = QMessageBox::information(this, "Remove Duplicate Tiles", message, QMessageBox::Yes | QMessageBox::No, QMessageBox::Yes);
+    if (resBtn == QMessageBox::No)
+    {
+        return;
+    }
+
+    // Need to update palette in m_sprite first
+    ReplacePaletteInSprite();
+
+    uint32_t bytesSaved = m_sprite.RemoveDuplicateTiles();
+    ResetProgram(false);
+    LoadSpriteToUI();
+    RecordHistory();
+
+    if (bytesSaved > 0)
+    {
+        QMessageBox::information(this, "Remove Duplicate Tiles", "Saved " + QString::number(bytesSaved) + " bytes of tileset data.", QMessageBox::Ok);
+    }
+    else
+    {
+        QMessageBox::information(this, "Remove Duplicate Tiles", "No duplicate tiles found.", QMessageBox::Ok);
+    }
+}
+
+void BNSpriteEditor::on_actionSprite_Statistics_triggered()
+{
+    if (!m_sprite.IsLoaded())
+    {
+        return;
+    }
+
+    BNSprite::Statistics stats;
+    m_sprite.GetStatistics(stats);
+
+    uint32_t tileCount = 0;
+    for (uint32_t tiles : stats.m_tilesPerTileset)
+    {
+        tileCount += tiles;
+    }
+
+    QString message = "Animations: " + QString::number(stats.m_framesPerAnimation.size());
+    message += "\nFrames: " + QString::number(stats.m_frameCount);
+    message += "\nObjects: " + QString::number(stats.m_objectCount);
+    message += "\nOAMs: " + QString::number(stats.m_oamCount) + " (max " + QString::number(qMax(0, (int)stats.m_oamsPerObject.size() - 1)) + " per object)";
+    message += "\nTilesets: " + QString::number(stats.m_tilesPerTileset.size()) + " with " + QString::number(tileCount) + " tiles";
+    message += " (" + QString::number(stats.m_sharedTilesets) + " shared, " + QString::number(stats.m_uniqueTilesets) + " used once)";
+    message += "\nPalette groups: " + QString::number(stats.m_paletteGroupReferences.size());
+    message += " (" + QString::number(stats.m_sharedPaletteGroups) + " shared, " + QString::number(stats.m_uniquePaletteGroups) + " used once)";
+    message += "\n\nBN file size: " + (stats.m_bnSize > 0 ? QString::number(stats.m_bnSize) + " bytes" : QString("not compatible"));
+    message += "\nSF file size: " + (stats.m_sfSize > 0 ? QString::number(stats.m_sfSize) + " bytes" : QString("not compatible"));
+    message += "\nMemory used: " + QString::number((stats.m_heapBytes + stats.m_sharedHeapBytes) / 1024.0, 'f', 1) + " KB";
+    message += "\n\nFrame image cache: " + QString::number(m_frameImages.GetImageCount()) + " images, ";
+    message += QString::number(m_frameImages.GetHitCount()) + " hits, " + QString::number(m_frameImages.GetMissCount()) + " misses";
+    message += " (" + QString::number(m_frameImages.GetHitRate() * 100.0, 'f', 1) + "% hit rate)";
+    QMessageBox::information(this, "Sprite Statistics", message, QMessageBox::Ok);
+}
+
+void BNSpriteEditor::on_actionUndo_triggered()
+{
+    RestoreFromHistory(false);
+}
+
+void BNSpriteEditor::on_actionRedo_triggered()
+{
+    RestoreFromHistory(true);
+}
+
+//---------------------------------------------------------------------------
+// Undo/redo history
+//---------------------------------------------------------------------------
+void BNSpriteEditor::RecordHistory()
+{
+    // Edits made within the same event become one step
+    if (m_historyPending) return;
+
+    m_historyPending = true;
+    QTimer::singleShot(0, this, SLOT(CommitHistory()));
+}
+
+void BNSpriteEditor::CommitHistory()
+{
+    if (!m_historyPending) return;
+    m_historyPending = false;
+
+    if (!m_sprite.IsLoaded()) return;
+
+    // Palettes are only written to sprite on demand
+    ReplacePaletteInSprite();
+    m_history.Commit(m_sprite);
+    UpdateHistoryActions();
+}
+
+void BNSpriteEditor::ResetHistory()
+{
+    m_historyPending = false;
+    if (m_sprite.IsLoaded())
+    {
+        ReplacePaletteInSprite();
+        m_history.Reset(m_sprite);
+    }
+    else
+    {
+        m_history.Clear();
+    }
+    UpdateHistoryActions();
+}
+
+void BNSpriteEditor::RestoreFromHistory(bool _redo)
+{
+    if (!m_sprite.IsLoaded()) return;
+
+    if (IsCustomSpriteMakerActive())
+    {
+        QMessageBox::critical(this, "Error", "Undo/redo is not allowed while Custom Sprite Manager editing is active.", QMessageBox::Ok);
+        return;
+    }
+
+    // Make sure the latest edit is a step we can come back to
+    CommitHistory();
+
+    int animID = ui->Anim_LW->currentRow();
+    int frameID = ui->Frame_LW->currentRow();
+
+    bool restored = _redo ? m_history.Redo(m_sprite) : m_history.Undo(m_sprite);
+    if (!restored) return;
+
+    ResetProgram(false);
+    LoadSpriteToUI();
+
+    // Go back to where we were if it still exists
+    if (animID >= 0 && ui->Anim_LW->count() > 0)
+    {
+        ui->Anim_LW->setCurrentRow(qMin(animID, ui->Anim_LW->count() - 1));
+        if (frameID >= 0 && ui->Frame_LW->count() > 0)
+        {
+            ui->Frame_LW->setCurrentRow(qMin(frameID, ui->Frame_LW->count() - 1));
+        }
+    }
+
+    UpdateHistoryActions();
+}
+
+void BNSpriteEditor::UpdateHistoryActions()
+{
+    ui->actionUndo->setEnabled(m_history.CanUndo());
+    ui->actionRedo->setEnabled(m_history.CanRedo());
+}
+
 //---------------------------------------------------------------------------
 // Resetting all buttons and data
 //---------------------------------------------------------------------------
@@ -886,16 +1067,18 @@ void BNSpriteEditor::ResetProgram(bool clearSprite)
         this->setWindowTitle(m_applicationName);
         m_spriteName = "";
         m_sprite.Clear();
+        m_tileAtlas.Clear();
+        m_frameImages.Clear();
+
+        m_historyPending = false;
+        m_history.Clear();
+        UpdateHistoryActions();
     }
 }
 
 void BNSpriteEditor::ResetAnim()
 {
-    for (QImage* image : m_animThumbnails)
-    {
-        delete image;
-    }
-    m_animThumbnails.clear();
+    StopThumbnailRendering();
     ui->Anim_LW->verticalScrollBar()->triggerAction(QScrollBar::SliderToMinimum);
     ui->Anim_LW->clear();
 
@@ -910,11 +1093,6 @@ void BNSpriteEditor::ResetFrame()
 {
     ui->Palette_GV->clear();
 
-    for (QImage* image : m_frameThumbnails)
-    {
-        delete image;
-    }
-    m_frameThumbnails.clear();
     ui->Frame_LW->horizontalScrollBar()->triggerAction(QScrollBar::SliderToMinimum);
     ui->Frame_LW->clear();
 
@@ -967,7 +1145,7 @@ void BNSpriteEditor::ResetOthers()
 
     m_tilesetGraphic->clear();
     m_tilesetGraphic->setSceneRect(0, 0, 0, 0);
-    m_tilesetData.clear();
+    m_tilesetData.reset();
     ui->Tileset_Label->setText("Total No. of tiles: ---");
     ui->Tileset_SB_Index->setEnabled(false);
     ui->Tileset_PB_Import->setEnabled(false);
@@ -1045,112 +1223,444 @@ QImage *BNSpriteEditor::GetFrameImage(const BNSprite::Frame &_frame, bool _isThu
 
     if (_isThumbnail)
     {
-        minX = 127;
-        maxX = -128;
-        minY = 127;
-        maxY = -128;
-
-        // Go through all objects to get minimum image size
         uint8_t objectIndex = _frame.m_subAnimations[_subAnimID].m_subFrames[_subFrameID].m_objectIndex;
         BNSprite::Object const& object = _frame.m_objects[objectIndex];
-        for (BNSprite::SubObject const& subObject : object.m_subObjects)
-        {
-            minX = qMin(minX, (int)subObject.m_posX);
-            minY = qMin(minY, (int)subObject.m_posY);
-            maxX = qMax(maxX, subObject.m_posX + subObject.m_sizeX - 1);
-            maxY = qMax(maxY, subObject.m_posY + subObject.m_sizeY - 1);
-        }
+        QRect const rect = GetThumbnailRect(object.m_subObjects, ui->Anim_LW->iconSize().width());
 
-        width = maxX - minX + 1;
-        height = maxY - minY + 1;
-
-        // Make this a square image, if larger than icon size, scale it down
-        int longerSide = qMax(width, height);
-        int iconSize = ui->Anim_LW->iconSize().width();
-        if (longerSide <= iconSize)
-        {
-            minX = minX - (iconSize - width) / 2;
-            minY = minY - (iconSize - height) / 2;
-        }
-        else
-        {
-            minX = minX - (longerSide - width) / 2;
-            minY = minY - (longerSide - height) / 2;
-        }
-
-        width = qMax(longerSide, iconSize);
-        height = qMax(longerSide, iconSize);
+        minX = rect.x();
+        minY = rect.y();
+        width = rect.width();
+        height = rect.height();
     }
 
-    // Initialize image
-    QImage* image = new QImage(width, height, QImage::Format_Indexed8);
+    // Initialize image, drawn from the tile atlas so it doesn't need converting for the icon
+    QImage* image = new QImage(width, height, QImage::Format_ARGB32_Premultiplied);
     UpdateFrameImage(_frame, image, minX, minY, _subAnimID, _subFrameID);
     return image;
 }
 
+//---------------------------------------------------------------------------
+// Square area around all OAMs, at least the icon size
+//---------------------------------------------------------------------------
+QRect BNSpriteEditor::GetThumbnailRect(BNSprite::ArrayView<BNSprite::SubObject> _subObjects, int _iconSize)
+{
+    int minX = 127;
+    int maxX = -128;
+    int minY = 127;
+    int maxY = -128;
+
+    // Go through all objects to get minimum image size
+    for (BNSprite::SubObject const& subObject : _subObjects)
+    {
+        minX = qMin(minX, (int)subObject.m_posX);
+        minY = qMin(minY, (int)subObject.m_posY);
+        maxX = qMax(maxX, subObject.m_posX + subObject.GetSizeX() - 1);
+        maxY = qMax(maxY, subObject.m_posY + subObject.GetSizeY() - 1);
+    }
+
+    int width = maxX - minX + 1;
+    int height = maxY - minY + 1;
+
+    // Make this a square image, if larger than icon size, scale it down
+    int longerSide = qMax(width, height);
+    if (longerSide <= _iconSize)
+    {
+        minX = minX - (_iconSize - width) / 2;
+        minY = minY - (_iconSize - height) / 2;
+    }
+    else
+    {
+        minX = minX - (longerSide - width) / 2;
+        minY = minY - (longerSide - height) / 2;
+    }
+
+    int const size = qMax(longerSide, _iconSize);
+    return QRect(minX, minY, size, size);
+}
+
 void BNSpriteEditor::UpdateFrameImage(const BNSprite::Frame &_frame, QImage *_image, int32_t _minX, int32_t _minY, int _subAnimID, int _subFrameID)
 {
     // Frame MUST have at least one sub animation with one sub frame
     uint8_t objectIndex = _frame.m_subAnimations[_subAnimID].m_subFrames[_subFrameID].m_objectIndex;
     BNSprite::Object const& object = _frame.m_objects[objectIndex];
-    int group = qMin((int)_frame.m_paletteGroupID, m_paletteGroups.size() - 1);
+    UpdateObjectImage(_frame.m_tilesetID, _frame.m_paletteGroupID, object.m_paletteIndex, object.m_subObjects, _image, _minX, _minY);
+}
+
+void BNSpriteEditor::UpdateFrameImage(const BNSprite::FrameView &_frame, QImage *_image, int32_t _minX, int32_t _minY, int _subAnimID, int _subFrameID)
+{
+    // Frame MUST have at least one sub animation with one sub frame
+    uint8_t objectIndex = _frame.GetSubAnimation(_subAnimID).GetSubFrames()[_subFrameID].m_objectIndex;
+    BNSprite::ObjectView const object = _frame.GetObject(objectIndex);
+    UpdateObjectImage(_frame.GetTilesetID(), _frame.GetPaletteGroupID(), object.GetPaletteIndex(), object.GetSubObjects(), _image, _minX, _minY);
+}
+
+void BNSpriteEditor::UpdateObjectImage(uint32_t _tilesetID, uint32_t _paletteGroupID, uint8_t _paletteIndex, BNSprite::ArrayView<BNSprite::SubObject> _subObjects, QImage *_image, int32_t _minX, int32_t _minY)
+{
+    int group = qMin((int)_paletteGroupID, m_paletteGroups.size() - 1);
     PaletteGroup const& paletteGroup = m_paletteGroups[group];
-    int index = qMin((int)object.m_paletteIndex, paletteGroup.size() - 1);
+    int index = qMin((int)_paletteIndex, paletteGroup.size() - 1);
     Palette const& palette = paletteGroup[index];
-    _image->setColorTable(palette);
+
+    // Identical frames, or the same frame drawn again, reuse the image
+    shared_ptr<vector<uint8_t> const> pixels = m_sprite.GetSharedTilesetPixels(_tilesetID);
+    QByteArray const key = FrameImageCache::MakeKey(_subObjects, _tilesetID, pixels.get(), palette, _image->size(), _image->format(), _minX, _minY);
+    if (m_frameImages.Find(key, *_image))
+    {
+        return;
+    }
+
     _image->fill(0);
 
-    // Draw image
-    vector<uint8_t> data;
-    m_sprite.GetTilesetPixels(_frame.m_tilesetID, data);
-    for (BNSprite::SubObject const& subObject : object.m_subObjects)
+    // ARGB images copy their tiles from the atlas of this tileset and palette
+    if (_image->format() != QImage::Format_Indexed8)
     {
-        DrawOAMInImage(subObject, _image, _minX, _minY, data, false);
+        int tileCount = 0;
+        QRgb const* atlas = m_tileAtlas.GetAtlas(m_sprite, _tilesetID, group, index, palette, tileCount);
+        for (BNSprite::SubObject const& subObject : _subObjects)
+        {
+            DrawOAMInImage(subObject, _image, _minX, _minY, atlas, tileCount);
+        }
     }
+    else
+    {
+        // Draw image, pixels are cached by the sprite so this doesn't unpack the tileset again
+        _image->setColorTable(palette);
+        vector<uint8_t> const& data = m_sprite.GetTilesetPixels(_tilesetID);
+        for (BNSprite::SubObject const& subObject : _subObjects)
+        {
+            DrawOAMInImage(subObject, _image, _minX, _minY, data, false);
+        }
+    }
+
+    m_frameImages.Insert(key, *_image, pixels);
 }
 
 void BNSpriteEditor::DrawOAMInImage(const BNSprite::SubObject &_subObject, QImage *_image, int32_t _minX, int32_t _minY, const vector<uint8_t> &_data, bool _drawFirstColor)
 {
-    int startTile = _subObject.m_startTile;
-    int tileXCount = _subObject.m_sizeX / 8;
-    int tileYCount = _subObject.m_sizeY / 8;
-    int xPos = _subObject.m_posX - _minX;
-    int yPos = _subObject.m_posY - _minY;
-    int pixelIndex = startTile * 64;
+    DrawTilesInImage(_subObject.m_startTile, _subObject.GetSizeX(), _subObject.GetSizeY(), _subObject.m_posX - _minX, _subObject.m_posY - _minY, _subObject.GetHFlip(), _subObject.GetVFlip(), _image, _data, _drawFirstColor);
+}
+
+void BNSpriteEditor::DrawOAMInImage(const BNSprite::SubObject &_subObject, QImage *_image, int32_t _minX, int32_t _minY, const QRgb *_atlas, int _tileCount)
+{
+    Q_ASSERT(_image->format() == QImage::Format_ARGB32_Premultiplied);
+    if (_atlas == Q_NULLPTR) return;
+
+    DrawTileRows(_subObject.m_startTile, _subObject.GetSizeX(), _subObject.GetSizeY(), _subObject.m_posX - _minX, _subObject.m_posY - _minY, _subObject.GetHFlip(), _subObject.GetVFlip(), _image, _atlas, _tileCount, false);
+}
+
+void BNSpriteEditor::DrawTilesInImage(int _startTile, int _sizeX, int _sizeY, int _xPos, int _yPos, bool _hFlip, bool _vFlip, QImage *_image, const vector<uint8_t> &_data, bool _drawFirstColor)
+{
+    Q_ASSERT(_image->format() == QImage::Format_Indexed8);
+    DrawTileRows(_startTile, _sizeX, _sizeY, _xPos, _yPos, _hFlip, _vFlip, _image, _data.data(), _data.size() / 64, _drawFirstColor);
+}
+
+//---------------------------------------------------------------------------
+// Draw a block of tiles, _tiles holds 64 pixels per tile in the image's format
+//---------------------------------------------------------------------------
+template <typename Pixel>
+void BNSpriteEditor::DrawTileRows(int _startTile, int _sizeX, int _sizeY, int _xPos, int _yPos, bool _hFlip, bool _vFlip, QImage *_image, const Pixel *_tiles, int _tileCount, bool _drawFirstColor)
+{
+    // Clip the whole block once instead of every pixel
+    int const clipX0 = qMax(0, -_xPos);
+    int const clipX1 = qMin(_sizeX, _image->width() - _xPos);
+    int const clipY0 = qMax(0, -_yPos);
+    int const clipY1 = qMin(_sizeY, _image->height() - _yPos);
+    if (clipX0 >= clipX1 || clipY0 >= clipY1)
+    {
+        return;
+    }
 
-    for (int tileY = 0; tileY < tileYCount; tileY++)
+    int const tileXCount = _sizeX / 8;
+    uchar* bits = _image->bits();
+    int const bytesPerLine = _image->bytesPerLine();
+    QVarLengthArray<Pixel, 64> row(_sizeX);
+
+    for (int y = clipY0; y < clipY1; y++)
     {
-        for (int tileX = 0; tileX < tileXCount; tileX++)
+        // Tiles past the end of the tileset are not drawn
+        int const srcY = _vFlip ? _sizeY - 1 - y : y;
+        int const firstTile = _startTile + (srcY / 8) * tileXCount;
+        int const validTiles = qBound(0, _tileCount - firstTile, tileXCount);
+        if (validTiles == 0)
+        {
+            continue;
+        }
+
+        // Gather the 8 pixel tile rows, reversed when flipped
+        Pixel const* src = _tiles + firstTile * 64 + (srcY % 8) * 8;
+        for (int tileX = 0; tileX < validTiles; tileX++)
         {
-            for (int y = tileY * 8; y < tileY * 8 + 8; y++)
+            Pixel const* tileRow = src + tileX * 64;
+            if (_hFlip)
             {
-                for (int x = tileX * 8; x < tileX * 8 + 8; x++)
+                Pixel* dst = row.data() + _sizeX - 8 - tileX * 8;
+                for (int i = 0; i < 8; i++)
                 {
-                    if (pixelIndex < _data.size())
-                    {
-                        uint8_t index = _data[pixelIndex];
-                        if (index != 0 || _drawFirstColor)
-                        {
-                            int drawX = _subObject.m_hFlip ? xPos + _subObject.m_sizeX - 1 - x : xPos + x;
-                            int drawY = _subObject.m_vFlip ? yPos + _subObject.m_sizeY - 1 - y : yPos + y;
-                            if (drawX >= 0 && drawX < _image->width() && drawY >= 0 && drawY < _image->height())
-                            {
-                                _image->setPixel(drawX, drawY, index);
-                            }
-                        }
-                        pixelIndex++;
-                    }
-                    else
-                    {
-                        return;
-                    }
+                    dst[i] = tileRow[7 - i];
+                }
+            }
+            else
+            {
+                memcpy(row.data() + tileX * 8, tileRow, 8 * sizeof(Pixel));
+            }
+        }
+
+        int const x0 = qMax(clipX0, _hFlip ? _sizeX - validTiles * 8 : 0);
+        int const x1 = qMin(clipX1, _hFlip ? _sizeX : validTiles * 8);
+        if (x0 >= x1)
+        {
+            continue;
+        }
+
+        Pixel* line = reinterpret_cast<Pixel*>(bits + (_yPos + y) * bytesPerLine) + _xPos;
+        if (_drawFirstColor)
+        {
+            memcpy(line + x0, row.data() + x0, (x1 - x0) * sizeof(Pixel));
+        }
+        else
+        {
+            CopyOpaquePixels(line + x0, row.data() + x0, x1 - x0);
+        }
+    }
+}
+
+//---------------------------------------------------------------------------
+// Copy pixels except color 0, 8 at a time with a byte mask so it
+// doesn't depend on the compiler or CPU having SIMD
+//---------------------------------------------------------------------------
+void BNSpriteEditor::CopyOpaquePixels(uchar *_dst, const uint8_t *_src, int _count)
+{
+    uint64_t const low7 = 0x7F7F7F7F7F7F7F7Full;
+
+    int i = 0;
+    for (; i + 8 <= _count; i += 8)
+    {
+        uint64_t src;
+        memcpy(&src, _src + i, 8);
+        if (src == 0) continue;
+
+        // High bit of every non-zero byte, spread to the whole byte
+        uint64_t const opaque = (((src & low7) + low7) | src) & ~low7;
+        uint64_t const mask = (opaque >> 7) * 0xFF;
+
+        uint64_t dst;
+        memcpy(&dst, _dst + i, 8);
+        dst = (dst & ~mask) | (src & mask);
+        memcpy(_dst + i, &dst, 8);
+    }
+
+    for (; i < _count; i++)
+    {
+        if (_src[i] != 0)
+        {
+            _dst[i] = _src[i];
+        }
+    }
+}
+
+void BNSpriteEditor::CopyOpaquePixels(QRgb *_dst, const QRgb *_src, int _count)
+{
+    // Color 0 is 0 in the atlas, everything else is opaque
+    for (int i = 0; i < _count; i++)
+    {
+        if (_src[i] != 0)
+        {
+            _dst[i] = _src[i];
+        }
+    }
+}
+
+//---------------------------------------------------------------------------
+// Render the thumbnails the animation and frame lists are missing on screen on the thread pool.
+// Workers read a copy of the sprite and palettes so editing can carry on meanwhile
+//---------------------------------------------------------------------------
+void BNSpriteEditor::on_Thumbnail_timeout()
+{
+    QVector<ThumbnailJob> jobs;
+    bool hasNewJobs = false;
+    CollectThumbnailJobs(ui->Anim_LW, -1, jobs, hasNewJobs);
+    if (ui->Anim_LW->currentRow() >= 0)
+    {
+        CollectThumbnailJobs(ui->Frame_LW, ui->Anim_LW->currentRow(), jobs, hasNewJobs);
+    }
+
+    // Everything is either done or still being rendered
+    if (!hasNewJobs) return;
+
+    // Whatever the last run didn't deliver is rendered again from the new snapshot
+    StopThumbnailRendering();
+    for (ThumbnailJob& job : jobs)
+    {
+        job.m_ticket = m_thumbnailTicket++;
+        QListWidget* list = job.m_frameID < 0 ? ui->Anim_LW : ui->Frame_LW;
+        int const row = job.m_frameID < 0 ? job.m_animID : job.m_frameID;
+        static_cast<ThumbnailListItem*>(list->item(row))->SetTicket(job.m_ticket);
+    }
+
+    // Only frames changed since the last snapshot are copied, tileset pixels and palettes are shared
+    ThumbnailRenderer renderer;
+    renderer.m_snapshot = m_sprite.TakeSnapshot();
+    for (int i = 0; i < m_sprite.GetTilesetCount(); i++)
+    {
+        renderer.m_tilesetPixels.push_back(m_sprite.GetSharedTilesetPixels(i));
+    }
+    renderer.m_paletteGroups = m_paletteGroups;
+    renderer.m_iconSize = ui->Anim_LW->iconSize().width();
+    m_thumbnailWatcher.setFuture(QtConcurrent::mapped(jobs, renderer));
+}
+
+//---------------------------------------------------------------------------
+// Rows on screen and a few either side need a thumbnail, the others drop theirs.
+// _animID is the animation of the frame list, -1 for the animation list which shows first frames
+//---------------------------------------------------------------------------
+void BNSpriteEditor::CollectThumbnailJobs(QListWidget *_list, int _animID, QVector<ThumbnailJob> &_jobs, bool &_hasNewJobs)
+{
+    // Rows at both ends of the viewport, stepping over the spacing if it lands between two rows
+    QRect const viewport = _list->viewport()->rect();
+    bool const vertical = _list->flow() == QListView::TopToBottom;
+    QPoint const start = vertical ? QPoint(viewport.center().x(), viewport.top()) : QPoint(viewport.left(), viewport.center().y());
+    QPoint const end = vertical ? QPoint(viewport.center().x(), viewport.bottom()) : QPoint(viewport.right(), viewport.center().y());
+    QPoint const gap = vertical ? QPoint(0, _list->spacing() + 1) : QPoint(_list->spacing() + 1, 0);
+
+    int first = _list->indexAt(start).row();
+    if (first < 0) first = _list->indexAt(start + gap).row();
+    int last = _list->indexAt(end).row();
+    if (last < 0) last = _list->indexAt(end - gap).row();
+    if (last < 0) last = _list->count() - 1; // list ends before the viewport does
+
+    if (first >= 0 && _list->isVisible())
+    {
+        first = qMax(0, first - c_thumbnailPrefetchRows);
+        last = qMin(_list->count() - 1, last + c_thumbnailPrefetchRows);
+    }
+    else
+    {
+        first = _list->count();
+        last = -1;
+    }
+
+    bool const running = m_thumbnailWatcher.isRunning();
+    for (int i = 0; i < _list->count(); i++)
+    {
+        ThumbnailListItem* item = static_cast<ThumbnailListItem*>(_list->item(i));
+        if (i < first || i > last)
+        {
+            item->DropThumbnail();
+            continue;
+        }
+
+        if (item->NeedsThumbnail())
+        {
+            ThumbnailJob job;
+            job.m_ticket = -1;
+            job.m_animID = _animID < 0 ? i : _animID;
+            job.m_frameID = _animID < 0 ? -1 : i;
+
+            bool const isNew = !running || item->GetTicket() < 0;
+            if (isNew)
+            {
+                // Identical frames, or ones rendered before, are already in the frame image cache
+                BNSprite::FrameView const frame = m_sprite.GetAnimationFrameView(job.m_animID, qMax(0, job.m_frameID));
+                shared_ptr<vector<uint8_t> const> pixels = m_sprite.GetSharedTilesetPixels(frame.GetTilesetID());
+                QRect rect;
+                Palette palette;
+                QImage image;
+                if (m_frameImages.Find(GetThumbnailKey(frame, pixels.get(), m_paletteGroups, _list->iconSize().width(), rect, palette), image))
+                {
+                    item->SetThumbnail(image);
+                    continue;
                 }
             }
+
+            _jobs.push_back(job);
+            _hasNewJobs |= isNew;
+        }
+    }
+}
+
+void BNSpriteEditor::StopThumbnailRendering()
+{
+    m_thumbnailWatcher.cancel();
+    m_thumbnailWatcher.waitForFinished();
+}
+
+//---------------------------------------------------------------------------
+// Key of a thumbnail in the frame image cache, the same as GetFrameImage() uses for it.
+// Also gives the area and palette to draw it with, safe to call from any thread
+//---------------------------------------------------------------------------
+QByteArray BNSpriteEditor::GetThumbnailKey(const BNSprite::FrameView &_frame, const void *_pixels, const QVector<PaletteGroup> &_paletteGroups, int _iconSize, QRect &_rect, Palette &_palette)
+{
+    uint8_t objectIndex = _frame.GetSubAnimation(0).GetSubFrames()[0].m_objectIndex;
+    BNSprite::ObjectView const object = _frame.GetObject(objectIndex);
+    _rect = GetThumbnailRect(object.GetSubObjects(), _iconSize);
+
+    int group = qMin((int)_frame.GetPaletteGroupID(), _paletteGroups.size() - 1);
+    PaletteGroup const& paletteGroup = _paletteGroups[group];
+    int index = qMin((int)object.GetPaletteIndex(), paletteGroup.size() - 1);
+    _palette = paletteGroup[index];
+
+    return FrameImageCache::MakeKey(object.GetSubObjects(), _frame.GetTilesetID(), _pixels, _palette, _rect.size(), QImage::Format_ARGB32_Premultiplied, _rect.x(), _rect.y());
+}
+
+//---------------------------------------------------------------------------
+// Runs on a worker thread, only reads the snapshot. The tile atlas cache belongs to the
+// GUI thread so tiles are drawn from the shared tileset pixels, the frame image cache
+// gets the result once it's back on the GUI thread
+//---------------------------------------------------------------------------
+BNSpriteEditor::ThumbnailResult BNSpriteEditor::ThumbnailRenderer::operator()(const ThumbnailJob &_job) const
+{
+    BNSprite::FrameView const frame = BNSprite::GetSnapshotFrameView(*m_snapshot, _job.m_animID, qMax(0, _job.m_frameID));
+    uint32_t const tilesetID = frame.GetTilesetID();
+
+    ThumbnailResult result;
+    result.m_ticket = _job.m_ticket;
+    result.m_pixels = tilesetID < m_tilesetPixels.size() ? m_tilesetPixels[tilesetID] : shared_ptr<vector<uint8_t> const>();
+
+    QRect rect;
+    Palette palette;
+    result.m_key = GetThumbnailKey(frame, result.m_pixels.get(), m_paletteGroups, m_iconSize, rect, palette);
+
+    QImage image(rect.size(), QImage::Format_Indexed8);
+    image.setColorTable(palette);
+    image.fill(0);
+
+    if (result.m_pixels)
+    {
+        vector<uint8_t> const& data = *result.m_pixels;
+        uint8_t objectIndex = frame.GetSubAnimation(0).GetSubFrames()[0].m_objectIndex;
+        for (BNSprite::SubObject const& subObject : frame.GetObject(objectIndex).GetSubObjects())
+        {
+            DrawTileRows(subObject.m_startTile, subObject.GetSizeX(), subObject.GetSizeY(), subObject.m_posX - rect.x(), subObject.m_posY - rect.y(), subObject.GetHFlip(), subObject.GetVFlip(), &image, data.data(), data.size() / 64, false);
         }
     }
+
+    // Color 0 is transparent in the palette so it stays transparent here
+    result.m_image = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    return result;
 }
 
+//---------------------------------------------------------------------------
+// A thumbnail has finished, the item might have moved, scrolled away or been edited since
+//---------------------------------------------------------------------------
+void BNSpriteEditor::on_Thumbnail_resultReadyAt(int index)
+{
+    ThumbnailResult const result = m_thumbnailWatcher.resultAt(index);
+    m_frameImages.Insert(result.m_key, result.m_image, result.m_pixels);
 
+    QListWidget* const lists[] = {ui->Anim_LW, ui->Frame_LW};
+    for (QListWidget* list : lists)
+    {
+        for (int i = 0; i < list->count(); i++)
+        {
+            ThumbnailListItem* item = static_cast<ThumbnailListItem*>(list->item(i));
+            if (item->GetTicket() == result.m_ticket)
+            {
+                item->SetThumbnail(result.m_image);
+                return;
+            }
+        }
+    }
+}
 
 //---------------------------------------------------------------------------
 // Animation signals
@@ -1222,6 +1732,7 @@ void BNSpriteEditor::on_Anim_PB_Down_clicked()
 void BNSpriteEditor::on_Anim_PB_New_clicked()
 {
     int animID = m_sprite.NewAnimation();
+    RecordHistory();
     AddAnimationThumbnail(animID);
     ui->Anim_LW->setCurrentRow(animID);
 }
@@ -1229,6 +1740,7 @@ void BNSpriteEditor::on_Anim_PB_New_clicked()
 void BNSpriteEditor::on_Anim_PB_Dup_clicked()
 {
     int animID = m_sprite.NewAnimation(ui->Anim_LW->currentRow());
+    RecordHistory();
     AddAnimationThumbnail(animID);
     ui->Anim_LW->setCurrentRow(animID);
 }
@@ -1248,15 +1760,12 @@ void BNSpriteEditor::on_Anim_PB_Del_clicked()
     int animID = ui->Anim_LW->currentRow();
 
     m_sprite.DeleteAnimation(animID);
-
-    // Clear thumbnail
-    delete m_animThumbnails[animID];
-    m_animThumbnails.remove(animID);
+    RecordHistory();
 
     // We manually call item changed here, because takeItem() calls it but it's not deleted yet
     ui->Anim_LW->blockSignals(true);
     delete ui->Anim_LW->takeItem(animID);
-    on_Anim_LW_currentItemChanged(ui->Anim_LW->item(animID == m_animThumbnails.size() ? animID - 1 : animID), Q_NULLPTR);
+    on_Anim_LW_currentItemChanged(ui->Anim_LW->item(animID == ui->Anim_LW->count() ? animID - 1 : animID), Q_NULLPTR);
     ui->Anim_LW->blockSignals(false);
 
     // Fix the aniamtion numbers
@@ -1276,28 +1785,20 @@ void BNSpriteEditor::on_Anim_PB_Del_clicked()
 }
 
 //---------------------------------------------------------------------------
-// Create thumbnail from animation to list view
+// Add animation to list view, the thumbnail is rendered once the row is shown
 //---------------------------------------------------------------------------
 void BNSpriteEditor::AddAnimationThumbnail(int _animID)
 {
-    BNSprite::Frame frame = m_sprite.GetAnimationFrame(_animID, 0);
-    QImage* image = GetFrameImage(frame, true);
-    m_animThumbnails.push_back(image);
-    QListWidgetItem* item = new QListWidgetItem(QIcon(QPixmap::fromImage(*image)), "Animation " + QString::number(_animID));
-    ui->Anim_LW->addItem(item);
+    ui->Anim_LW->addItem(new ThumbnailListItem("Animation " + QString::number(_animID)));
 }
 
 //---------------------------------------------------------------------------
-// Update thumbnail for animation to list view
+// Update thumbnail for animation to list view, the old one stays until the new one is ready
 //---------------------------------------------------------------------------
 void BNSpriteEditor::UpdateAnimationThumnail(int _animID)
 {
-    delete m_animThumbnails[_animID];
-    BNSprite::Frame const frame = m_sprite.GetAnimationFrame(_animID, 0);
-    QImage* image = GetFrameImage(frame, true);
-    m_animThumbnails[_animID] = image;
-    QListWidgetItem* item = ui->Anim_LW->item(_animID);
-    item->setIcon(QIcon(QPixmap::fromImage(*image)));
+    static_cast<ThumbnailListItem*>(ui->Anim_LW->item(_animID))->InvalidateThumbnail();
+    m_thumbnailTimer->start();
 }
 
 //---------------------------------------------------------------------------
@@ -1307,14 +1808,13 @@ void BNSpriteEditor::SwapAnimation(int _oldID, int _newID)
 {
     // Swap in actual sprite
     m_sprite.SwapAnimations(_oldID, _newID);
+    RecordHistory();
 
     // Simply swap the two images
-    qSwap(m_animThumbnails[_oldID], m_animThumbnails[_newID]);
-    QListWidgetItem* item0 = ui->Anim_LW->item(_newID);
-    item0->setIcon(QIcon(QPixmap::fromImage(*m_animThumbnails[_newID])));
+    ThumbnailListItem* item0 = static_cast<ThumbnailListItem*>(ui->Anim_LW->item(_newID));
+    ThumbnailListItem* item1 = static_cast<ThumbnailListItem*>(ui->Anim_LW->item(_oldID));
+    item0->SwapThumbnail(*item1);
     item0->setForeground(QColor(255,0,0));
-    QListWidgetItem* item1 = ui->Anim_LW->item(_oldID);
-    item1->setIcon(QIcon(QPixmap::fromImage(*m_animThumbnails[_oldID])));
     item1->setForeground(QColor(0,0,0));
 
     // Block signal to prevent loading animations again
@@ -1440,6 +1940,7 @@ void BNSpriteEditor::on_Frame_CB_Loop_toggled(bool checked)
     if (m_sprite.GetAnimationLoop(animID) != checked)
     {
         m_sprite.SetAnimationLoop(animID, checked);
+        RecordHistory();
     }
 }
 
@@ -1517,6 +2018,7 @@ void BNSpriteEditor::on_Frame_PB_New_clicked()
 {
     int animID = ui->Anim_LW->currentRow();
     int frameID = m_sprite.NewFrame(animID);
+    RecordHistory();
     AddFrameThumbnail(animID, frameID);
     ui->Frame_LW->setCurrentRow(frameID);
 }
@@ -1544,6 +2046,7 @@ void BNSpriteEditor::on_Frame_PB_Paste_clicked()
     }
 
     qDebug() << "Paste frame from Anim" << m_copyAnim << "Frame" << m_copyFrame;
+    RecordHistory();
     AddFrameThumbnail(animID, frameID);
     ui->Frame_LW->setCurrentRow(frameID);
 }
@@ -1553,15 +2056,12 @@ void BNSpriteEditor::on_Frame_PB_Del_clicked()
     int animID = ui->Anim_LW->currentRow();
     int frameID = ui->Frame_LW->currentRow();
     m_sprite.DeleteFrame(animID, frameID);
-
-    // Clear thumbnail
-    delete m_frameThumbnails[frameID];
-    m_frameThumbnails.remove(frameID);
+    RecordHistory();
 
     // We manually call item changed here, because takeItem() calls it but it's not deleted yet
     ui->Frame_LW->blockSignals(true);
     delete ui->Frame_LW->takeItem(frameID);
-    on_Frame_LW_currentItemChanged(ui->Frame_LW->item(frameID == m_frameThumbnails.size() ? frameID - 1 : frameID), Q_NULLPTR);
+    on_Frame_LW_currentItemChanged(ui->Frame_LW->item(frameID == ui->Frame_LW->count() ? frameID - 1 : frameID), Q_NULLPTR);
     ui->Frame_LW->blockSignals(false);
 
     // Fix the frame numbers
@@ -1595,6 +2095,7 @@ void BNSpriteEditor::on_Frame_SB_Delay_valueChanged(int arg1)
 
     m_frame.m_delay = arg1;
     m_sprite.ReplaceFrame(animID, frameID, m_frame);
+    RecordHistory();
 }
 
 void BNSpriteEditor::on_Frame_CB_Flag0_toggled(bool checked)
@@ -1606,6 +2107,7 @@ void BNSpriteEditor::on_Frame_CB_Flag0_toggled(bool checked)
 
     m_frame.m_specialFlag0 = checked;
     m_sprite.ReplaceFrame(animID, frameID, m_frame);
+    RecordHistory();
 }
 
 void BNSpriteEditor::on_Frame_CB_Flag1_toggled(bool checked)
@@ -1617,31 +2119,26 @@ void BNSpriteEditor::on_Frame_CB_Flag1_toggled(bool checked)
 
     m_frame.m_specialFlag1 = checked;
     m_sprite.ReplaceFrame(animID, frameID, m_frame);
+    RecordHistory();
 }
 
 //---------------------------------------------------------------------------
-// Create thumbnail from frame to list view
+// Add frame of the current animation to list view, the thumbnail is rendered once the row is shown
 //---------------------------------------------------------------------------
 void BNSpriteEditor::AddFrameThumbnail(int _animID, int _frameID)
 {
-    BNSprite::Frame const& frame = m_sprite.GetAnimationFrame(_animID, _frameID);
-    QImage* image = GetFrameImage(frame, true);
-    m_frameThumbnails.push_back(image);
-    QListWidgetItem* item = new QListWidgetItem(QIcon(QPixmap::fromImage(*image)), "Frame " + QString::number(_frameID));
-    ui->Frame_LW->addItem(item);
+    // Frames are always rendered from the selected animation, same as editing them
+    Q_UNUSED(_animID);
+    ui->Frame_LW->addItem(new ThumbnailListItem("Frame " + QString::number(_frameID)));
 }
 
 //---------------------------------------------------------------------------
-// Update thumbnail for frame to list view
+// Update thumbnail for frame to list view, the old one stays until the new one is ready
 //---------------------------------------------------------------------------
 void BNSpriteEditor::UpdateFrameThumbnail(int _frameID)
 {
-    int animID = ui->Anim_LW->currentRow();
-    delete m_frameThumbnails[_frameID];
-    QImage* image = GetFrameImage(m_sprite.GetAnimationFrame(animID, _frameID), true);
-    m_frameThumbnails[_frameID] = image;
-    QListWidgetItem* item = ui->Frame_LW->item(_frameID);
-    item->setIcon(QIcon(QPixmap::fromImage(*image)));
+    static_cast<ThumbnailListItem*>(ui->Frame_LW->item(_frameID))->InvalidateThumbnail();
+    m_thumbnailTimer->start();
 
     if (_frameID == 0)
     {
@@ -1656,14 +2153,13 @@ void BNSpriteEditor::SwapFrame(int _animID, int _oldID, int _newID, bool _update
 {
     // Swap in actual frame
     m_sprite.SwapFrames(_animID, _oldID, _newID);
+    RecordHistory();
 
     // Simply swap the two images
-    qSwap(m_frameThumbnails[_oldID], m_frameThumbnails[_newID]);
-    QListWidgetItem* item0 = ui->Frame_LW->item(_newID);
-    item0->setIcon(QIcon(QPixmap::fromImage(*m_frameThumbnails[_newID])));
+    ThumbnailListItem* item0 = static_cast<ThumbnailListItem*>(ui->Frame_LW->item(_newID));
+    ThumbnailListItem* item1 = static_cast<ThumbnailListItem*>(ui->Frame_LW->item(_oldID));
+    item0->SwapThumbnail(*item1);
     item0->setForeground(QColor(255,0,0));
-    QListWidgetItem* item1 = ui->Frame_LW->item(_oldID);
-    item1->setIcon(QIcon(QPixmap::fromImage(*m_frameThumbnails[_oldID])));
     item1->setForeground(QColor(0,0,0));
 
     // Block signal to prevent loading frame again
@@ -1702,6 +2198,7 @@ void BNSpriteEditor::on_Tileset_SB_Index_valueChanged(int arg1)
 
     m_frame.m_tilesetID = arg1;
     m_sprite.ReplaceFrame(animID, frameID, m_frame);
+    RecordHistory();
 
     CacheTileset();
     UpdateDrawTileset();
@@ -1751,6 +2248,7 @@ void BNSpriteEditor::on_Tileset_PB_Import_clicked()
     }
     else
     {
+        RecordHistory();
         CacheTileset();
         UpdateDrawTileset();
 
@@ -1820,12 +2318,12 @@ void BNSpriteEditor::CacheTileset()
         m_tilesetImage = Q_NULLPTR;
     }
 
-    m_tilesetData.clear();
-    m_sprite.GetTilesetPixels(ui->Tileset_SB_Index->value(), m_tilesetData);
+    // Shares the sprite's unpacked pixels, they stay valid even if the tileset is modified
+    m_tilesetData = m_sprite.GetSharedTilesetPixels(ui->Tileset_SB_Index->value());
 
-    Q_ASSERT(!m_tilesetData.empty());
+    Q_ASSERT(m_tilesetData && !m_tilesetData->empty());
 
-    int tileCount = m_tilesetData.size() / 64;
+    int tileCount = m_tilesetData->size() / 64;
     ui->Tileset_Label->setText("Total No. of tiles: " + QString::number(tileCount));
 }
 
@@ -1835,9 +2333,9 @@ void BNSpriteEditor::CacheTileset()
 void BNSpriteEditor::UpdateDrawTileset()
 {
     // We have to cache tileset first!
-    Q_ASSERT(!m_tilesetData.empty());
+    Q_ASSERT(m_tilesetData && !m_tilesetData->empty());
 
-    int tileCount = m_tilesetData.size() / 64;
+    int tileCount = m_tilesetData->size() / 64;
     ui->Tileset_Label->setText("Total No. of tiles: " + QString::number(tileCount));
 
     int tileXCount = qMin(tileCount, 8);
@@ -1852,12 +2350,7 @@ void BNSpriteEditor::UpdateDrawTileset()
     m_tilesetImage->setColorTable(palette);
     m_tilesetImage->fill(0);
 
-    BNSprite::SubObject dummyOAM;
-    dummyOAM.m_sizeX = tileXCount * 8;
-    dummyOAM.m_sizeY = tileYCount * 8;
-    dummyOAM.m_posX = 0;
-    dummyOAM.m_posY = 0;
-    DrawOAMInImage(dummyOAM, m_tilesetImage, 0, 0, m_tilesetData, true);
+    DrawTilesInImage(0, tileXCount * 8, tileYCount * 8, 0, 0, false, false, m_tilesetImage, *m_tilesetData, true);
 
     // convert to ARGB so we can use more than 256 colors and draw transparency
     m_tilesetImage->convertTo(QImage::Format_ARGB32);
@@ -1912,6 +2405,7 @@ void BNSpriteEditor::on_SubAnim_PB_New_clicked()
     int animID = ui->Anim_LW->currentRow();
     int frameID = ui->Frame_LW->currentRow();
     m_sprite.ReplaceFrame(animID, frameID, m_frame);
+    RecordHistory();
 
     ui->SubAnim_PB_New->setEnabled(subAnimCount < 255);
     ui->SubAnim_PB_Dup->setEnabled(subAnimCount < 255);
@@ -1931,6 +2425,7 @@ void BNSpriteEditor::on_SubAnim_PB_Dup_clicked()
     int animID = ui->Anim_LW->currentRow();
     int frameID = ui->Frame_LW->currentRow();
     m_sprite.ReplaceFrame(animID, frameID, m_frame);
+    RecordHistory();
 
     ui->SubAnim_PB_New->setEnabled(subAnimCount < 255);
     ui->SubAnim_PB_Dup->setEnabled(subAnimCount < 255);
@@ -1945,6 +2440,7 @@ void BNSpriteEditor::on_SubAnim_PB_Del_clicked()
     int animID = ui->Anim_LW->currentRow();
     int frameID = ui->Frame_LW->currentRow();
     m_sprite.ReplaceFrame(animID, frameID, m_frame);
+    RecordHistory();
 
     // Manually call valueChanged here, because it is not changed if not deleting max
     int subAnimCount = m_frame.m_subAnimations.size();
@@ -2053,6 +2549,7 @@ void BNSpriteEditor::on_SubFrame_CB_Loop_toggled(bool checked)
     int animID = ui->Anim_LW->currentRow();
     int frameID = ui->Frame_LW->currentRow();
     m_sprite.ReplaceFrame(animID, frameID, m_frame);
+    RecordHistory();
 }
 
 void BNSpriteEditor::on_SubFrame_LW_currentItemChanged(QListWidgetItem *current, QListWidgetItem *previous)
@@ -2088,6 +2585,7 @@ void BNSpriteEditor::on_SubFrame_PB_Add_clicked()
     int animID = ui->Anim_LW->currentRow();
     int frameID = ui->Frame_LW->currentRow();
     m_sprite.ReplaceFrame(animID, frameID, m_frame);
+    RecordHistory();
 
     ui->SubFrame_PB_Play->setEnabled(true);
 }
@@ -2109,6 +2607,7 @@ void BNSpriteEditor::on_SubFrame_PB_Del_clicked()
     int animID = ui->Anim_LW->currentRow();
     int frameID = ui->Frame_LW->currentRow();
     m_sprite.ReplaceFrame(animID, frameID, m_frame);
+    RecordHistory();
 
     // We manually call item changed here, because takeItem() calls it but it's not deleted yet
     ui->SubFrame_LW->blockSignals(true);
@@ -2155,6 +2654,7 @@ void BNSpriteEditor::on_SubFrame_SB_Index_valueChanged(int arg1)
 
     subFrame.m_objectIndex = arg1;
     m_sprite.ReplaceFrame(animID, frameID, m_frame);
+    RecordHistory();
 
     // Jump to object
     ui->Object_Tabs->setCurrentIndex(arg1);
@@ -2183,6 +2683,7 @@ void BNSpriteEditor::on_SubFrame_SB_Delay_valueChanged(int arg1)
 
     subFrame.m_delay = arg1;
     m_sprite.ReplaceFrame(animID, frameID, m_frame);
+    RecordHistory();
 }
 
 //---------------------------------------------------------------------------
@@ -2218,6 +2719,7 @@ void BNSpriteEditor::SwapSubFrame(int _oldID, int _newID)
     int animID = ui->Anim_LW->currentRow();
     int frameID = ui->Frame_LW->currentRow();
     m_sprite.ReplaceFrame(animID, frameID, m_frame);
+    RecordHistory();
 
     // Simply swap the two icons
     QListWidgetItem* item0 = ui->SubFrame_LW->item(_newID);
@@ -2300,6 +2802,7 @@ void BNSpriteEditor::on_Palette_SB_Group_valueChanged(int arg1)
     int animID = ui->Anim_LW->currentRow();
     int frameID = ui->Frame_LW->currentRow();
     m_sprite.ReplaceFrame(animID, frameID, m_frame);
+    RecordHistory();
 
     // Update thumbnail
     int objectID = ui->Object_Tabs->currentIndex();
@@ -2362,6 +2865,7 @@ void BNSpriteEditor::on_Palette_SB_Index_valueChanged(int arg1)
         int animID = ui->Anim_LW->currentRow();
         int frameID = ui->Frame_LW->currentRow();
         m_sprite.ReplaceFrame(animID, frameID, m_frame);
+        RecordHistory();
 
         // Update thumbnail
         if (objectID == m_frame.m_subAnimations[0].m_subFrames[0].m_objectIndex)
@@ -2562,6 +3066,8 @@ void BNSpriteEditor::on_Palette_PB_Import_pressed()
         }
     }
 
+    RecordHistory();
+
     // Only need to update thumbnail if we replace the group
     if (msgBox.clickedButton() == pButtonReplace)
     {
@@ -2631,6 +3137,7 @@ void BNSpriteEditor::on_Palette_Color_changed(int paletteIndex, int colorIndex,
     Palette& palette = m_paletteGroups[group][paletteIndex];
     palette[colorIndex] = color;
     palette[0] &= 0x00FFFFFF; // transparency for first color
+    RecordHistory();
 
     UpdateAllThumbnails(paletteIndex);
 }
@@ -2699,6 +3206,7 @@ void BNSpriteEditor::on_PaletteContexMenu_paletteReplaced()
     if (palette.size() != paletteNew.size()) return;
     palette = paletteNew;
     ui->Palette_GV->replacePalette(paletteIndex, paletteNew);
+    RecordHistory();
 
     UpdateAllThumbnails(paletteIndex);
 }
@@ -2802,35 +3310,18 @@ void BNSpriteEditor::SwapPalette(int id1, int id2)
     ui->Palette_GV->swapPalette(id1, id2);
 
     // Fix all frame palette index
-    int animationCount = m_sprite.GetAnimationCount();
-    for (int animID = 0; animID < animationCount; animID++)
+    m_sprite.VisitObjects([id1, id2](BNSprite::ObjectEdit& _object)
     {
-        vector<BNSprite::Frame> frames;
-        m_sprite.GetAnimationFrames(animID, frames);
-        for (int frameID = 0; frameID < frames.size(); frameID++)
+        if (_object.GetPaletteIndex() == id1)
         {
-            bool updated = false;
-            BNSprite::Frame& frame = frames[frameID];
-            for (BNSprite::Object& obj : frame.m_objects)
-            {
-                if (obj.m_paletteIndex == id1)
-                {
-                    obj.m_paletteIndex = id2;
-                    updated = true;
-                }
-                else if (obj.m_paletteIndex == id2)
-                {
-                    obj.m_paletteIndex = id1;
-                    updated = true;
-                }
-            }
-
-            if (updated)
-            {
-                m_sprite.ReplaceFrame(animID, frameID, frame);
-            }
+            _object.SetPaletteIndex(id2);
         }
-    }
+        else if (_object.GetPaletteIndex() == id2)
+        {
+            _object.SetPaletteIndex(id1);
+        }
+    });
+    RecordHistory();
 }
 
 //---------------------------------------------------------------------------
@@ -2854,30 +3345,14 @@ void BNSpriteEditor::InsertPalette(int insertAt, Palette palette)
     ui->Palette_PB_Down->setEnabled(index < maximum && !IsCustomSpriteMakerActive());
 
     // Fix all frame palette index
-    int animationCount = m_sprite.GetAnimationCount();
-    for (int animID = 0; animID < animationCount; animID++)
+    m_sprite.VisitObjects([insertAt](BNSprite::ObjectEdit& _object)
     {
-        vector<BNSprite::Frame> frames;
-        m_sprite.GetAnimationFrames(animID, frames);
-        for (int frameID = 0; frameID < frames.size(); frameID++)
+        if (_object.GetPaletteIndex() >= insertAt)
         {
-            bool updated = false;
-            BNSprite::Frame& frame = frames[frameID];
-            for (BNSprite::Object& obj : frame.m_objects)
-            {
-                if (obj.m_paletteIndex >= insertAt)
-                {
-                    obj.m_paletteIndex++;
-                    updated = true;
-                }
-            }
-
-            if (updated)
-            {
-                m_sprite.ReplaceFrame(animID, frameID, frame);
-            }
+            _object.SetPaletteIndex(_object.GetPaletteIndex() + 1);
         }
-    }
+    });
+    RecordHistory();
 
     // increment index by one if inserted above current index
     if (index >= insertAt)
@@ -2917,30 +3392,14 @@ void BNSpriteEditor::DeletePalette(int paletteIndex)
     ui->Palette_PB_Down->setEnabled(index < maximum && !IsCustomSpriteMakerActive());
 
     // Fix all frame palette index
-    int animationCount = m_sprite.GetAnimationCount();
-    for (int animID = 0; animID < animationCount; animID++)
+    m_sprite.VisitObjects([paletteIndex](BNSprite::ObjectEdit& _object)
     {
-        vector<BNSprite::Frame> frames;
-        m_sprite.GetAnimationFrames(animID, frames);
-        for (int frameID = 0; frameID < frames.size(); frameID++)
+        if (_object.GetPaletteIndex() > paletteIndex)
         {
-            bool updated = false;
-            BNSprite::Frame& frame = frames[frameID];
-            for (BNSprite::Object& obj : frame.m_objects)
-            {
-                if (obj.m_paletteIndex > paletteIndex)
-                {
-                    obj.m_paletteIndex--;
-                    updated = true;
-                }
-            }
-
-            if (updated)
-            {
-                m_sprite.ReplaceFrame(animID, frameID, frame);
-            }
+            _object.SetPaletteIndex(_object.GetPaletteIndex() - 1);
         }
-    }
+    });
+    RecordHistory();
 
     // Redraw preview, OAM, tileset
     if (index > paletteIndex)
@@ -3037,6 +3496,7 @@ void BNSpriteEditor::on_Object_PB_New_clicked()
     int animID = ui->Anim_LW->currentRow();
     int frameID = ui->Frame_LW->currentRow();
     m_sprite.ReplaceFrame(animID, frameID, m_frame);
+    RecordHistory();
 
     ui->Object_PB_New->setEnabled(objectCount < 255);
     ui->Object_PB_Dup->setEnabled(objectCount < 255);
@@ -3059,6 +3519,7 @@ void BNSpriteEditor::on_Object_PB_Dup_clicked()
     int animID = ui->Anim_LW->currentRow();
     int frameID = ui->Frame_LW->currentRow();
     m_sprite.ReplaceFrame(animID, frameID, m_frame);
+    RecordHistory();
 
     ui->Object_PB_New->setEnabled(objectCount < 255);
     ui->Object_PB_Dup->setEnabled(objectCount < 255);
@@ -3101,6 +3562,7 @@ void BNSpriteEditor::on_Object_PB_Del_clicked()
     int animID = ui->Anim_LW->currentRow();
     int frameID = ui->Frame_LW->currentRow();
     m_sprite.ReplaceFrame(animID, frameID, m_frame);
+    RecordHistory();
 
     // Rename all tabs
     for (int i = 0; i < ui->Object_Tabs->count(); i++)
@@ -3144,18 +3606,18 @@ void BNSpriteEditor::on_OAM_TW_currentItemChanged(QTreeWidgetItem *current, QTre
     BNSprite::Object const& object = m_frame.m_objects[objectID];
     BNSprite::SubObject const& subObject = object.m_subObjects[index];
 
-    ui->OAM_SB_Tile->setMaximum(m_tilesetData.size() / 64 - 1);
+    ui->OAM_SB_Tile->setMaximum((m_tilesetData ? (int)m_tilesetData->size() / 64 : 0) - 1);
     ui->OAM_SB_Tile->setValue(subObject.m_startTile);
     ui->OAM_SB_Tile->setEnabled(true);
-    ui->OAM_CB_Size->setCurrentText(QString::number(subObject.m_sizeX) + "x" + QString::number(subObject.m_sizeY));
+    ui->OAM_CB_Size->setCurrentText(QString::number(subObject.GetSizeX()) + "x" + QString::number(subObject.GetSizeY()));
     ui->OAM_CB_Size->setEnabled(true);
     ui->OAM_SB_XPos->setValue(subObject.m_posX);
     ui->OAM_SB_XPos->setEnabled(true);
     ui->OAM_SB_YPos->setValue(subObject.m_posY);
     ui->OAM_SB_YPos->setEnabled(true);
-    ui->OAM_CB_HFlip->setChecked(subObject.m_hFlip);
+    ui->OAM_CB_HFlip->setChecked(subObject.GetHFlip());
     ui->OAM_CB_HFlip->setEnabled(true);
-    ui->OAM_CB_VFlip->setChecked(subObject.m_vFlip);
+    ui->OAM_CB_VFlip->setChecked(subObject.GetVFlip());
     ui->OAM_CB_VFlip->setEnabled(true);
 
     UpdateOAMThumbnail(subObject);
@@ -3193,6 +3655,7 @@ void BNSpriteEditor::on_OAM_PB_New_clicked()
     int animID = ui->Anim_LW->currentRow();
     int frameID = ui->Frame_LW->currentRow();
     m_sprite.ReplaceFrame(animID, frameID, m_frame);
+    RecordHistory();
 
     AddOAM(BNSprite::SubObject());
     ui->OAM_TW->setCurrentItem(ui->OAM_TW->topLevelItem(object.m_subObjects.size() - 1));
@@ -3215,6 +3678,7 @@ void BNSpriteEditor::on_OAM_PB_Dup_clicked()
     int animID = ui->Anim_LW->currentRow();
     int frameID = ui->Frame_LW->currentRow();
     m_sprite.ReplaceFrame(animID, frameID, m_frame);
+    RecordHistory();
 
     AddOAM(object.m_subObjects[OAMIndex]);
     ui->OAM_TW->setCurrentItem(ui->OAM_TW->topLevelItem(object.m_subObjects.size() - 1));
@@ -3243,6 +3707,7 @@ void BNSpriteEditor::on_OAM_PB_Del_clicked()
     int animID = ui->Anim_LW->currentRow();
     int frameID = ui->Frame_LW->currentRow();
     m_sprite.ReplaceFrame(animID, frameID, m_frame);
+    RecordHistory();
 
     // Update thumbnail
     if (objectID == m_frame.m_subAnimations[0].m_subFrames[0].m_objectIndex)
@@ -3274,6 +3739,7 @@ void BNSpriteEditor::on_OAM_SB_Tile_valueChanged(int arg1)
     int animID = ui->Anim_LW->currentRow();
     int frameID = ui->Frame_LW->currentRow();
     m_sprite.ReplaceFrame(animID, frameID, m_frame);
+    RecordHistory();
 
     // Update thumbnail
     if (objectID == m_frame.m_subAnimations[0].m_subFrames[0].m_objectIndex)
@@ -3301,17 +3767,17 @@ void BNSpriteEditor::on_OAM_CB_Size_currentTextChanged(const QString &arg1)
     QStringList size = arg1.split('x');
     int sizeX = size[0].toInt();
     int sizeY = size[1].toInt();
-    if ((subObject.m_sizeX == sizeX && subObject.m_sizeY == sizeY) || !ui->OAM_CB_Size->isEnabled()) return;
-    subObject.m_sizeX = sizeX;
-    subObject.m_sizeY = sizeY;
+    if ((subObject.GetSizeX() == sizeX && subObject.GetSizeY() == sizeY) || !ui->OAM_CB_Size->isEnabled()) return;
+    if (!subObject.SetSize(sizeX, sizeY)) return;
 
     QTreeWidgetItem *item = ui->OAM_TW->topLevelItem(OAMIndex);
-    QString sizeString = QString::number(subObject.m_sizeX) + "x" + QString::number(subObject.m_sizeY);
+    QString sizeString = QString::number(subObject.GetSizeX()) + "x" + QString::number(subObject.GetSizeY());
     item->setText(1, sizeString);
 
     int animID = ui->Anim_LW->currentRow();
     int frameID = ui->Frame_LW->currentRow();
     m_sprite.ReplaceFrame(animID, frameID, m_frame);
+    RecordHistory();
 
     // Update thumbnail
     if (objectID == m_frame.m_subAnimations[0].m_subFrames[0].m_objectIndex)
@@ -3347,6 +3813,7 @@ void BNSpriteEditor::on_OAM_SB_XPos_valueChanged(int arg1)
     int animID = ui->Anim_LW->currentRow();
     int frameID = ui->Frame_LW->currentRow();
     m_sprite.ReplaceFrame(animID, frameID, m_frame);
+    RecordHistory();
 
     // Update thumbnail
     if (objectID == m_frame.m_subAnimations[0].m_subFrames[0].m_objectIndex)
@@ -3381,6 +3848,7 @@ void BNSpriteEditor::on_OAM_SB_YPos_valueChanged(int arg1)
     int animID = ui->Anim_LW->currentRow();
     int frameID = ui->Frame_LW->currentRow();
     m_sprite.ReplaceFrame(animID, frameID, m_frame);
+    RecordHistory();
 
     // Update thumbnail
     if (objectID == m_frame.m_subAnimations[0].m_subFrames[0].m_objectIndex)
@@ -3405,12 +3873,13 @@ void BNSpriteEditor::on_OAM_CB_HFlip_toggled(bool checked)
     int OAMIndex = ui->OAM_TW->indexOfTopLevelItem(ui->OAM_TW->currentItem());
     BNSprite::SubObject& subObject = object.m_subObjects[OAMIndex];
 
-    if (subObject.m_hFlip == checked || !ui->OAM_CB_HFlip->isEnabled()) return;
-    subObject.m_hFlip = checked;
+    if (subObject.GetHFlip() == checked || !ui->OAM_CB_HFlip->isEnabled()) return;
+    subObject.SetHFlip(checked);
 
     int animID = ui->Anim_LW->currentRow();
     int frameID = ui->Frame_LW->currentRow();
     m_sprite.ReplaceFrame(animID, frameID, m_frame);
+    RecordHistory();
 
     // Update thumbnail
     if (objectID == m_frame.m_subAnimations[0].m_subFrames[0].m_objectIndex)
@@ -3435,12 +3904,13 @@ void BNSpriteEditor::on_OAM_CB_VFlip_toggled(bool checked)
     int OAMIndex = ui->OAM_TW->indexOfTopLevelItem(ui->OAM_TW->currentItem());
     BNSprite::SubObject& subObject = object.m_subObjects[OAMIndex];
 
-    if (subObject.m_vFlip == checked || !ui->OAM_CB_VFlip->isEnabled()) return;
-    subObject.m_vFlip = checked;
+    if (subObject.GetVFlip() == checked || !ui->OAM_CB_VFlip->isEnabled()) return;
+    subObject.SetVFlip(checked);
 
     int animID = ui->Anim_LW->currentRow();
     int frameID = ui->Frame_LW->currentRow();
     m_sprite.ReplaceFrame(animID, frameID, m_frame);
+    RecordHistory();
 
     // Update thumbnail
     if (objectID == m_frame.m_subAnimations[0].m_subFrames[0].m_objectIndex)
@@ -3471,7 +3941,7 @@ void BNSpriteEditor::AddOAM(const BNSprite::SubObject &_subObject)
     // Add to list view
     QTreeWidgetItem *item = new QTreeWidgetItem(ui->OAM_TW);
     item->setText(0, QString::number(_subObject.m_startTile));
-    item->setText(1, QString::number(_subObject.m_sizeX) + "x" + QString::number(_subObject.m_sizeY));
+    item->setText(1, QString::number(_subObject.GetSizeX()) + "x" + QString::number(_subObject.GetSizeY()));
     item->setText(2, QString::number(_subObject.m_posX) + "," + QString::number(_subObject.m_posY));
 
     // Add to preview
@@ -3490,6 +3960,7 @@ void BNSpriteEditor::SwapOAM(int _oldID, int _newID)
     int animID = ui->Anim_LW->currentRow();
     int frameID = ui->Frame_LW->currentRow();
     m_sprite.ReplaceFrame(animID, frameID, m_frame);
+    RecordHistory();
 
     // Swap OAM in tree view
     QTreeWidgetItem* item0 = ui->OAM_TW->topLevelItem(_oldID);
@@ -3541,9 +4012,9 @@ void BNSpriteEditor::UpdateOAMThumbnail(const BNSprite::SubObject &_subObject)
         delete m_oamImage;
     }
 
-    if (m_tilesetData.empty()) return;
+    if (!m_tilesetData || m_tilesetData->empty()) return;
 
-    m_oamImage = new QImage(_subObject.m_sizeX, _subObject.m_sizeY, QImage::Format_Indexed8);
+    m_oamImage = new QImage(_subObject.GetSizeX(), _subObject.GetSizeY(), QImage::Format_Indexed8);
     int group = qMin(ui->Palette_SB_Group->value(), m_paletteGroups.size() - 1);
     PaletteGroup const& paletteGroup = m_paletteGroups[group];
     int index = qMin(ui->Palette_SB_Index->value(), paletteGroup.size() - 1);
@@ -3552,7 +4023,7 @@ void BNSpriteEditor::UpdateOAMThumbnail(const BNSprite::SubObject &_subObject)
     m_oamImage->setColorTable(palette);
     m_oamImage->fill(0);
 
-    DrawOAMInImage(_subObject, m_oamImage, _subObject.m_posX, _subObject.m_posY, m_tilesetData, true);
+    DrawOAMInImage(_subObject, m_oamImage, _subObject.m_posX, _subObject.m_posY, *m_tilesetData, true);
 
     m_oamGraphic->clear();
     m_oamGraphic->setSceneRect(0, 0, m_oamImage->width(), m_oamImage->height());
@@ -3629,6 +4100,7 @@ void BNSpriteEditor::on_Preview_pressed(QPoint pos)
     int animID = ui->Anim_LW->currentRow();
     int frameID = ui->Frame_LW->currentRow();
     m_sprite.ReplaceFrame(animID, frameID, m_frame);
+    RecordHistory();
 
     // Update thumbnail
     if (objectID == m_frame.m_subAnimations[0].m_subFrames[0].m_objectIndex)
@@ -3664,15 +4136,17 @@ void BNSpriteEditor::AddPreviewOAM(const BNSprite::SubObject &_subObject)
 //---------------------------------------------------------------------------
 void BNSpriteEditor::DrawPreviewOAM(QGraphicsPixmapItem *_graphicsItem, const BNSprite::SubObject &_subObject)
 {
-    QImage image = QImage(_subObject.m_sizeX, _subObject.m_sizeY, QImage::Format_Indexed8);
+    QImage image = QImage(_subObject.GetSizeX(), _subObject.GetSizeY(), QImage::Format_ARGB32_Premultiplied);
     int group = qMin(ui->Palette_SB_Group->value(), m_paletteGroups.size() - 1);
     PaletteGroup const& paletteGroup = m_paletteGroups[group];
     int index = qMin(ui->Palette_SB_Index->value(), paletteGroup.size() - 1);
     Palette const& palette = paletteGroup[index];
-    image.setColorTable(palette);
     image.fill(0);
 
-    DrawOAMInImage(_subObject, &image, _subObject.m_posX, _subObject.m_posY, m_tilesetData, false);
+    // Frames sharing a tileset and palette reuse the same atlas
+    int tileCount = 0;
+    QRgb const* atlas = m_tileAtlas.GetAtlas(m_sprite, ui->Tileset_SB_Index->value(), group, index, palette, tileCount);
+    DrawOAMInImage(_subObject, &image, _subObject.m_posX, _subObject.m_posY, atlas, tileCount);
     _graphicsItem->setPixmap(QPixmap::fromImage(image));
 }
 
@@ -3730,7 +4204,7 @@ void BNSpriteEditor::HighlightPreviewOAM()
     }
 
     BNSprite::SubObject const& subObject = object.m_subObjects[OAMIndex];
-    QImage image = QImage(subObject.m_sizeX, subObject.m_sizeY, QImage::Format_RGBA8888);
+    QImage image = QImage(subObject.GetSizeX(), subObject.GetSizeY(), QImage::Format_RGBA8888);
     for (int y = 0; y < image.height(); y++)
     {
         for (int x = 0; x < image.width(); x++)
@@ -3862,6 +4336,7 @@ void BNSpriteEditor::MoveImage()
     int animID = ui->Anim_LW->currentRow();
     int frameID = ui->Frame_LW->currentRow();
     m_sprite.ReplaceFrame(animID, frameID, m_frame);
+    RecordHistory();
 
     // Update thumbnail
     if (objectID == m_frame.m_subAnimations[0].m_subFrames[0].m_objectIndex)
@@ -3886,13 +4361,13 @@ void BNSpriteEditor::FlipImage(bool _vertical)
         BNSprite::SubObject& subObject = object.m_subObjects[i];
         if (_vertical)
         {
-            subObject.m_vFlip = !subObject.m_vFlip;
-            subObject.m_posY = 0 - subObject.m_posY - subObject.m_sizeY;
+            subObject.SetVFlip(!subObject.GetVFlip());
+            subObject.m_posY = 0 - subObject.m_posY - subObject.GetSizeY();
         }
         else
         {
-            subObject.m_hFlip = !subObject.m_hFlip;
-            subObject.m_posX = 0 - subObject.m_posX - subObject.m_sizeX;
+            subObject.SetHFlip(!subObject.GetHFlip());
+            subObject.m_posX = 0 - subObject.m_posX - subObject.GetSizeX();
         }
 
         QTreeWidgetItem *item = ui->OAM_TW->topLevelItem(i);
@@ -3923,6 +4398,7 @@ void BNSpriteEditor::FlipImage(bool _vertical)
     int animID = ui->Anim_LW->currentRow();
     int frameID = ui->Frame_LW->currentRow();
     m_sprite.ReplaceFrame(animID, frameID, m_frame);
+    RecordHistory();
 
     // Update thumbnail
     if (objectID == m_frame.m_subAnimations[0].m_subFrames[0].m_objectIndex)
@@ -3954,8 +4430,8 @@ void BNSpriteEditor::UpdateImageControlButtons()
         minY = qMin(minY, (int)subObject.m_posY);
         maxX = qMax(maxX, (int)subObject.m_posX);
         maxY = qMax(maxY, (int)subObject.m_posY);
-        maxXwidth = qMax(maxXwidth, subObject.m_posX + subObject.m_sizeX - 1);
-        maxYheight = qMax(maxYheight, subObject.m_posY + subObject.m_sizeY - 1);
+        maxXwidth = qMax(maxXwidth, subObject.m_posX + subObject.GetSizeX() - 1);
+        maxYheight = qMax(maxYheight, subObject.m_posY + subObject.GetSizeY() - 1);
     }
 
     // Image control
@@ -3981,7 +4457,7 @@ void BNSpriteEditor::on_CSM_BuildSprite_pressed(int tilesetCount)
     {
         std::vector<uint8_t> data;
         m_csm->GetRawTilesetData(i, data);
-        m_sprite.ImportCustomTileset(data);
+        m_sprite.ImportCustomTileset(std::move(data));
     }
 
     // Create palette data
@@ -4006,6 +4482,7 @@ void BNSpriteEditor::on_CSM_BuildSprite_pressed(int tilesetCount)
 
     ui->Anim_PB_New->setEnabled(ui->Anim_LW->count() < 255);
     on_CSM_BuildCheckButton_pressed();
+    ResetHistory();
 }
 
 void BNSpriteEditor::on_CSM_BuildCheckButton_pressed()
@@ -4028,6 +4505,7 @@ void BNSpriteEditor::on_CSM_BuildPushFrame_pressed(int frameID, bool newAnim)
     // Get frame data
     BNSprite::Frame frame;
     m_csm->GetFrameData(frameID, frame);
+    RecordHistory();
 
     if (!newAnim)
     {
@@ -4057,7 +4535,7 @@ void BNSpriteEditor::on_CSM_LoadProject_pressed(QString file, uint32_t saveVersi
     {
         std::vector<uint8_t> data;
         m_csm->GetRawTilesetData(i, data);
-        m_sprite.ImportCustomTileset(data);
+        m_sprite.ImportCustomTileset(std::move(data));
     }
 
     QFile input(file);
@@ -4164,10 +4642,15 @@ void BNSpriteEditor::on_CSM_LoadProject_pressed(QString file, uint32_t saveVersi
 
                     in >> subObject.m_posX;
                     in >> subObject.m_posY;
-                    in >> subObject.m_hFlip;
-                    in >> subObject.m_vFlip;
-                    in >> subObject.m_sizeX;
-                    in >> subObject.m_sizeY;
+                    bool hFlip, vFlip;
+                    int32_t sizeX, sizeY;
+                    in >> hFlip;
+                    in >> vFlip;
+                    in >> sizeX;
+                    in >> sizeY;
+                    subObject.SetHFlip(hFlip);
+                    subObject.SetVFlip(vFlip);
+                    subObject.SetSize(sizeX, sizeY);
                     object.m_subObjects.push_back(subObject);
                 }
                 frame.m_objects.push_back(object);
@@ -4188,11 +4671,11 @@ void BNSpriteEditor::on_CSM_LoadProject_pressed(QString file, uint32_t saveVersi
         }
 
         m_sprite.SetAnimationLoop(animID, loop);
-        qApp->processEvents();
     }
 
     ui->Anim_PB_New->setEnabled(ui->Anim_LW->count() < 255);
     on_CSM_BuildCheckButton_pressed();
+    ResetHistory();
 }
 
 void BNSpriteEditor::on_CSM_SaveProject_pressed(QString file)
@@ -4255,10 +4738,10 @@ void BNSpriteEditor::on_CSM_SaveProject_pressed(QString file)
                     out << subObject.m_startTile;
                     out << subObject.m_posX;
                     out << subObject.m_posY;
-                    out << subObject.m_hFlip;
-                    out << subObject.m_vFlip;
-                    out << subObject.m_sizeX;
-                    out << subObject.m_sizeY;
+                    out << subObject.GetHFlip();
+                    out << subObject.GetVFlip();
+                    out << subObject.GetSizeX();
+                    out << subObject.GetSizeY();
                 }
             }
         }
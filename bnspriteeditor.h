@@ -4,6 +4,7 @@
 #include <QColorDialog>
 #include <QDebug>
 #include <QFileDialog>
+#include <QFutureWatcher>
 #include <QGraphicsScene>
 #include <QGraphicsPixmapItem>
 #include <QListWidgetItem>
@@ -15,8 +16,12 @@
 #include <QtGui>
 
 #include "bnsprite.h"
+#include "bnspritehistory.h"
 #include "customspritemanager.h"
+#include "frameimagecache.h"
 #include "palettecontextmenu.h"
+#include "thumbnaillistitem.h"
+#include "tileatlascache.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class BNSpriteEditor; }
@@ -57,6 +62,17 @@ private slots:
     void on_actionAbout_Qt_triggered();
     void on_actionCustom_Sprite_Manager_triggered();
     void on_actionConvert_Sprite_to_be_Compatible_with_SF_triggered();
+    void on_actionRemove_Duplicate_Tiles_triggered();
+    void on_actionSprite_Statistics_triggered();
+    void on_actionUndo_triggered();
+    void on_actionRedo_triggered();
+
+    // History
+    void CommitHistory();
+
+    // Thumbnails
+    void on_Thumbnail_timeout();
+    void on_Thumbnail_resultReadyAt(int index);
 
     // Animation
     void on_Anim_LW_currentItemChanged(QListWidgetItem *current, QListWidgetItem *previous);
@@ -179,10 +195,53 @@ private:
     void ReplacePaletteInSprite();
     void LoadSpriteToUI();
 
+    // History
+    void RecordHistory();
+    void ResetHistory();
+    void RestoreFromHistory(bool _redo);
+    void UpdateHistoryActions();
+
     // Thumbnails
     QImage* GetFrameImage(BNSprite::Frame const& _frame, bool _isThumbnail, int _subAnimID = 0, int _subFrameID = 0);
     void UpdateFrameImage(BNSprite::Frame const& _frame, QImage* _image, int32_t _minX = -128, int32_t _minY = -128, int _subAnimID = 0, int _subFrameID = 0);
+    void UpdateFrameImage(BNSprite::FrameView const& _frame, QImage* _image, int32_t _minX = -128, int32_t _minY = -128, int _subAnimID = 0, int _subFrameID = 0);
+    void UpdateObjectImage(uint32_t _tilesetID, uint32_t _paletteGroupID, uint8_t _paletteIndex, BNSprite::ArrayView<BNSprite::SubObject> _subObjects, QImage* _image, int32_t _minX, int32_t _minY);
     void DrawOAMInImage(BNSprite::SubObject const& _subObject, QImage* _image, int32_t _minX, int32_t _minY, vector<uint8_t> const& _data, bool _drawFirstColor);
+    void DrawOAMInImage(BNSprite::SubObject const& _subObject, QImage* _image, int32_t _minX, int32_t _minY, QRgb const* _atlas, int _tileCount);
+    void DrawTilesInImage(int _startTile, int _sizeX, int _sizeY, int _xPos, int _yPos, bool _hFlip, bool _vFlip, QImage* _image, vector<uint8_t> const& _data, bool _drawFirstColor);
+    template <typename Pixel>
+    static void DrawTileRows(int _startTile, int _sizeX, int _sizeY, int _xPos, int _yPos, bool _hFlip, bool _vFlip, QImage* _image, Pixel const* _tiles, int _tileCount, bool _drawFirstColor);
+    static void CopyOpaquePixels(uchar* _dst, uint8_t const* _src, int _count);
+    static void CopyOpaquePixels(QRgb* _dst, QRgb const* _src, int _count);
+    static QRect GetThumbnailRect(BNSprite::ArrayView<BNSprite::SubObject> _subObjects, int _iconSize);
+
+    // Thumbnails rendered on the thread pool from a snapshot of the sprite
+    struct ThumbnailJob
+    {
+        int m_ticket;
+        int m_animID;
+        int m_frameID;
+    };
+    struct ThumbnailResult
+    {
+        int m_ticket;
+        QImage m_image;
+        QByteArray m_key;
+        shared_ptr<vector<uint8_t> const> m_pixels;
+    };
+    struct ThumbnailRenderer
+    {
+        typedef ThumbnailResult result_type;
+        ThumbnailResult operator()(ThumbnailJob const& _job) const;
+
+        shared_ptr<BNSprite::Snapshot const> m_snapshot;
+        vector<shared_ptr<vector<uint8_t> const>> m_tilesetPixels;
+        QVector<PaletteGroup> m_paletteGroups;
+        int m_iconSize;
+    };
+    static QByteArray GetThumbnailKey(BNSprite::FrameView const& _frame, void const* _pixels, QVector<PaletteGroup> const& _paletteGroups, int _iconSize, QRect& _rect, Palette& _palette);
+    void CollectThumbnailJobs(QListWidget* _list, int _animID, QVector<ThumbnailJob>& _jobs, bool& _hasNewJobs);
+    void StopThumbnailRendering();
 
     // Animation
     void AddAnimationThumbnail(int _animID);
@@ -238,16 +297,22 @@ private:
 
     // File
     BNSprite m_sprite;
-    BNSprite m_spriteMerge;
     QString m_spriteName;
     QString m_path;
 
+    // Undo/redo
+    BNSpriteHistory m_history;
+    bool m_historyPending;
+
     // Palette
     PaletteContextMenu* m_paletteContextMenu;
 
-    // Thumbnails
-    QVector<QImage*> m_animThumbnails;
-    QVector<QImage*> m_frameThumbnails;
+    // Thumbnails, animation and frame list items only keep theirs while on screen
+    TileAtlasCache m_tileAtlas;
+    FrameImageCache m_frameImages;
+    QTimer* m_thumbnailTimer;
+    QFutureWatcher<ThumbnailResult> m_thumbnailWatcher;
+    int m_thumbnailTicket;
 
     // Current frame we're editing
     BNSprite::Frame m_frame;
@@ -261,7 +326,7 @@ private:
     QGraphicsPixmapItem* m_previewHighlight;
 
     // Cached images
-    vector<uint8_t> m_tilesetData;
+    shared_ptr<vector<uint8_t> const> m_tilesetData;
     QGraphicsScene* m_tilesetGraphic;
     QGraphicsScene* m_oamGraphic;
     QGraphicsScene* m_previewGraphic;
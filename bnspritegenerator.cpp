@@ -0,0 +1,282 @@
+#include "bnspritegenerator.h"
+
+namespace
+{
+    // OAM dimensions supported by both BN and SF
+    struct OAMSize
+    {
+        int32_t m_sizeX;
+        int32_t m_sizeY;
+    };
+
+    OAMSize const c_oamSizes[] =
+    {
+        { 8,  8}, {16,  8}, { 8, 16},
+        {16, 16}, {32,  8}, { 8, 32},
+        {32, 32}, {32, 16}, {16, 32},
+        {64, 64}, {64, 32}, {32, 64},
+    };
+}
+
+//-----------------------------------------------------
+// Generate a sprite, return false if options are invalid
+//-----------------------------------------------------
+bool BNSpriteGenerator::Generate
+(
+    Options const& _options,
+    BNSprite& _sprite,
+    string& _errorMsg
+)
+{
+    if (!ValidateOptions(_options, _errorMsg))
+    {
+        return false;
+    }
+
+    Random random(_options.m_seed);
+    uint32_t const tileSize = _options.m_256ColorMode ? 0x40 : 0x20;
+    uint32_t const paletteSize = _options.m_256ColorMode ? 256 : 16;
+
+    _sprite.Clear();
+    _sprite.Set256Color(_options.m_256ColorMode);
+
+    // Tilesets
+    for (int i = 0; i < _options.m_tilesetCount; i++)
+    {
+        vector<uint8_t> data(_options.m_tileCount * tileSize);
+        for (size_t j = 0; j < data.size(); j += 4)
+        {
+            uint32_t value = random.Next();
+            data[j + 0] = value & 0xFF;
+            data[j + 1] = (value >> 8) & 0xFF;
+            data[j + 2] = (value >> 16) & 0xFF;
+            data[j + 3] = (value >> 24) & 0xFF;
+        }
+        _sprite.ImportCustomTileset(move(data));
+    }
+
+    // Palettes
+    vector<BNSprite::PaletteGroup> paletteGroups(_options.m_paletteGroupCount);
+    for (BNSprite::PaletteGroup& group : paletteGroups)
+    {
+        group.m_palettes.resize(_options.m_paletteCount);
+        for (BNSprite::Palette& palette : group.m_palettes)
+        {
+            for (uint32_t i = 0; i < paletteSize; i++)
+            {
+                palette.m_colors.push_back(random.Next() & 0x7FFF);
+            }
+        }
+    }
+    _sprite.ReplaceAllPaletteGroups(move(paletteGroups));
+
+    // SF stores each unique frame layout once and can only index 255 of them
+    uint32_t const totalFrameCount = _options.m_animationCount * _options.m_frameCount;
+    uint32_t layoutCount = _options.m_uniqueFrameCount > 0 ? _options.m_uniqueFrameCount : totalFrameCount;
+    if (_options.m_sfCompatible && layoutCount > 255)
+    {
+        layoutCount = 255;
+    }
+
+    // Animations
+    uint32_t frameIndex = 0;
+    for (int i = 0; i < _options.m_animationCount; i++)
+    {
+        int animID = _sprite.NewAnimation();
+        _sprite.SetAnimationLoop(animID, random.Bool());
+
+        for (int j = 0; j < _options.m_frameCount; j++)
+        {
+            if (j > 0)
+            {
+                _sprite.NewFrame(animID);
+            }
+
+            // Layouts are generated from their own seed so reused layouts are identical
+            BNSprite::Frame frame = GenerateFrameLayout(_options, frameIndex % layoutCount);
+            frame.m_paletteGroupID = random.Range(0, _options.m_paletteGroupCount - 1);
+            frame.m_delay = random.Range(1, 8);
+            for (BNSprite::Object& object : frame.m_objects)
+            {
+                object.m_paletteIndex = random.Range(0, _options.m_paletteCount - 1);
+            }
+
+            _sprite.ReplaceFrame(animID, j, frame);
+            frameIndex++;
+        }
+    }
+
+    // BN fixtures with a layout SF can hold must also survive the conversion
+    bool const sfLayout = _options.m_objectCount == 1 && _options.m_subAnimationCount == 1 && _options.m_subFrameCount == 1
+                       && _options.m_paletteGroupCount * _options.m_paletteCount <= 256;
+    string convertError;
+    if (!_options.m_sfCompatible && sfLayout && !_sprite.CanConvertBNtoSF(convertError))
+    {
+        _errorMsg = "Generated sprite cannot be converted to SF: " + convertError;
+        return false;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------
+// Check the options against the format limits
+//-----------------------------------------------------
+bool BNSpriteGenerator::ValidateOptions
+(
+    Options const& _options,
+    string& _errorMsg
+)
+{
+    struct Limit
+    {
+        char const* m_name;
+        int m_value;
+        int m_max;
+    };
+
+    Limit const limits[] =
+    {
+        {"Animation count", _options.m_animationCount, 255},
+        {"Frame count", _options.m_frameCount, 255},
+        {"Object count", _options.m_objectCount, 255},
+        {"OAM count", _options.m_subObjectCount, 255},
+        {"Sub animation count", _options.m_subAnimationCount, 255},
+        {"Sub frame count", _options.m_subFrameCount, 255},
+        {"Tileset count", _options.m_tilesetCount, 1024},
+        {"Tile count", _options.m_tileCount, 2048},
+        {"Palette group count", _options.m_paletteGroupCount, 255},
+        {"Palette count", _options.m_paletteCount, 16},
+    };
+
+    for (Limit const& limit : limits)
+    {
+        if (limit.m_value < 1 || limit.m_value > limit.m_max)
+        {
+            _errorMsg = string(limit.m_name) + " must be between 1 and " + to_string(limit.m_max);
+            return false;
+        }
+    }
+
+    if (_options.m_uniqueFrameCount < 0)
+    {
+        _errorMsg = "Unique frame count cannot be negative";
+        return false;
+    }
+
+    if (_options.m_256ColorMode && !_options.m_sfCompatible)
+    {
+        _errorMsg = "BN sprite does not support 256 palette colors!";
+        return false;
+    }
+
+    if (_options.m_sfCompatible)
+    {
+        if (_options.m_objectCount > 1)
+        {
+            _errorMsg = "SF sprite does not support multiple object lists";
+            return false;
+        }
+        if (_options.m_subAnimationCount > 1 || _options.m_subFrameCount > 1)
+        {
+            _errorMsg = "SF sprite does not support sub animations";
+            return false;
+        }
+        if (_options.m_paletteGroupCount > 1)
+        {
+            _errorMsg = "SF sprite does not support multiple palette groups";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------
+// Derive a seed for one frame layout
+//-----------------------------------------------------
+uint32_t BNSpriteGenerator::MixSeed
+(
+    uint32_t _seed,
+    uint32_t _index
+)
+{
+    uint32_t hash = _seed ^ (_index * 0x9E3779B9);
+    hash ^= hash >> 16;
+    hash *= 0x85EBCA6B;
+    hash ^= hash >> 13;
+    hash *= 0xC2B2AE35;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+//-----------------------------------------------------
+// Generate the tileset, objects and sub animations of a frame
+//-----------------------------------------------------
+BNSprite::Frame BNSpriteGenerator::GenerateFrameLayout
+(
+    Options const& _options,
+    uint32_t _layoutID
+)
+{
+    Random random(MixSeed(_options.m_seed, _layoutID));
+
+    // BN and 256 color SF store the start tile in a byte, 16 color SF stores it halved.
+    // 16 color start tiles are always even so BN sprites can be converted to SF
+    bool const evenTiles = !_options.m_256ColorMode;
+    int const maxStartTile = _options.m_sfCompatible && evenTiles ? 510 : 255;
+
+    BNSprite::Frame frame;
+    frame.m_tilesetID = random.Range(0, _options.m_tilesetCount - 1);
+
+    for (int i = 0; i < _options.m_objectCount; i++)
+    {
+        BNSprite::Object object;
+        for (int j = 0; j < _options.m_subObjectCount; j++)
+        {
+            // Pick a size that fits in the tileset
+            OAMSize size;
+            do
+            {
+                size = c_oamSizes[random.Range(0, sizeof(c_oamSizes) / sizeof(c_oamSizes[0]) - 1)];
+            }
+            while ((size.m_sizeX / 8) * (size.m_sizeY / 8) > _options.m_tileCount);
+
+            int lastTile = _options.m_tileCount - (size.m_sizeX / 8) * (size.m_sizeY / 8);
+            if (lastTile > maxStartTile)
+            {
+                lastTile = maxStartTile;
+            }
+
+            BNSprite::SubObject subObject;
+            subObject.SetSize(size.m_sizeX, size.m_sizeY);
+            subObject.m_startTile = random.Range(0, lastTile);
+            if (evenTiles)
+            {
+                subObject.m_startTile &= ~1;
+            }
+            subObject.m_posX = random.Range(-64, 63 - size.m_sizeX);
+            subObject.m_posY = random.Range(-64, 63 - size.m_sizeY);
+            subObject.SetHFlip(random.Bool());
+            subObject.SetVFlip(random.Bool());
+            object.m_subObjects.push_back(subObject);
+        }
+        frame.m_objects.push_back(move(object));
+    }
+
+    for (int i = 0; i < _options.m_subAnimationCount; i++)
+    {
+        BNSprite::SubAnimation subAnim;
+        subAnim.m_loop = random.Bool();
+        for (int j = 0; j < _options.m_subFrameCount; j++)
+        {
+            BNSprite::SubFrame subFrame;
+            subFrame.m_objectIndex = random.Range(0, _options.m_objectCount - 1);
+            subFrame.m_delay = random.Range(1, 8);
+            subAnim.m_subFrames.push_back(subFrame);
+        }
+        frame.m_subAnimations.push_back(move(subAnim));
+    }
+
+    return frame;
+}
@@ -0,0 +1,77 @@
+#ifndef BNSPRITEGENERATOR_H
+#define BNSPRITEGENERATOR_H
+
+#include "bnsprite.h"
+
+// Fills a BNSprite with deterministic random content through its public API,
+// the same seed and options always produce the same sprite
+class BNSpriteGenerator
+{
+public:
+    struct Options
+    {
+        uint32_t m_seed;
+        bool m_256ColorMode;
+        bool m_sfCompatible;        // single object, no sub animations, one palette group
+
+        int m_animationCount;
+        int m_frameCount;           // per animation
+        int m_uniqueFrameCount;     // frame layouts are reused after this many, 0 for all unique
+        int m_objectCount;          // per frame
+        int m_subObjectCount;       // per object
+        int m_subAnimationCount;    // per frame
+        int m_subFrameCount;        // per sub animation
+        int m_tilesetCount;
+        int m_tileCount;            // per tileset
+        int m_paletteGroupCount;
+        int m_paletteCount;         // per palette group
+
+        Options()
+            : m_seed(0)
+            , m_256ColorMode(false)
+            , m_sfCompatible(false)
+            , m_animationCount(16)
+            , m_frameCount(8)
+            , m_uniqueFrameCount(0)
+            , m_objectCount(1)
+            , m_subObjectCount(4)
+            , m_subAnimationCount(1)
+            , m_subFrameCount(1)
+            , m_tilesetCount(16)
+            , m_tileCount(128)
+            , m_paletteGroupCount(1)
+            , m_paletteCount(16)
+        {}
+    };
+
+public:
+    static bool Generate(Options const& _options, BNSprite& _sprite, string& _errorMsg);
+
+private:
+    // xorshift32, std distributions are not guaranteed to match across standard libraries
+    struct Random
+    {
+        uint32_t m_state;
+
+        Random(uint32_t _seed)
+            : m_state(_seed ? _seed : 0x9E3779B9)
+        {}
+
+        uint32_t Next()
+        {
+            m_state ^= m_state << 13;
+            m_state ^= m_state >> 17;
+            m_state ^= m_state << 5;
+            return m_state;
+        }
+
+        int Range(int _min, int _max) { return _min + static_cast<int>(Next() % static_cast<uint32_t>(_max - _min + 1)); }
+        bool Bool() { return Next() & 0x100; }
+    };
+
+    static bool ValidateOptions(Options const& _options, string& _errorMsg);
+    static uint32_t MixSeed(uint32_t _seed, uint32_t _index);
+    static BNSprite::Frame GenerateFrameLayout(Options const& _options, uint32_t _layoutID);
+};
+
+#endif // BNSPRITEGENERATOR_H
@@ -0,0 +1,133 @@
+#include "bnspritehistory.h"
+
+//-----------------------------------------------------
+// Constructor
+//-----------------------------------------------------
+BNSpriteHistory::BNSpriteHistory
+(
+    size_t _memoryLimit,
+    size_t _stepLimit
+)
+    : m_memoryLimit(_memoryLimit)
+    , m_stepLimit(_stepLimit)
+    , m_memoryUsage(0)
+    , m_current(0)
+{
+}
+
+//-----------------------------------------------------
+// Start a new history from the current sprite
+//-----------------------------------------------------
+void BNSpriteHistory::Reset
+(
+    BNSprite& _sprite
+)
+{
+    Clear();
+
+    m_states.push_back(_sprite.TakeSnapshot());
+    m_memoryUsage = CountMemoryUsage();
+}
+
+//-----------------------------------------------------
+// Remove all steps
+//-----------------------------------------------------
+void BNSpriteHistory::Clear()
+{
+    m_states.clear();
+    m_current = 0;
+    m_memoryUsage = 0;
+}
+
+//-----------------------------------------------------
+// Add a step after the current one, return false if nothing changed
+//-----------------------------------------------------
+bool BNSpriteHistory::Commit
+(
+    BNSprite& _sprite
+)
+{
+    if (m_states.empty())
+    {
+        Reset(_sprite);
+        return false;
+    }
+
+    shared_ptr<BNSprite::Snapshot const> snapshot = _sprite.TakeSnapshot();
+    if (snapshot->IsSameAs(*m_states[m_current]))
+    {
+        return false;
+    }
+
+    // Drop redo steps
+    while (m_states.size() > m_current + 1)
+    {
+        m_memoryUsage -= m_states.back()->GetSize();
+        m_states.pop_back();
+    }
+
+    m_states.push_back(snapshot);
+    m_memoryUsage += snapshot->GetSize();
+    m_current = m_states.size() - 1;
+
+    Trim();
+    return true;
+}
+
+//-----------------------------------------------------
+// Go back one step
+//-----------------------------------------------------
+bool BNSpriteHistory::Undo
+(
+    BNSprite& _sprite
+)
+{
+    if (!CanUndo()) return false;
+
+    m_current--;
+    _sprite.RestoreSnapshot(*m_states[m_current]);
+    return true;
+}
+
+//-----------------------------------------------------
+// Go forward one step
+//-----------------------------------------------------
+bool BNSpriteHistory::Redo
+(
+    BNSprite& _sprite
+)
+{
+    if (!CanRedo()) return false;
+
+    m_current++;
+    _sprite.RestoreSnapshot(*m_states[m_current]);
+    return true;
+}
+
+//-----------------------------------------------------
+// Drop the oldest steps until within the limits, the current step is always kept.
+// A dropped step only frees what later steps don't share, so the usage is counted again
+//-----------------------------------------------------
+void BNSpriteHistory::Trim()
+{
+    while (m_current > 0 && (m_memoryUsage > m_memoryLimit || m_states.size() > m_stepLimit))
+    {
+        m_states.pop_front();
+        m_current--;
+        m_memoryUsage = CountMemoryUsage();
+    }
+}
+
+//-----------------------------------------------------
+// Memory held by all steps, data shared between them is counted once
+//-----------------------------------------------------
+size_t BNSpriteHistory::CountMemoryUsage() const
+{
+    set<void const*> counted;
+    size_t size = 0;
+    for (shared_ptr<BNSprite::Snapshot const> const& state : m_states)
+    {
+        state->CountMemory(counted, size);
+    }
+    return size;
+}
@@ -0,0 +1,43 @@
+#ifndef BNSPRITEHISTORY_H
+#define BNSPRITEHISTORY_H
+
+#include "bnsprite.h"
+
+#include <deque>
+
+// Undo/redo history made of sprite snapshots, each step only stores what changed
+// since the previous one. The oldest steps are dropped once the memory limit is reached
+class BNSpriteHistory
+{
+public:
+    BNSpriteHistory(size_t _memoryLimit = 64 * 1024 * 1024, size_t _stepLimit = 256);
+
+    // Forget all steps, the current sprite becomes the first state
+    void Reset(BNSprite& _sprite);
+    void Clear();
+
+    // Record the sprite after an edit, redo steps are discarded
+    bool Commit(BNSprite& _sprite);
+
+    bool CanUndo() const { return m_current > 0; }
+    bool CanRedo() const { return m_current + 1 < m_states.size(); }
+    bool Undo(BNSprite& _sprite);
+    bool Redo(BNSprite& _sprite);
+
+    size_t GetStepCount() const { return m_states.size(); }
+    size_t GetMemoryUsage() const { return m_memoryUsage; }
+
+private:
+    void Trim();
+    size_t CountMemoryUsage() const;
+
+private:
+    size_t m_memoryLimit;
+    size_t m_stepLimit;
+    size_t m_memoryUsage;
+
+    deque<shared_ptr<BNSprite::Snapshot const>> m_states;
+    size_t m_current;
+};
+
+#endif // BNSPRITEHISTORY_H
@@ -3310,12 +3310,11 @@ void CustomSpriteManager::GetFrameData(int frameID, BNSprite::Frame &bnFrame)
 
             BNSprite::SubObject subObject;
             subObject.m_startTile = tileStart;
-            subObject.m_sizeX = size.width() * 8;
-            subObject.m_sizeY = size.height() * 8;
+            subObject.SetSize(size.width() * 8, size.height() * 8);
             subObject.m_posX = oamPos.x();
             subObject.m_posY = oamPos.y();
-            subObject.m_hFlip = layer.m_hFlip;
-            subObject.m_vFlip = layer.m_vFlip;
+            subObject.SetHFlip(layer.m_hFlip);
+            subObject.SetVFlip(layer.m_vFlip);
             object.m_subObjects.push_back(subObject);
 
             tileStart += size.width() * size.height();
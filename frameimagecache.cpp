@@ -0,0 +1,108 @@
+#include "frameimagecache.h"
+
+//-----------------------------------------------------
+// Constructor
+//-----------------------------------------------------
+FrameImageCache::FrameImageCache
+(
+    int _memoryLimitKB
+)
+    : m_entries(_memoryLimitKB)
+    , m_hitCount(0)
+    , m_missCount(0)
+{
+}
+
+//-----------------------------------------------------
+// Build the key of a rendered object, the tileset is identified by
+// its pixels which BNSprite replaces whenever the tileset changes
+//-----------------------------------------------------
+QByteArray FrameImageCache::MakeKey
+(
+    BNSprite::ArrayView<BNSprite::SubObject> _subObjects,
+    uint32_t _tilesetID,
+    void const* _pixels,
+    QVector<QRgb> const& _palette,
+    QSize _size,
+    QImage::Format _format,
+    int32_t _minX,
+    int32_t _minY
+)
+{
+    qint32 const header[] = {_format, _size.width(), _size.height(), _minX, _minY, (qint32)_tilesetID, _palette.size(), (qint32)_subObjects.size()};
+
+    QByteArray key;
+    key.reserve(sizeof(header) + sizeof(_pixels) + _palette.size() * sizeof(QRgb) + _subObjects.size() * 5);
+    key.append(reinterpret_cast<char const*>(header), sizeof(header));
+    key.append(reinterpret_cast<char const*>(&_pixels), sizeof(_pixels));
+    key.append(reinterpret_cast<char const*>(_palette.constData()), _palette.size() * sizeof(QRgb));
+
+    // Field by field, the struct has padding
+    for (BNSprite::SubObject const& subObject : _subObjects)
+    {
+        char const fields[] =
+        {
+            char(subObject.m_startTile & 0xFF),
+            char(subObject.m_startTile >> 8),
+            char(subObject.m_posX),
+            char(subObject.m_posY),
+            char(subObject.m_attributes)
+        };
+        key.append(fields, sizeof(fields));
+    }
+    return key;
+}
+
+//-----------------------------------------------------
+// Look up an image, counts as a hit or a miss
+//-----------------------------------------------------
+bool FrameImageCache::Find
+(
+    QByteArray const& _key,
+    QImage& _image
+)
+{
+    Entry const* entry = m_entries.object(_key);
+    if (entry == Q_NULLPTR)
+    {
+        m_missCount++;
+        return false;
+    }
+
+    m_hitCount++;
+    _image = entry->m_image;
+    return true;
+}
+
+//-----------------------------------------------------
+// Add an image, costs are in KB
+//-----------------------------------------------------
+void FrameImageCache::Insert
+(
+    QByteArray const& _key,
+    QImage const& _image,
+    shared_ptr<vector<uint8_t> const> const& _pixels
+)
+{
+    Entry* entry = new Entry();
+    entry->m_image = _image;
+    entry->m_pixels = _pixels;
+    m_entries.insert(_key, entry, _image.bytesPerLine() * _image.height() / 1024 + 1);
+}
+
+//-----------------------------------------------------
+// Remove all images, statistics are kept
+//-----------------------------------------------------
+void FrameImageCache::Clear()
+{
+    m_entries.clear();
+}
+
+//-----------------------------------------------------
+// Fraction of lookups that found an image
+//-----------------------------------------------------
+double FrameImageCache::GetHitRate() const
+{
+    quint64 const total = m_hitCount + m_missCount;
+    return total > 0 ? double(m_hitCount) / total : 0.0;
+}
@@ -0,0 +1,41 @@
+#ifndef FRAMEIMAGECACHE_H
+#define FRAMEIMAGECACHE_H
+
+#include <QByteArray>
+#include <QCache>
+#include <QImage>
+#include "bnsprite.h"
+
+// Rendered frame images keyed by everything that affects them: OAM list, tileset
+// pixels, palette, image size, offset and format. Identical frames share one entry,
+// the least recently used ones are dropped once over the memory limit
+class FrameImageCache
+{
+public:
+    FrameImageCache(int _memoryLimitKB = 32 * 1024);
+
+    static QByteArray MakeKey(BNSprite::ArrayView<BNSprite::SubObject> _subObjects, uint32_t _tilesetID, void const* _pixels,
+                              QVector<QRgb> const& _palette, QSize _size, QImage::Format _format, int32_t _minX, int32_t _minY);
+
+    bool Find(QByteArray const& _key, QImage& _image);
+    void Insert(QByteArray const& _key, QImage const& _image, shared_ptr<vector<uint8_t> const> const& _pixels);
+    void Clear();
+
+    quint64 GetHitCount() const { return m_hitCount; }
+    quint64 GetMissCount() const { return m_missCount; }
+    double GetHitRate() const;
+    int GetImageCount() const { return m_entries.count(); }
+
+private:
+    struct Entry
+    {
+        QImage m_image;
+        shared_ptr<vector<uint8_t> const> m_pixels; // keeps the pixel pointer in the key from being reused
+    };
+
+    QCache<QByteArray, Entry> m_entries;
+    quint64 m_hitCount;
+    quint64 m_missCount;
+};
+
+#endif // FRAMEIMAGECACHE_H
@@ -0,0 +1,88 @@
+#ifndef THUMBNAILLISTITEM_H
+#define THUMBNAILLISTITEM_H
+
+#include <QIcon>
+#include <QListWidget>
+#include <QPixmapCache>
+
+// List item that only holds its thumbnail while it's on screen. Until one is set the view
+// is given an empty icon of the same size, so nothing moves once it arrives
+class ThumbnailListItem : public QListWidgetItem
+{
+public:
+    ThumbnailListItem(QString const& _text)
+        : QListWidgetItem(_text, Q_NULLPTR, UserType)
+        , m_hasThumbnail(false)
+        , m_outdated(false)
+        , m_ticket(-1)
+    {}
+
+    QVariant data(int _role) const
+    {
+        if (_role == Qt::DecorationRole && !m_hasThumbnail && listWidget())
+        {
+            QSize const size = listWidget()->iconSize();
+            QString const key = "ThumbnailListItem_" + QString::number(size.width()) + "x" + QString::number(size.height());
+
+            QPixmap placeholder;
+            if (!QPixmapCache::find(key, &placeholder))
+            {
+                placeholder = QPixmap(size);
+                placeholder.fill(Qt::transparent);
+                QPixmapCache::insert(key, placeholder);
+            }
+            return QIcon(placeholder);
+        }
+        return QListWidgetItem::data(_role);
+    }
+
+    // Missing, or out of date and still showing the old one
+    bool NeedsThumbnail() const { return !m_hasThumbnail || m_outdated; }
+
+    void SetThumbnail(QImage const& _image)
+    {
+        m_hasThumbnail = true;
+        m_outdated = false;
+        m_ticket = -1;
+        setIcon(QIcon(QPixmap::fromImage(_image)));
+    }
+
+    void InvalidateThumbnail()
+    {
+        m_outdated = true;
+        m_ticket = -1;
+    }
+
+    void DropThumbnail()
+    {
+        m_ticket = -1;
+        if (!m_hasThumbnail) return;
+
+        m_hasThumbnail = false;
+        m_outdated = false;
+        setIcon(QIcon());
+    }
+
+    // Rows swapped places, the thumbnails (and ones still being rendered) go with them
+    void SwapThumbnail(ThumbnailListItem& _other)
+    {
+        QVariant const icon = QListWidgetItem::data(Qt::DecorationRole);
+        setData(Qt::DecorationRole, _other.QListWidgetItem::data(Qt::DecorationRole));
+        _other.setData(Qt::DecorationRole, icon);
+
+        qSwap(m_hasThumbnail, _other.m_hasThumbnail);
+        qSwap(m_outdated, _other.m_outdated);
+        qSwap(m_ticket, _other.m_ticket);
+    }
+
+    // Identifies the render this item is waiting for, -1 if none
+    int GetTicket() const { return m_ticket; }
+    void SetTicket(int _ticket) { m_ticket = _ticket; }
+
+private:
+    bool m_hasThumbnail;
+    bool m_outdated;
+    int m_ticket;
+};
+
+#endif // THUMBNAILLISTITEM_H
@@ -0,0 +1,82 @@
+#include "tileatlascache.h"
+
+//-----------------------------------------------------
+// Constructor
+//-----------------------------------------------------
+TileAtlasCache::TileAtlasCache
+(
+    size_t _memoryLimit
+)
+    : m_memoryLimit(_memoryLimit)
+    , m_memoryUsage(0)
+{
+}
+
+//-----------------------------------------------------
+// Get the atlas of a tileset in a palette, build it if needed
+//-----------------------------------------------------
+QRgb const* TileAtlasCache::GetAtlas
+(
+    BNSprite const& _sprite,
+    int _tilesetID,
+    int _paletteGroupID,
+    int _paletteIndex,
+    QVector<QRgb> const& _palette,
+    int& _tileCount
+)
+{
+    _tileCount = 0;
+    shared_ptr<vector<uint8_t> const> pixels = _sprite.GetSharedTilesetPixels(_tilesetID);
+    if (!pixels) return Q_NULLPTR;
+
+    // The sprite hands out new pixels when the tileset is modified
+    quint64 const key = (quint64(_tilesetID) << 32) | (quint64(_paletteGroupID & 0xFFFF) << 16) | quint64(_paletteIndex & 0xFFFF);
+    QHash<quint64, Atlas>::iterator it = m_atlases.find(key);
+    if (it != m_atlases.end() && it->m_pixels == pixels && it->m_palette == _palette)
+    {
+        _tileCount = pixels->size() / 64;
+        return it->m_argb.constData();
+    }
+
+    if (it != m_atlases.end())
+    {
+        m_memoryUsage -= it->m_argb.size() * sizeof(QRgb);
+        m_atlases.erase(it);
+    }
+
+    // Simple limit, atlases are cheap to build again
+    size_t const size = pixels->size() * sizeof(QRgb);
+    if (m_memoryUsage + size > m_memoryLimit)
+    {
+        Clear();
+    }
+
+    QRgb colors[256];
+    for (int i = 0; i < 256; i++)
+    {
+        colors[i] = (i > 0 && i < _palette.size()) ? qPremultiply(_palette[i]) : 0;
+    }
+
+    Atlas& atlas = m_atlases[key];
+    atlas.m_pixels = pixels;
+    atlas.m_palette = _palette;
+    atlas.m_argb.resize(pixels->size());
+    QRgb* argb = atlas.m_argb.data();
+    for (size_t i = 0; i < pixels->size(); i++)
+    {
+        argb[i] = colors[(*pixels)[i]];
+    }
+    m_memoryUsage += size;
+
+    _tileCount = pixels->size() / 64;
+    return atlas.m_argb.constData();
+}
+
+//-----------------------------------------------------
+// Remove all atlases
+//-----------------------------------------------------
+void TileAtlasCache::Clear()
+{
+    m_atlases.clear();
+    m_memoryUsage = 0;
+}
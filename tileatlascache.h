@@ -0,0 +1,34 @@
+#ifndef TILEATLASCACHE_H
+#define TILEATLASCACHE_H
+
+#include <QColor>
+#include <QHash>
+#include <QVector>
+#include "bnsprite.h"
+
+// ARGB copies of tilesets, one per tileset and palette. Tiles are stored one after another,
+// 64 premultiplied pixels each in the same order as BNSprite::GetTilesetPixels(), with color 0
+// left fully transparent. An atlas is rebuilt as soon as its tileset or palette changed
+class TileAtlasCache
+{
+public:
+    TileAtlasCache(size_t _memoryLimit = 64 * 1024 * 1024);
+
+    // Returns null if the tileset doesn't exist, _tileCount is set to the number of tiles
+    QRgb const* GetAtlas(BNSprite const& _sprite, int _tilesetID, int _paletteGroupID, int _paletteIndex, QVector<QRgb> const& _palette, int& _tileCount);
+    void Clear();
+
+private:
+    struct Atlas
+    {
+        shared_ptr<vector<uint8_t> const> m_pixels;
+        QVector<QRgb> m_palette;
+        QVector<QRgb> m_argb;
+    };
+
+    size_t m_memoryLimit;
+    size_t m_memoryUsage;
+    QHash<quint64, Atlas> m_atlases;
+};
+
+#endif // TILEATLASCACHE_H